@@ -0,0 +1,892 @@
+// viber.js - helpers for the events the Viber plugin sends to the frontend
+
+import "./check_native_interop.js";
+import { getNativeFunction } from "./index.js";
+
+const noteNames = ["C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"];
+
+/**
+ * Returns the note name for a MIDI note number, formatted the same way the
+ * plugin used to format it (juce::MidiMessage::getMidiNoteName with middle C
+ * as octave 1), so existing sketches keep their octave mapping.
+ *
+ * @param {Number} note
+ */
+function midiNoteName(note) {
+  return `${noteNames[note % 12]}${Math.floor(note / 12) - 4}`;
+}
+
+//==============================================================================
+// MIDI arrives as one base64 string per editor tick, in the layout written by
+// ViberAudioProcessorEditor::sendMidiEvents():
+//
+//   0  'V' 'M'   magic
+//   2  uint8     version
+//   3  uint8     reserved
+//   4  uint32    number of events
+//   8  float64   base time, in samples since the plugin was prepared
+//   16 float64   sample rate
+//   24 float64   position being heard when the plugin sent this
+//   32 float64   base time on the host's timeline, -1 if unknown
+//   40 events... 8 bytes each: uint8 type, uint8 channel (1..16), uint8 note,
+//                uint8 velocity or pressure, uint32 samples after the base time
+
+const MIDI_EVENTS_VERSION = 2;
+const MIDI_EVENTS_HEADER_SIZE = 40;
+const MIDI_EVENT_SIZE = 8;
+const MIDI_EVENT_TYPES = ["on", "off", "pressure", "channelpressure"];
+
+// { events, sampleRate, heardPosition } from one payload, or null
+function readMidiPayload(payload) {
+  if (typeof payload !== "string" || payload.length === 0) return null;
+
+  const bytes = base64ToBytes(payload);
+  if (bytes.length < MIDI_EVENTS_HEADER_SIZE || bytes[0] !== 0x56 || bytes[1] !== 0x4d) return null;
+
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const version = view.getUint8(2);
+
+  if (version !== MIDI_EVENTS_VERSION) {
+    console.warn(`Unsupported MIDI events version ${version}`);
+    return null;
+  }
+
+  const numEvents = view.getUint32(4, true);
+  const baseTime = view.getFloat64(8, true);
+  const sampleRate = view.getFloat64(16, true) || 44100;
+  if (bytes.length < MIDI_EVENTS_HEADER_SIZE + numEvents * MIDI_EVENT_SIZE) return null;
+
+  const heardPosition = view.getFloat64(24, true);
+  const hostBaseTime = view.getFloat64(32, true);
+  const events = new Array(numEvents);
+
+  for (let i = 0; i < numEvents; ++i) {
+    const offset = MIDI_EVENTS_HEADER_SIZE + i * MIDI_EVENT_SIZE;
+    const type = MIDI_EVENT_TYPES[bytes[offset]] ?? "off";
+    const isNote = type === "on" || type === "off";
+    const delta = view.getUint32(offset + 4, true);
+    const time = baseTime + delta;
+
+    events[i] = {
+      type,
+      channel: bytes[offset + 1],
+      note: bytes[offset + 2],
+      velocity: isNote ? bytes[offset + 3] : 0,
+      pressure: isNote ? 0 : bytes[offset + 3],
+      time,
+      seconds: time / sampleRate,
+      hostTime: hostBaseTime >= 0 ? hostBaseTime + delta : null,
+    };
+  }
+
+  return { events, sampleRate, heardPosition };
+}
+
+/**
+ * Decodes a 'midievents' payload into an array of
+ * { type, note, velocity, pressure, channel, time, seconds, hostTime }, in the
+ * order they were played. type is "on", "off", "pressure" (polyphonic
+ * aftertouch) or "channelpressure" (note is 0). velocity is set for "on" and
+ * "off", pressure for the other two. time is in samples and seconds in
+ * seconds, both since the plugin was last prepared; hostTime is in samples on
+ * the host's timeline, or null if the host doesn't report one. Returns null
+ * for anything else.
+ *
+ * @param {String} payload
+ */
+function decodeMidiEvents(payload) {
+  return readMidiPayload(payload)?.events ?? null;
+}
+
+/**
+ * Registers a callback for the batched 'midievents' event; the callback
+ * receives arrays of events in the decodeMidiEvents() format, in order.
+ *
+ * The plugin sends events as soon as they are played, which is before they
+ * are heard by the host's output latency. By default they are held and handed
+ * over on the animation frame that shows while they are heard, like spectrum
+ * frames (see setOutputLatency()). Pass { sync: false } to get each batch as
+ * soon as it arrives instead.
+ *
+ * Returns the registration token, to be passed to removeEventListener.
+ *
+ * @param {Function} callback
+ * @param {{ sync?: Boolean }} options
+ */
+function addMidiEventsListener(callback, { sync = true } = {}) {
+  const listener = { callback, pending: [] };
+
+  const token = window.__JUCE__.backend.addEventListener("midievents", (payload) => {
+    const decoded = readMidiPayload(payload);
+    if (!decoded || decoded.events.length === 0) return;
+
+    if (!sync) {
+      callback(decoded.events);
+      return;
+    }
+
+    // The heard position was measured on the way out, about half a round trip ago
+    const heardAt = performance.now() - renderClock.ipcMs;
+
+    for (const event of decoded.events) {
+      const due = heardAt + ((event.time - decoded.heardPosition) / decoded.sampleRate) * 1000;
+      listener.pending.push({ due, event });
+    }
+
+    scheduleMidi(listener);
+  });
+
+  midiTokens.set(token, listener);
+  return token;
+}
+
+// Listeners with events waiting to be heard, flushed once per animation frame
+const midiListeners = new Set();
+const midiTokens = new Map();
+let midiLoopRunning = false;
+
+function scheduleMidi(listener) {
+  midiListeners.add(listener);
+
+  if (!midiLoopRunning) {
+    midiLoopRunning = true;
+    requestAnimationFrame(flushMidi);
+  }
+}
+
+function flushMidi(now) {
+  // Whatever is drawn now shows up about a frame later
+  const presented = now + renderClock.frameMs;
+
+  for (const listener of midiListeners) {
+    let numDue = 0;
+    while (numDue < listener.pending.length && listener.pending[numDue].due <= presented) ++numDue;
+    if (numDue === 0) continue;
+
+    const due = listener.pending.splice(0, numDue).map(({ event }) => event);
+    if (listener.pending.length === 0) midiListeners.delete(listener);
+    listener.callback(due);
+  }
+
+  midiLoopRunning = midiListeners.size > 0;
+  if (midiLoopRunning) requestAnimationFrame(flushMidi);
+}
+
+/**
+ * Convenience wrapper over addMidiEventsListener for sketches that only care
+ * about note names. onNoteOn/onNoteOff are called once per note event, in
+ * order, with the note name and the decoded event. Pressure is left out.
+ *
+ * @param {Function} onNoteOn
+ * @param {Function} onNoteOff
+ * @param {{ sync?: Boolean }} options
+ */
+function addNoteListener(onNoteOn, onNoteOff, options) {
+  return addMidiEventsListener((events) => {
+    for (const event of events) {
+      if (event.type === "on") onNoteOn?.(midiNoteName(event.note), event);
+      else if (event.type === "off") onNoteOff?.(midiNoteName(event.note), event);
+    }
+  }, options);
+}
+
+/**
+ * Resolves to every note held right now, for sketches that open while notes
+ * are already down:
+ *
+ *   { notes: [{ channel, note, velocity, pressure, time }], channelPressure }
+ *
+ * time is when the note started, in samples, as in decodeMidiEvents();
+ * channelPressure has one value per channel, 1..16 at indexes 0..15.
+ * After this, the 'midievents' deltas say what changed.
+ *
+ * @returns {Promise<Object>}
+ */
+function getNoteState() {
+  return getNativeFunction("getNoteState")();
+}
+
+//==============================================================================
+// Spectrum frames arrive as base64 strings in the binary layout written by
+// SpectrumFrameEncoder.cpp:
+//
+//   0  'V' 'F'   magic
+//   2  uint8     format version
+//   3  uint8     bytes per bin (1 or 2)
+//   4  uint16    number of bins (or display bands)
+//   6  uint8     frequency scale: 0 linear, 1 log, 2 mel, 3 third-octave
+//   7  uint8     stream: 0 mix, 1 left, 2 right, 3 mid, 4 side, 5 sidechain
+//   8  uint32    frame sequence number
+//   12 uint8     flags: bit 0 set when peaks follow the bins, bit 1 when
+//                levels follow them, bit 2 when features do
+//   13 uint8[3]  reserved
+//   16 float64   centre of the analysis window, in samples since the plugin was prepared
+//   24 float64   the same on the host's timeline, -1 if unknown
+//   32 bins...   quantised 0..1 values, little endian
+//   .. peaks...  as many again, if flagged
+//   .. levels    if flagged: uint8 channel count, uint8[3] reserved, then per channel
+//                float32 RMS, peak and true peak, linear
+//   .. features  if flagged: uint8 events (bit 0 onset, bit 1 beat), uint8[3] reserved,
+//                then float32 flux, tempoBpm, tempoConfidence, beatPhase, centroidHz,
+//                rolloffHz, flatness, pitchHz and pitchConfidence
+
+const SPECTRUM_FRAME_VERSION = 7;
+const SPECTRUM_SCALES = ["linear", "log", "mel", "thirdoctave"];
+const SPECTRUM_STREAMS = ["mix", "left", "right", "mid", "side", "sidechain"];
+const SPECTRUM_HEADER_SIZE = 32;
+const SPECTRUM_HAS_PEAKS = 1;
+const SPECTRUM_HAS_LEVELS = 2;
+const SPECTRUM_HAS_FEATURES = 4;
+const SPECTRUM_FEATURES_SIZE = 40;
+const SPECTRUM_FEATURE_NAMES = [
+  "flux",
+  "tempoBpm",
+  "tempoConfidence",
+  "beatPhase",
+  "centroidHz",
+  "rolloffHz",
+  "flatness",
+  "pitchHz",
+  "pitchConfidence",
+];
+
+// Scratch for the base64 -> bytes step, reused between frames
+let frameBytes = new Uint8Array(0);
+
+function base64ToBytes(payload) {
+  const binary = atob(payload);
+  if (frameBytes.length < binary.length) frameBytes = new Uint8Array(binary.length);
+  for (let i = 0; i < binary.length; ++i) frameBytes[i] = binary.charCodeAt(i);
+  return frameBytes.subarray(0, binary.length);
+}
+
+/**
+ * Decodes one frame from pullFrames into
+ * { version, sequence, scale, stream, numBins, bins, peaks, time, hostTime, levels,
+ *   features },
+ * where bins is a Float32Array of normalised 0..1 values, after whatever
+ * setBallistics() asked for, and peaks is a second one of held peaks, or null
+ * when peak hold is off. time is the sample the frame is centred on, as in
+ * decodeMidiEvents(); hostTime is the same on the host's timeline, or null.
+ * levels has one { rms, peak, truePeak } per main input channel, linear with
+ * 1 at full scale, measured after the gain parameter over the audio since the
+ * previous hop; null before the first block. features is set on frames of the
+ * stream chosen with setFeatureStream() and null otherwise:
+ *
+ *   { onset, beat, flux, tempoBpm, tempoConfidence, beatPhase, centroidHz,
+ *     rolloffHz, flatness, pitchHz, pitchConfidence }
+ *
+ * onset and beat are true on the frame after one happened; beatPhase runs
+ * from 0 on a beat to 1 just before the next. Frequencies are in Hz, and 0
+ * when there is no steady tempo, no pitch, or silence. Confidences and
+ * flatness are 0..1. Returns null if the payload isn't a frame this decoder
+ * understands.
+ *
+ * Frames of different streams analysed at the same hop share a sequence number.
+ *
+ * New arrays are created per frame (one allocation each, not one per bin), so
+ * sketches can keep references to old frames in their history.
+ *
+ * @param {String} payload
+ */
+function decodeSpectrumFrame(payload) {
+  if (typeof payload !== "string" || payload.length === 0) return null;
+
+  const bytes = base64ToBytes(payload);
+  if (bytes.length < SPECTRUM_HEADER_SIZE || bytes[0] !== 0x56 || bytes[1] !== 0x46) return null;
+
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const version = view.getUint8(2);
+
+  if (version !== SPECTRUM_FRAME_VERSION) {
+    console.warn(`Unsupported spectrum frame version ${version}`);
+    return null;
+  }
+
+  const bytesPerBin = view.getUint8(3);
+  const numBins = view.getUint16(4, true);
+  const scale = SPECTRUM_SCALES[view.getUint8(6)] ?? "linear";
+  const stream = SPECTRUM_STREAMS[view.getUint8(7)] ?? "mix";
+  const sequence = view.getUint32(8, true);
+  const flags = view.getUint8(12);
+  const hasPeaks = (flags & SPECTRUM_HAS_PEAKS) !== 0;
+  const hasLevels = (flags & SPECTRUM_HAS_LEVELS) !== 0;
+  const hasFeatures = (flags & SPECTRUM_HAS_FEATURES) !== 0;
+  const arraySize = numBins * bytesPerBin;
+  const levelsOffset = SPECTRUM_HEADER_SIZE + arraySize * (hasPeaks ? 2 : 1);
+
+  if (bytesPerBin !== 1 && bytesPerBin !== 2) return null;
+  if (bytes.length < levelsOffset) return null;
+
+  const readValues = (offset) => {
+    const values = new Float32Array(numBins);
+
+    if (bytesPerBin === 1) {
+      for (let i = 0; i < numBins; ++i) values[i] = bytes[offset + i] / 255;
+    } else {
+      for (let i = 0; i < numBins; ++i) values[i] = view.getUint16(offset + i * 2, true) / 65535;
+    }
+
+    return values;
+  };
+
+  const bins = readValues(SPECTRUM_HEADER_SIZE);
+  const peaks = hasPeaks ? readValues(SPECTRUM_HEADER_SIZE + arraySize) : null;
+  const time = view.getFloat64(16, true);
+  const hostPosition = view.getFloat64(24, true);
+  const hostTime = hostPosition >= 0 ? hostPosition : null;
+
+  let levels = null;
+  let featuresOffset = levelsOffset;
+
+  if (hasLevels && bytes.length >= levelsOffset + 4) {
+    featuresOffset += 4 + view.getUint8(levelsOffset) * 12;
+    const numChannels = Math.min(view.getUint8(levelsOffset), (bytes.length - levelsOffset - 4) / 12 | 0);
+    levels = [];
+
+    for (let ch = 0; ch < numChannels; ++ch) {
+      const offset = levelsOffset + 4 + ch * 12;
+      levels.push({
+        rms: view.getFloat32(offset, true),
+        peak: view.getFloat32(offset + 4, true),
+        truePeak: view.getFloat32(offset + 8, true),
+      });
+    }
+  }
+
+  let features = null;
+
+  if (hasFeatures && bytes.length >= featuresOffset + SPECTRUM_FEATURES_SIZE) {
+    const events = view.getUint8(featuresOffset);
+    features = { onset: (events & 1) !== 0, beat: (events & 2) !== 0 };
+
+    SPECTRUM_FEATURE_NAMES.forEach((name, i) => {
+      features[name] = view.getFloat32(featuresOffset + 4 + i * 4, true);
+    });
+  }
+
+  return { version, sequence, scale, stream, numBins, bins, peaks, time, hostTime, levels, features };
+}
+
+//==============================================================================
+// Spectrogram history rows arrive from getSpectrogramRows as one base64 string
+// in the layout written by SpectrogramHistory.cpp:
+//
+//   0  'V' 'S'   magic
+//   2  uint8     format version
+//   3  uint8     reserved
+//   4  uint16    number of rows
+//   6  uint16    reserved
+//   8  rows...   each: uint16 width, uint8 scale, uint8 stream,
+//                uint32 frame sequence, then `width` bytes of 0..255
+
+const SPECTROGRAM_VERSION = 1;
+const SPECTROGRAM_HEADER_SIZE = 8;
+const SPECTROGRAM_ROW_HEADER_SIZE = 8;
+
+/**
+ * Decodes a getSpectrogramRows payload into an array of
+ * { sequence, scale, stream, width, values }, oldest first, where values is a
+ * Float32Array of normalised 0..1 values. Returns null if the payload isn't
+ * one this decoder understands.
+ *
+ * @param {String} payload
+ */
+function decodeSpectrogramRows(payload) {
+  if (typeof payload !== "string" || payload.length === 0) return null;
+
+  const bytes = base64ToBytes(payload);
+  if (bytes.length < SPECTROGRAM_HEADER_SIZE || bytes[0] !== 0x56 || bytes[1] !== 0x53) return null;
+
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const version = view.getUint8(2);
+
+  if (version !== SPECTROGRAM_VERSION) {
+    console.warn(`Unsupported spectrogram version ${version}`);
+    return null;
+  }
+
+  const numRows = view.getUint16(4, true);
+  const rows = [];
+  let offset = SPECTROGRAM_HEADER_SIZE;
+
+  for (let r = 0; r < numRows && offset + SPECTROGRAM_ROW_HEADER_SIZE <= bytes.length; ++r) {
+    const width = view.getUint16(offset, true);
+    const scale = SPECTRUM_SCALES[view.getUint8(offset + 2)] ?? "linear";
+    const stream = SPECTRUM_STREAMS[view.getUint8(offset + 3)] ?? "mix";
+    const sequence = view.getUint32(offset + 4, true);
+    offset += SPECTROGRAM_ROW_HEADER_SIZE;
+
+    if (offset + width > bytes.length) break;
+
+    const values = new Float32Array(width);
+    for (let i = 0; i < width; ++i) values[i] = bytes[offset + i] / 255;
+    offset += width;
+
+    rows.push({ sequence, scale, stream, width, values });
+  }
+
+  return rows;
+}
+
+//==============================================================================
+// Frames are pulled once per animation frame rather than pushed by the plugin,
+// so they arrive at the display's refresh rate and stop while the page is
+// hidden. Each pull says how far ahead the reply will be on screen: about half
+// the measured round trip to the plugin, plus a frame for the next paint. The
+// plugin answers with the newest frame per stream whose audio is being heard
+// by then, and leaves out streams that are silent or haven't changed.
+//
+// Spectrogram listeners ride the same loop, each with its own cursor into the
+// plugin's history, so a new one gets every row still held and after that
+// only the rows added since its last pull.
+
+const frameListeners = new Map();
+const spectrogramListeners = new Map();
+let nextFrameListenerId = 0;
+let pullLoopRunning = false;
+let pullInFlight = false;
+
+// Smoothed animation frame interval and one-way trip to the plugin, in ms
+const renderClock = { frameMs: 1000 / 60, ipcMs: 2, lastFrame: null };
+const RENDER_CLOCK_SMOOTHING = 0.1;
+
+function updateRenderClock(key, sample) {
+  renderClock[key] += (sample - renderClock[key]) * RENDER_CLOCK_SMOOTHING;
+}
+
+function pullSpectrogram(listener) {
+  listener.inFlight = true;
+
+  getNativeFunction("getSpectrogramRows")(listener.next)
+    .then((reply) => {
+      if (!reply) return;
+
+      const rows = decodeSpectrogramRows(reply.data);
+      if (!rows) return;
+
+      // A gap means the history was emptied (the host re-prepared) or this
+      // listener fell a whole ring behind, so whatever it drew is stale
+      const restarted = reply.first !== listener.next;
+      listener.next = reply.first + rows.length;
+
+      if (rows.length || restarted) listener.callback(rows, restarted);
+    })
+    .finally(() => {
+      listener.inFlight = false;
+    });
+}
+
+function pullFrames(now) {
+  if (frameListeners.size === 0 && spectrogramListeners.size === 0) {
+    pullLoopRunning = false;
+    renderClock.lastFrame = null;
+    return;
+  }
+
+  requestAnimationFrame(pullFrames);
+
+  // Long gaps are a hidden page rather than the display's rate
+  if (renderClock.lastFrame !== null && now - renderClock.lastFrame < 100)
+    updateRenderClock("frameMs", now - renderClock.lastFrame);
+  renderClock.lastFrame = now;
+
+  // A slow reply skips animation frames rather than queueing calls behind it
+  for (const listener of spectrogramListeners.values())
+    if (!listener.inFlight) pullSpectrogram(listener);
+
+  if (frameListeners.size === 0 || pullInFlight) return;
+  pullInFlight = true;
+
+  const sent = performance.now();
+
+  getNativeFunction("pullFrames")(renderClock.ipcMs + renderClock.frameMs)
+    .then((payloads) => {
+      updateRenderClock("ipcMs", (performance.now() - sent) / 2);
+
+      for (const payload of payloads ?? []) {
+        const frame = decodeSpectrumFrame(payload);
+        if (!frame) continue;
+
+        for (const { callback, stream } of frameListeners.values())
+          if (stream === null || frame.stream === stream) callback(frame);
+      }
+    })
+    .finally(() => {
+      pullInFlight = false;
+    });
+}
+
+function startPullLoop() {
+  if (!pullLoopRunning) {
+    pullLoopRunning = true;
+    requestAnimationFrame(pullFrames);
+  }
+}
+
+/**
+ * Registers a callback for decoded spectrum frames of one stream, "mix" by
+ * default. Pass null to receive every stream. Streams other than "mix" only
+ * arrive after subscribeStreams() asks for them.
+ *
+ * The callback runs at most once per stream per animation frame, with the
+ * frame whose audio is being heard as it reaches the screen, and not at all
+ * while the stream is silent or unchanged.
+ *
+ * Returns the registration token, to be passed to removeEventListener.
+ *
+ * @param {Function} callback
+ * @param {String|null} stream
+ */
+function addSpectrumFrameListener(callback, stream = "mix") {
+  const token = { spectrumFrameListener: nextFrameListenerId++ };
+  frameListeners.set(token, { callback, stream });
+  startPullLoop();
+  return token;
+}
+
+/**
+ * Registers a callback for spectrogram (waterfall) rows: one row per analysis
+ * frame of the stream chosen with setSpectrogramStream(), "mix" by default,
+ * kept by the plugin even while the editor is closed.
+ *
+ * The first call receives the whole history the plugin holds (about 20
+ * seconds), later ones only the rows added since, each as
+ * callback(rows, restarted) with rows in the decodeSpectrogramRows() format,
+ * oldest first. `restarted` is true when the rows don't follow on from the
+ * previous batch and anything already drawn should be cleared.
+ *
+ * Returns the registration token, to be passed to removeEventListener.
+ *
+ * @param {Function} callback
+ */
+function addSpectrogramListener(callback) {
+  const token = { spectrogramListener: nextFrameListenerId++ };
+  spectrogramListeners.set(token, { callback, next: 0, inFlight: false });
+  startPullLoop();
+  return token;
+}
+
+/**
+ * Chooses which stream the plugin's spectrogram history records. Switching
+ * doesn't clear rows already recorded from the previous stream; each row says
+ * which stream it came from. The stream must also be subscribed.
+ *
+ * @param {String} stream
+ */
+function setSpectrogramStream(stream) {
+  return getNativeFunction("setSpectrogramStream")(stream);
+}
+
+/**
+ * Chooses which stream the plugin extracts audio features from: onsets,
+ * tempo and beats, spectral centroid, rolloff and flatness, and pitch. Frames
+ * of that stream then carry `features` (see decodeSpectrumFrame()). Pass null
+ * to stop, which is the default. The stream must also be subscribed.
+ *
+ * @param {String|null} stream
+ */
+function setFeatureStream(stream) {
+  return getNativeFunction("setFeatureStream")(stream);
+}
+
+/**
+ * Registers callbacks for what the plugin hears in the audio itself, so
+ * tracks without MIDI can drive a sketch the way notes do. Turns feature
+ * extraction on for options.stream ("mix" by default); any callback may be
+ * left out:
+ *
+ *   onFeatures(features, frame)      every frame, in the decodeSpectrumFrame() format
+ *   onOnset(features)                when something starts: a hit, a note, a syllable
+ *   onBeat(features)                 on each beat of the tempo being tracked
+ *   onNoteChange(noteName, features) when the pitch settles on a different note,
+ *                                    named as midiNoteName() names MIDI notes, or
+ *                                    with null when it stops being pitched
+ *
+ * A pitch counts once pitchConfidence reaches options.minPitchConfidence
+ * (0.8 by default). Callbacks run from the frame loop, as the audio is heard.
+ *
+ * Returns the registration token, to be passed to removeEventListener.
+ *
+ * @param {{ onFeatures?: Function, onOnset?: Function, onBeat?: Function, onNoteChange?: Function }} callbacks
+ * @param {{ stream?: String, minPitchConfidence?: Number }} options
+ */
+function addAudioEventListener(
+  { onFeatures, onOnset, onBeat, onNoteChange } = {},
+  { stream = "mix", minPitchConfidence = 0.8 } = {}
+) {
+  let note = null;
+  setFeatureStream(stream);
+
+  return addSpectrumFrameListener((frame) => {
+    const features = frame.features;
+    if (!features) return;
+
+    onFeatures?.(features, frame);
+    if (features.onset) onOnset?.(features);
+    if (features.beat) onBeat?.(features);
+
+    const pitched = features.pitchHz > 0 && features.pitchConfidence >= minPitchConfidence;
+    const nearest = Math.round(69 + 12 * Math.log2(features.pitchHz / 440));
+    const current = pitched ? Math.min(127, Math.max(0, nearest)) : null;
+
+    if (current !== note) {
+      note = current;
+      onNoteChange?.(note === null ? null : midiNoteName(note), features);
+    }
+  }, stream);
+}
+
+/**
+ * Tells the plugin which spectra to compute and send, replacing the previous
+ * set: any of "mix", "left", "right", "mid", "side" and "sidechain". Streams
+ * nobody renders cost nothing, so only ask for what the sketch draws.
+ *
+ * @param {String[]} streams
+ */
+function subscribeStreams(streams) {
+  return getNativeFunction("subscribeStreams")(streams);
+}
+
+/**
+ * Asks the plugin to reduce each frame to `numBands` display bands before
+ * sending it, which shrinks the payload and the per-frame JS work.
+ *
+ * scale is "linear", "log", "mel" or "thirdoctave". Third-octave always has
+ * ISO band centres, so numBands is ignored. setBandLayout("linear", 0) goes
+ * back to raw FFT bins.
+ *
+ * @param {String} scale
+ * @param {Number} numBands
+ */
+function setBandLayout(scale, numBands) {
+  return getNativeFunction("setBandLayout")(scale, numBands);
+}
+
+/**
+ * Chooses how the plugin smooths frames before sending them, for every
+ * stream. Either a profile name:
+ *
+ *   "off"       raw values (the default)
+ *   "smooth"    10 ms attack, 300 ms release
+ *   "average"   mean of the last 4 frames, lightly smoothed
+ *   "peakhold"  raw values plus peaks held for 500 ms, then falling 20 dB/s
+ *
+ * or an object overriding any of a profile's values:
+ *
+ *   { profile, attackMs, releaseMs, averageFrames (1..8), peaks,
+ *     peakHoldMs, peakDecayDbPerSecond }
+ *
+ * With peaks on, frames carry a `peaks` array alongside `bins`.
+ *
+ * @param {String|Object} profile
+ */
+function setBallistics(profile) {
+  return getNativeFunction("setBallistics")(profile);
+}
+
+/**
+ * Records which sketch is on show, so the session reopens with it.
+ *
+ * @param {String} name
+ */
+function setVisualiser(name) {
+  return getNativeFunction("setVisualiser")(name);
+}
+
+/**
+ * Resolves to the sketch saved with the session, or "" if none was.
+ *
+ * @returns {Promise<String>}
+ */
+function getVisualiser() {
+  return getNativeFunction("getVisualiser")();
+}
+
+/**
+ * Chooses whether the session also saves the spectrogram history (up to about
+ * 1 MB per instance), so waterfall views reopen with what they last showed.
+ * Off by default.
+ *
+ * @param {Boolean} enabled
+ */
+function setSaveSpectrogram(enabled) {
+  return getNativeFunction("setSaveSpectrogram")(enabled);
+}
+
+/**
+ * Resolves to where playback is and how frames and MIDI are lined up with it:
+ *
+ *   { sampleRate, blockSize, position, heardPosition, hostPosition,
+ *     ppqPosition, bpm, isPlaying, outputLatencyMs, deviceLatencyMs,
+ *     userLatencyMs, presentAheadMs, syncErrorMs, endToEndLatencyMs }
+ *
+ * Positions are in samples since the plugin was prepared, except hostPosition
+ * (the heard position on the host's timeline, -1 if unknown). outputLatencyMs
+ * is one host block plus the device and user latencies; presentAheadMs is how
+ * far ahead the last pull asked for. syncErrorMs is how far behind its audio
+ * the last frame sent will be shown, which is at least half the FFT window,
+ * and endToEndLatencyMs is the whole trip from a block being processed to its
+ * frame being on screen.
+ *
+ * @returns {Promise<Object>}
+ */
+function getSyncInfo() {
+  return getNativeFunction("getSyncInfo")();
+}
+
+/**
+ * Adds output latency the plugin can't measure, such as a Bluetooth headset
+ * or a host that doesn't report its device, so visuals wait for the audio.
+ * The standalone app measures its own device; inside a DAW, this is the only
+ * way to account for it. Negative values show visuals earlier.
+ *
+ * @param {Number} ms
+ */
+function setOutputLatency(ms) {
+  return getNativeFunction("setOutputLatency")(ms);
+}
+
+/**
+ * Resolves to the plugin's realtime-safety report: every allocation, free and
+ * lock made on the audio thread, with call stacks. Only Debug builds collect
+ * one; Release builds say the checks aren't compiled in.
+ *
+ * @returns {Promise<String>}
+ */
+function getRealtimeReport() {
+  return getNativeFunction("getRealtimeReport")();
+}
+
+/**
+ * Starts recording every spectrum frame (with its levels and features) and
+ * every MIDI event the plugin produces to a capture file, whether or not the
+ * editor is open, until stopCapture(). Without a path, or with a relative one,
+ * the file goes in Documents/Viber/Captures. An earlier capture at the path is
+ * replaced, but any other file is left alone. Resolves to getCaptureInfo(),
+ * with `error` set if the file couldn't be created or wasn't a capture.
+ *
+ * @param {String} [path]
+ * @returns {Promise<Object>}
+ */
+function startCapture(path) {
+  return getNativeFunction("startCapture")(path ?? "");
+}
+
+/**
+ * Finishes the capture in progress. Resolves to getCaptureInfo().
+ *
+ * @returns {Promise<Object>}
+ */
+function stopCapture() {
+  return getNativeFunction("stopCapture")();
+}
+
+/**
+ * Resolves to the current or last capture:
+ *
+ *   { recording, file, seconds, bytes, frames, midiEvents, dropped, error }
+ *
+ * `dropped` counts records lost because the writer fell behind; `error` says
+ * why a capture stopped by itself, such as a full disk.
+ *
+ * @returns {Promise<Object>}
+ */
+function getCaptureInfo() {
+  return getNativeFunction("getCaptureInfo")();
+}
+
+/**
+ * Opens a capture and replays it in place of the live analysis: frame and
+ * MIDI listeners get the recorded frames and events instead, until
+ * closeReplay(). The replay starts paused at the beginning. Resolves to
+ *
+ *   { file, position, duration, playing, speed, frames, midiEvents, startTime }
+ *
+ * with times in seconds, or to { error }.
+ *
+ * @param {String} path
+ * @returns {Promise<Object>}
+ */
+function openReplay(path) {
+  return getNativeFunction("openReplay")(path);
+}
+
+/**
+ * Plays, pauses, seeks or changes the speed of the open replay, e.g.
+ * setReplay({ position: 90, speed: 0.25, playing: true }). Seeking shows the
+ * frames at the new position even while paused. Resolves to the replay's
+ * state as for openReplay(), or null if none is open.
+ *
+ * @param {{playing?: Boolean, speed?: Number, position?: Number}} options
+ * @returns {Promise<Object|null>}
+ */
+function setReplay(options) {
+  return getNativeFunction("setReplay")(options ?? {});
+}
+
+/**
+ * Closes the replay and goes back to the live analysis.
+ */
+function closeReplay() {
+  return getNativeFunction("closeReplay")();
+}
+
+/**
+ * Registers a callback for the 'perfstats' event, sent about twice a second
+ * with what the plugin's hot paths cost since the previous one:
+ *
+ *   { instance, interval, dspLoad,
+ *     stages: { processBlock, fft, decibels, encode, frameLatency, avSync } }
+ *
+ * Each stage is { count, mean, p50, p99, max } in microseconds. dspLoad is
+ * processBlock time over the duration of the audio it processed, so 1 means
+ * the whole budget. avSync is how far behind their audio frames were shown.
+ * `instance` tells plugin instances in one host apart.
+ *
+ * @param {Function} callback
+ */
+function addPerfStatsListener(callback) {
+  return window.__JUCE__.backend.addEventListener("perfstats", callback);
+}
+
+function removeEventListener(token) {
+  if (frameListeners.delete(token) || spectrogramListeners.delete(token)) return;
+
+  // Events still waiting to be heard are dropped with their listener
+  midiListeners.delete(midiTokens.get(token));
+  midiTokens.delete(token);
+  window.__JUCE__.backend.removeEventListener(token);
+}
+
+export {
+  midiNoteName,
+  decodeMidiEvents,
+  addMidiEventsListener,
+  addNoteListener,
+  getNoteState,
+  decodeSpectrumFrame,
+  decodeSpectrogramRows,
+  addSpectrumFrameListener,
+  addSpectrogramListener,
+  setSpectrogramStream,
+  setFeatureStream,
+  addAudioEventListener,
+  setSaveSpectrogram,
+  setVisualiser,
+  getVisualiser,
+  setBandLayout,
+  setBallistics,
+  subscribeStreams,
+  getSyncInfo,
+  setOutputLatency,
+  getRealtimeReport,
+  startCapture,
+  stopCapture,
+  getCaptureInfo,
+  openReplay,
+  setReplay,
+  closeReplay,
+  addPerfStatsListener,
+  removeEventListener,
+};
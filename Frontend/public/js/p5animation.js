@@ -1,4 +1,5 @@
 import * as Juce from "./juce/index.js";
+import * as Viber from "./juce/viber.js";
 
 console.log("--- Running JUICE Backend ---");
 console.log(window.__JUCE__.backend);
@@ -17,16 +18,9 @@ const sketchContainer = "sketch";
 let currFFTFrame = null;
 
 // FFT
-window.__JUCE__.backend.addEventListener("fftframe", (event) => {
-    const payload = typeof event === 'string' ? event : (event?.detail ?? '');
-    if (typeof payload === 'string' && payload.length) {
-        const magnitudeArray = payload.split(',').map(parseFloat);
-        if (magnitudeArray.some((x) => x > 0)) {
-            console.log("FFT Frame:", magnitudeArray);
-        }
-        // console.log("FFT Frame:", magnitudeArray);
-        currFFTFrame = magnitudeArray;
-    }
+Viber.addSpectrumFrameListener((frame) => {
+    // console.log("FFT Frame:", frame.bins);
+    currFFTFrame = frame.bins;
 });
 
 // Constants - 12 pitch classes (12 cats per row, 3 rows)
@@ -130,9 +124,8 @@ function handleNoteOff(event) {
     }
 }
 
-// Wire up JUCE events
-window.__JUCE__.backend.addEventListener("notechange", handleNoteOn);
-window.__JUCE__.backend.addEventListener("noteoff", handleNoteOff);
+// Wire up JUCE events (notes arrive batched once per editor tick)
+Viber.addNoteListener(handleNoteOn, handleNoteOff);
 
 // p5 instance-mode sketch (works under ES modules)
 new p5((p) => {
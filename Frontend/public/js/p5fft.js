@@ -1,15 +1,20 @@
 import * as Juce from "./juce/index.js";
+import * as Viber from "./juce/viber.js";
 
-// Simple p5.js FFT visualizer that listens for 'fftframe' events
+// Simple p5.js FFT visualizer that listens for Viber's spectrum frames
 const sketchContainer = "sketch";
 let currFFTFrame = null;
+let currPeaks = null;
 
-window.__JUCE__.backend.addEventListener("fftframe", (event) => {
-  const payload = typeof event === 'string' ? event : (event?.detail ?? '');
-  if (typeof payload === 'string' && payload.length) {
-    const magnitudeArray = payload.split(',').map(parseFloat);
-    currFFTFrame = magnitudeArray;
-  }
+// Bars only need display resolution; the plugin reduces to log-spaced bands for us
+Viber.setBandLayout("log", 128);
+Viber.subscribeStreams(["mix"]);
+// Smoothed bars with held peaks, both computed by the plugin
+Viber.setBallistics({ profile: "smooth", peaks: true, peakHoldMs: 500, peakDecayDbPerSecond: 20 });
+
+Viber.addSpectrumFrameListener((frame) => {
+  currFFTFrame = frame.bins;
+  currPeaks = frame.peaks;
 });
 
 new p5((p) => {
@@ -48,6 +53,12 @@ new p5((p) => {
       p.fill(hue % 255, 200, 255);
       p.noStroke();
       p.rect(x, p.height - h, barW, h);
+
+      if (currPeaks) {
+        const peakY = p.height - p.constrain(currPeaks[i] || 0, 0, 1) * p.height;
+        p.fill(255);
+        p.rect(x, peakY - 1, barW, 2);
+      }
     }
   };
 });
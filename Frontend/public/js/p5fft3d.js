@@ -1,6 +1,7 @@
 import * as Juce from "./juce/index.js";
+import * as Viber from "./juce/viber.js";
 
-// p5fft3d.js - 3D waterfall-style FFT visualizer using Viber's fftframe events
+// p5fft3d.js - 3D waterfall-style FFT visualizer using Viber's spectrum frames
 
 const windowSize = 50;
 class SlidingWindow {
@@ -25,6 +26,12 @@ class SlidingWindow {
         }
     }
 
+    // Forget everything pushed so far
+    clear() {
+        this.currentIndex = 0;
+        this.count = 0;
+    }
+
     // Get the ith element (from the back of the buffer)
     get(i) {
         if (i >= this.count) {
@@ -43,13 +50,31 @@ class SlidingWindow {
 const buffer = new SlidingWindow(windowSize);
 
 
-let currFFTFrame = null;
-// Listen for fftframe events (string payload of comma-separated magnitudes)
-window.__JUCE__.backend.addEventListener('fftframe', (event) => {
-  const payload = typeof event === 'string' ? event : (event?.detail ?? '');
-  if (typeof payload === 'string' && payload.length) {
-    const mags = payload.split(',').map(s => parseFloat(s) || 0);
-    currFFTFrame = mags;
+function energyFromBands(spec, startFrac, endFrac) {
+  if (!spec || !spec.length) return 0;
+  const start = Math.floor(spec.length * startFrac);
+  const end = Math.max(start + 1, Math.floor(spec.length * endFrac));
+  let sum = 0;
+  for (let i = start; i < end; ++i) sum += spec[i];
+  return sum / (end - start + 1);
+}
+
+// The sketch samples ~20 points per row, so 64 log bands is plenty
+Viber.setBandLayout("log", 64);
+Viber.subscribeStreams(["mix"]);
+Viber.setBallistics("off");
+Viber.setSpectrogramStream("mix");
+
+// One row per analysis frame from the plugin's history, so the waterfall
+// scrolls at the analysis rate whatever the display rate, and opening the
+// editor shows the last few seconds straight away
+Viber.addSpectrogramListener((rows, restarted) => {
+  if (restarted) buffer.clear();
+
+  for (const row of rows.slice(-windowSize)) {
+    const energyb = energyFromBands(row.values, 0, 0.25);  // log bands: lowest quarter is roughly < 100 Hz
+    const energyt = energyFromBands(row.values, 0.6, 1);   // and the top 40% roughly > 1.2 kHz
+    buffer.push([row.values, energyb, energyt]);
   }
 });
 
@@ -68,15 +93,6 @@ new p5((p) => {
 
   p.windowResized = () => p.resizeCanvas(p.windowWidth, p.windowHeight);
 
-  function energyFromBands(spec, startFrac, endFrac) {
-    if (!spec || !spec.length) return 0;
-    const start = Math.floor(spec.length * startFrac);
-    const end = Math.max(start + 1, Math.floor(spec.length * endFrac));
-    let sum = 0;
-    for (let i = start; i < end; ++i) sum += spec[i];
-    return sum / (end - start + 1);
-  }
-
   p.draw = () => {
     p.background(20);
     p.fill(255, 255, 255, 10);
@@ -85,10 +101,7 @@ new p5((p) => {
 
     p.orbitControl(1, 1, 1);
 
-    let spectrum = currFFTFrame;
-    const energyb = energyFromBands(spectrum, 0, 0.1);
-    const energyt = energyFromBands(spectrum, 0.5, 1);
-    buffer.push([spectrum, energyb, energyt]);
+    if (buffer.count === 0) return;
 
     for (let x = -rx; x <= rx; x += ix) {
 
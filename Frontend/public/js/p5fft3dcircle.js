@@ -1,6 +1,7 @@
 import * as Juce from "./juce/index.js";
+import * as Viber from "./juce/viber.js";
 
-// p5fft3d.js - 3D waterfall-style FFT visualizer using Viber's fftframe events
+// p5fft3d.js - 3D waterfall-style FFT visualizer using Viber's spectrum frames
 
 // Configuration: tweak these to change behaviour/appearance
 // - `NUM_CIRCLES`: how many FFT frames (circles) are kept in the history (time depth)
@@ -53,13 +54,14 @@ const buffer = new SlidingWindow(NUM_CIRCLES);
 
 
 let currFFTFrame = null;
-// Listen for fftframe events (string payload of comma-separated magnitudes)
-window.__JUCE__.backend.addEventListener('fftframe', (event) => {
-  const payload = typeof event === 'string' ? event : (event?.detail ?? '');
-  if (typeof payload === 'string' && payload.length) {
-    const mags = payload.split(',').map(s => parseFloat(s) || 0);
-    currFFTFrame = mags;
-  }
+// The sketch samples ~20 points per row, so 64 log bands is plenty
+Viber.setBandLayout("log", 64);
+Viber.subscribeStreams(["mix"]);
+Viber.setBallistics("off");
+
+// Newest frame each animation frame (binary frames decoded into a Float32Array)
+Viber.addSpectrumFrameListener((frame) => {
+  currFFTFrame = frame.bins;
 });
 
 new p5((p) => {
@@ -109,8 +111,8 @@ new p5((p) => {
     p.orbitControl(1, 1, 1);
 
     let spectrum = currFFTFrame;
-    const energyb = energyFromBands(spectrum, 0, 0.1);
-    const energyt = energyFromBands(spectrum, 0.5, 1);
+    const energyb = energyFromBands(spectrum, 0, 0.25);  // log bands: lowest quarter is roughly < 100 Hz
+    const energyt = energyFromBands(spectrum, 0.6, 1);   // and the top 40% roughly > 1.2 kHz
     buffer.push([spectrum, energyb, energyt]);
 
     for (let x = -rx; x <= rx; x += ix) {
@@ -1,4 +1,6 @@
 // selector.js - dynamic sketch loader
+import { addPerfStatsListener, getVisualiser, setVisualiser } from './juce/viber.js';
+
 const sketches = [
   './p5animation.js',
   './p5fft3dcircle.js',
@@ -7,6 +9,9 @@ const sketches = [
   // './threeanimation.js'
 ];
 
+// './p5fft3d.js' -> 'p5fft3d', the name saved with the session
+const sketchName = (path) => path.replace(/^.*\//, '').replace(/\.js$/, '');
+
 let state = {
   index: -1,
   mod: null,
@@ -61,6 +66,7 @@ async function loadSketch(index) {
     else if (typeof stopper === 'function') state.cleanup = () => stopper();
     else state.cleanup = null;
     console.log('Sketch loaded:', path, 'current index:', state.index);
+    setVisualiser(sketchName(path));
   } catch (err) {
     console.error('Failed to load sketch:', path, err);
   }
@@ -77,6 +83,29 @@ function setupButton() {
   btn.addEventListener('click', () => nextSketch());
 }
 
+// Press "p" to toggle a DSP load / frame latency overlay fed by the perfstats event
+function setupPerfOverlay() {
+  const overlay = document.getElementById('perfoverlay');
+  if (!overlay) return;
+
+  const ms = (micros) => (micros / 1000).toFixed(2);
+
+  addPerfStatsListener((stats) => {
+    if (overlay.hidden) return;
+    const { processBlock, fft, decibels, encode, frameLatency, avSync } = stats.stages;
+    overlay.textContent =
+      `#${stats.instance}  DSP ${(stats.dspLoad * 100).toFixed(1)}%\n` +
+      `processBlock p99 ${ms(processBlock.p99)} ms  max ${ms(processBlock.max)} ms\n` +
+      `fft p50 ${ms(fft.p50)} ms  dB p50 ${ms(decibels.p50)} ms\n` +
+      `encode p50 ${ms(encode.p50)} ms  frame latency p50 ${ms(frameLatency.p50)} ms\n` +
+      `shown after audio p50 ${ms(avSync.p50)} ms  p99 ${ms(avSync.p99)} ms`;
+  });
+
+  document.addEventListener('keydown', (e) => {
+    if (e.key === 'p') overlay.hidden = !overlay.hidden;
+  });
+}
+
 // Expose API for easy switching
 window.SketchSelector = {
   loadSketch,
@@ -85,9 +114,14 @@ window.SketchSelector = {
   getCurrentIndex: () => state.index
 };
 
-document.addEventListener('DOMContentLoaded', () => {
+document.addEventListener('DOMContentLoaded', async () => {
   setupButton();
-  loadSketch(0);
+  setupPerfOverlay();
+
+  // Reopen on the sketch the session was saved with
+  let saved = '';
+  try { saved = await getVisualiser(); } catch (e) { console.warn('No saved sketch', e); }
+  loadSketch(Math.max(0, sketches.findIndex((path) => sketchName(path) === saved)));
 });
 
 export default window.SketchSelector;
@@ -1,4 +1,5 @@
 import * as Juce from "./juce/index.js";
+import * as Viber from "./juce/viber.js";
 import * as THREE from 'three';
 
 console.log("--- Running JUICE Backend ---");
@@ -12,9 +13,8 @@ renderer.setClearColor(0x111111);
 document.body.appendChild(renderer.domElement);
 
 // FFT
-window.__JUCE__.backend.addEventListener("fftframe", (event) => {
-    const magnitudeArray = event.split(',').map(parseFloat);
-    // console.log("FFT Frame:", magnitudeArray);
+Viber.addSpectrumFrameListener((frame) => {
+    // console.log("FFT Frame:", frame.bins);
 });
 
 // Lighting
@@ -67,9 +67,8 @@ window.addEventListener('resize', () => {
     renderer.setSize(window.innerWidth, window.innerHeight);
 });
 
-// JUCE notechange handler
-window.__JUCE__.backend.addEventListener("notechange", (event) => {
-    const noteName = typeof event === "string" ? event : event?.detail ?? event;
+// JUCE note-on handler
+Viber.addNoteListener((noteName) => {
     console.log("Note change event:", noteName);
     const index = noteMap[noteName];
     if (index !== undefined) {
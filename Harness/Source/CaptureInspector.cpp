@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    CaptureInspector.cpp
+
+  ==============================================================================
+*/
+
+#include "CaptureInspector.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double secondsSince (Clock::time_point start)
+{
+    return std::chrono::duration<double> (Clock::now() - start).count();
+}
+
+juce::String formatSeconds (double seconds)
+{
+    const auto minutes = (int) (seconds / 60.0);
+    return juce::String (minutes) + ":" + juce::String (seconds - minutes * 60.0, 3).paddedLeft ('0', 6);
+}
+} // namespace
+
+//==============================================================================
+CaptureInspector::CaptureInspector (Settings settingsToUse)
+    : settings (std::move (settingsToUse))
+{
+}
+
+juce::Result CaptureInspector::run (Report& report)
+{
+    CaptureFile capture;
+
+    const auto openStart = Clock::now();
+
+    if (auto result = capture.open (settings.captureFile); result.failed())
+        return result;
+
+    report.openMillis = secondsSince (openStart) * 1000.0;
+    report.file = settings.captureFile.getFullPathName();
+    report.startTime = capture.getStartTime().toISO8601 (true);
+    report.fileBytes = capture.getSize();
+    report.durationSeconds = capture.getDuration();
+
+    std::unique_ptr<juce::FileOutputStream> dump;
+
+    if (settings.dumpFile != juce::File())
+    {
+        settings.dumpFile.deleteFile();
+        dump = std::make_unique<juce::FileOutputStream> (settings.dumpFile);
+
+        if (dump->failedToOpen())
+            return juce::Result::fail ("Can't write " + settings.dumpFile.getFullPathName());
+
+        *dump << "time,sequence,samplePosition,stream,scale,numBins,values...\n";
+    }
+
+    const auto from = juce::jlimit (0.0, capture.getDuration(), settings.fromSeconds);
+    const auto to = settings.toSeconds < 0.0 ? capture.getDuration() : juce::jlimit (from, capture.getDuration(), settings.toSeconds);
+    report.replayedSeconds = to - from;
+
+    std::array<double, numSpectrumStreams> lastFrameTime;
+    lastFrameTime.fill (-1.0);
+
+    const auto replayStart = Clock::now();
+
+    for (int i = capture.findRecord (from); i < capture.getNumRecords(); ++i)
+    {
+        const auto record = capture.getRecord (i);
+
+        if (record.time > to)
+            break;
+
+        // Paced like a live replay: sleep until the record is due
+        if (settings.speed > 0.0)
+        {
+            const auto ahead = (record.time - from) / settings.speed - secondsSince (replayStart);
+
+            if (ahead > 0.001)
+                juce::Thread::sleep (juce::roundToInt (ahead * 1000.0));
+        }
+
+        ++report.numRecords;
+        report.bytesRead += AnalysisCapture::recordHeaderSize + record.size;
+
+        if (record.kind == CaptureFile::RecordKind::midi)
+        {
+            report.numMidiEvents += CaptureFile::getNumMidiEvents (record);
+            continue;
+        }
+
+        if (record.kind != CaptureFile::RecordKind::frame)
+            continue;
+
+        EncodedFrame frame;
+
+        if (! frame.read (record.data, (size_t) record.size) || (int) frame.stream >= numSpectrumStreams)
+        {
+            ++report.numInvalidFrames;
+            continue;
+        }
+
+        const auto stream = (size_t) frame.stream;
+        ++report.numFrames;
+        ++report.framesPerStream[stream];
+        report.numOnsets += frame.onset ? 1 : 0;
+        report.numBeats += frame.beat ? 1 : 0;
+
+        if (lastFrameTime[stream] >= 0.0 && record.time - lastFrameTime[stream] > report.longestGapSeconds)
+        {
+            report.longestGapSeconds = record.time - lastFrameTime[stream];
+            report.longestGapAt = record.time;
+        }
+
+        lastFrameTime[stream] = record.time;
+
+        // Reads every bin in place, which is also what the throughput figure measures
+        float sum = 0.0f;
+
+        for (int bin = 0; bin < frame.numBins; ++bin)
+            sum += frame.getValue (bin);
+
+        const auto mean = frame.numBins > 0 ? sum / (float) frame.numBins : 0.0f;
+
+        if (mean > report.loudestMean)
+        {
+            report.loudestMean = mean;
+            report.loudestAt = record.time;
+        }
+
+        if (dump == nullptr)
+            continue;
+
+        *dump << juce::String (record.time, 6) << ',' << (juce::int64) frame.sequence << ',' << (juce::int64) frame.samplePosition
+              << ',' << getSpectrumStreamNames()[(int) frame.stream] << ',' << frame.scale << ',' << frame.numBins;
+
+        for (int bin = 0; bin < frame.numBins; ++bin)
+            *dump << ',' << juce::String (frame.getValue (bin), 5);
+
+        *dump << '\n';
+    }
+
+    report.wallSeconds = secondsSince (replayStart);
+    return juce::Result::ok();
+}
+
+//==============================================================================
+juce::String CaptureInspector::Report::toString() const
+{
+    juce::String perStream;
+
+    for (int stream = 0; stream < numSpectrumStreams; ++stream)
+        if (framesPerStream[(size_t) stream] > 0)
+            perStream << (perStream.isEmpty() ? "" : ", ") << getSpectrumStreamNames()[stream] << ' ' << framesPerStream[(size_t) stream];
+
+    juce::String s;
+    s << "capture            " << file << " (" << fileBytes << " bytes, started " << startTime << ")\n"
+      << "replayed           " << juce::String (replayedSeconds, 2) << " of " << juce::String (durationSeconds, 2) << " s in "
+      << juce::String (wallSeconds, 3) << " s, " << juce::String (getMegabytesPerSecond(), 1) << " MB/s, indexed in "
+      << juce::String (openMillis, 2) << " ms\n"
+      << "records            " << numRecords << ": " << numFrames << " frames (" << (perStream.isEmpty() ? "none" : perStream) << "), "
+      << numMidiEvents << " MIDI events\n"
+      << "features           " << numOnsets << " onsets, " << numBeats << " beats\n"
+      << "longest gap        " << juce::String (longestGapSeconds * 1000.0, 1) << " ms between frames, ending at "
+      << formatSeconds (longestGapAt) << "\n"
+      << "loudest frame      mean " << juce::String (loudestMean, 3) << " at " << formatSeconds (loudestAt) << "\n";
+
+    if (numInvalidFrames > 0)
+        s << "invalid frames     " << numInvalidFrames << " not in the current frame format\n";
+
+    return s;
+}
+
+juce::var CaptureInspector::Report::toVar() const
+{
+    juce::Array<juce::var> perStream;
+
+    for (const auto count : framesPerStream)
+        perStream.add (count);
+
+    auto* object = new juce::DynamicObject();
+    object->setProperty ("file", file);
+    object->setProperty ("startTime", startTime);
+    object->setProperty ("fileBytes", fileBytes);
+    object->setProperty ("durationSeconds", durationSeconds);
+    object->setProperty ("replayedSeconds", replayedSeconds);
+    object->setProperty ("openMillis", openMillis);
+    object->setProperty ("wallSeconds", wallSeconds);
+    object->setProperty ("bytesRead", bytesRead);
+    object->setProperty ("megabytesPerSecond", getMegabytesPerSecond());
+    object->setProperty ("records", numRecords);
+    object->setProperty ("frames", numFrames);
+    object->setProperty ("framesPerStream", perStream);
+    object->setProperty ("invalidFrames", numInvalidFrames);
+    object->setProperty ("midiEvents", numMidiEvents);
+    object->setProperty ("onsets", numOnsets);
+    object->setProperty ("beats", numBeats);
+    object->setProperty ("longestGapSeconds", longestGapSeconds);
+    object->setProperty ("longestGapAt", longestGapAt);
+    object->setProperty ("loudestMean", loudestMean);
+    object->setProperty ("loudestAt", loudestAt);
+    return juce::var (object);
+}
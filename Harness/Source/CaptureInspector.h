@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    CaptureInspector.h
+    Replays a capture recorded by the plugin and reports what is in it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/CaptureFile.h"
+
+//==============================================================================
+/**
+    Walks a CaptureFile in time order, as fast as it will go or paced at some
+    multiple of real time, reading each frame where it lies in the mapping.
+    Reports how the frames and MIDI events are spread over the streams, what
+    the features flagged, and where to look for trouble: the longest gap
+    between frames of one stream and the loudest frame. Optionally writes the
+    frames to a CSV file in the same form as the run command's --dump.
+*/
+class CaptureInspector
+{
+public:
+    struct Settings
+    {
+        juce::File captureFile;
+        double speed = 0.0;                     // multiple of real time, 0 for as fast as possible
+        double fromSeconds = 0.0;
+        double toSeconds = -1.0;                // the end when negative
+        juce::File dumpFile;                    // CSV of every frame replayed, when set
+    };
+
+    struct Report
+    {
+        juce::String file;
+        juce::String startTime;                 // when the capture started, ISO 8601
+        juce::int64 fileBytes = 0;              // committed records plus the header
+        double durationSeconds = 0.0;           // of the whole capture
+        double replayedSeconds = 0.0;           // from --from to --to
+        double openMillis = 0.0;                // mapping and indexing the file
+        double wallSeconds = 0.0;               // replaying it
+        juce::int64 bytesRead = 0;
+
+        int numRecords = 0;
+        int numFrames = 0;
+        std::array<int, numSpectrumStreams> framesPerStream {};
+        int numInvalidFrames = 0;               // not in the current frame format
+        int numMidiEvents = 0;
+        int numOnsets = 0, numBeats = 0;
+
+        double longestGapSeconds = 0.0;         // between consecutive frames of one stream
+        double longestGapAt = 0.0;              // where that gap ends
+        float loudestMean = 0.0f;               // highest mean bin value of a frame, 0..1
+        double loudestAt = 0.0;
+
+        double getMegabytesPerSecond() const noexcept  { return wallSeconds > 0.0 ? (double) bytesRead / (1024.0 * 1024.0) / wallSeconds : 0.0; }
+
+        juce::String toString() const;
+        juce::var toVar() const;
+    };
+
+    explicit CaptureInspector (Settings settingsToUse);
+
+    /** Opens the capture, replays the chosen span and fills `report`. Fails if the
+        capture can't be read or the dump file can't be written.
+    */
+    juce::Result run (Report& report);
+
+private:
+    Settings settings;
+
+    JUCE_DECLARE_NON_COPYABLE (CaptureInspector)
+};
@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    KernelBenchmarks.cpp
+
+  ==============================================================================
+*/
+
+#include "KernelBenchmarks.h"
+#include "../../Source/SpectrumKernels.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int numRuns = 7;
+constexpr int callsPerRun = 2000;
+
+// Best of numRuns runs of callsPerRun calls, so one-off scheduling noise doesn't count
+template <typename Function>
+double bestNanosPerCall (Function&& function)
+{
+    auto best = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        const auto start = Clock::now();
+
+        for (int i = 0; i < callsPerRun; ++i)
+            function();
+
+        const auto nanos = std::chrono::duration<double, std::nano> (Clock::now() - start).count();
+        best = juce::jmin (best, nanos / callsPerRun);
+    }
+
+    return best;
+}
+
+// Keeps the optimiser from discarding results nobody reads
+volatile float sink = 0.0f;
+
+void fillRandom (float* dest, int num, juce::Random& random, float scale)
+{
+    for (int i = 0; i < num; ++i)
+        dest[i] = (random.nextFloat() * 2.0f - 1.0f) * scale;
+}
+} // namespace
+
+//==============================================================================
+bool KernelBenchmarks::DecibelAccuracy::isWithinBounds() const noexcept
+{
+    // One 8-bit display step is 1/255; the kernel must stay far below it
+    return maxLog2Error <= SpectrumKernels::maxLog2Error && maxNormalisedError < 1.0e-4f;
+}
+
+KernelBenchmarks::Timing KernelBenchmarks::timeDownmix (int numChannels, int blockSize)
+{
+    juce::Random random (1);
+    juce::AudioBuffer<float> channels (numChannels, blockSize);
+    std::vector<float> dest ((size_t) blockSize);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        fillRandom (channels.getWritePointer (ch), blockSize, random, 1.0f);
+
+    const auto* const* pointers = channels.getArrayOfReadPointers();
+
+    Timing timing;
+    timing.referenceNanos = bestNanosPerCall ([&] {
+        SpectrumKernels::downmixReference (pointers, numChannels, 0, blockSize, dest.data());
+        sink = sink + dest[0];
+    });
+    timing.vectorNanos = bestNanosPerCall ([&] {
+        sink = sink + SpectrumKernels::downmix (pointers, numChannels, 0, blockSize, dest.data())[0];
+    });
+    return timing;
+}
+
+KernelBenchmarks::Timing KernelBenchmarks::timeDecibels (int numBins)
+{
+    juce::Random random (2);
+    std::vector<float> magnitudes ((size_t) numBins), dest ((size_t) numBins);
+
+    for (auto& m : magnitudes)
+        m = std::pow (10.0f, random.nextFloat() * 8.0f - 7.0f);     // -140 dB .. +20 dB
+
+    const auto floorDb = SpectrumKernels::defaultFloorDb;
+    const auto ceilingDb = SpectrumKernels::defaultCeilingDb;
+
+    Timing timing;
+    timing.referenceNanos = bestNanosPerCall ([&] {
+        SpectrumKernels::magnitudesToNormalisedDbReference (magnitudes.data(), dest.data(), numBins, floorDb, ceilingDb);
+        sink = sink + dest[0];
+    });
+    timing.vectorNanos = bestNanosPerCall ([&] {
+        SpectrumKernels::magnitudesToNormalisedDb (magnitudes.data(), dest.data(), numBins, floorDb, ceilingDb);
+        sink = sink + dest[0];
+    });
+    return timing;
+}
+
+KernelBenchmarks::Timing KernelBenchmarks::timeGainAndMeasure (int blockSize)
+{
+    juce::Random random (4);
+    std::vector<float> samples ((size_t) blockSize);
+    fillRandom (samples.data(), blockSize, random, 0.5f);
+
+    // A ramp that averages to unity, so thousands of calls on the same block don't drift far
+    constexpr float startGain = 0.999f, endGain = 1.001f;
+
+    Timing timing;
+    timing.referenceNanos = bestNanosPerCall ([&] {
+        sink = sink + SpectrumKernels::applyGainAndMeasureReference (samples.data(), blockSize, startGain, endGain).sumSquares;
+    });
+    timing.vectorNanos = bestNanosPerCall ([&] {
+        sink = sink + SpectrumKernels::applyGainAndMeasure (samples.data(), blockSize, startGain, endGain).sumSquares;
+    });
+    return timing;
+}
+
+KernelBenchmarks::DecibelAccuracy KernelBenchmarks::checkDecibelAccuracy()
+{
+    DecibelAccuracy accuracy;
+
+    // Geometric sweep over the whole range the analyser can produce
+    for (double x = 1.0e-19; x < 1.0e6; x *= 1.0001)
+    {
+        const auto error = std::abs ((double) SpectrumKernels::fastLog2 ((float) x) - std::log2 ((double) (float) x));
+        accuracy.maxLog2Error = juce::jmax (accuracy.maxLog2Error, (float) error);
+    }
+
+    juce::Random random (3);
+    constexpr int numBins = 8192;
+    std::vector<float> magnitudes ((size_t) numBins), fast ((size_t) numBins), reference ((size_t) numBins);
+
+    for (auto& m : magnitudes)
+        m = std::pow (10.0f, random.nextFloat() * 8.0f - 7.0f);
+
+    SpectrumKernels::magnitudesToNormalisedDb (magnitudes.data(), fast.data(), numBins, -100.0f, 0.0f);
+    SpectrumKernels::magnitudesToNormalisedDbReference (magnitudes.data(), reference.data(), numBins, -100.0f, 0.0f);
+
+    for (int i = 0; i < numBins; ++i)
+        accuracy.maxNormalisedError = juce::jmax (accuracy.maxNormalisedError, std::abs (fast[(size_t) i] - reference[(size_t) i]));
+
+    return accuracy;
+}
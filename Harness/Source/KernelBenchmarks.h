@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    KernelBenchmarks.h
+    Before/after timings and accuracy checks for SpectrumKernels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Times each vectorised kernel against the scalar reference it replaced, on
+    the same inputs, and checks that the fast dB kernel stays within its
+    documented error bound.
+*/
+namespace KernelBenchmarks
+{
+    struct Timing
+    {
+        double referenceNanos = 0.0;    // per call, best of several runs
+        double vectorNanos = 0.0;
+
+        double getSpeedup() const noexcept  { return vectorNanos > 0.0 ? referenceNanos / vectorNanos : 0.0; }
+    };
+
+    struct DecibelAccuracy
+    {
+        float maxLog2Error = 0.0f;          // fastLog2 against std::log2 over 1e-19 .. 1e6
+        float maxNormalisedError = 0.0f;    // magnitudesToNormalisedDb against the reference on random magnitudes
+
+        bool isWithinBounds() const noexcept;
+    };
+
+    /** SpectrumKernels::downmix against downmixReference for one block. */
+    Timing timeDownmix (int numChannels, int blockSize);
+
+    /** magnitudesToNormalisedDb against magnitudesToNormalisedDbReference for one frame. */
+    Timing timeDecibels (int numBins);
+
+    /** applyGainAndMeasure against applyGainAndMeasureReference for one channel of a block. */
+    Timing timeGainAndMeasure (int blockSize);
+
+    DecibelAccuracy checkDecibelAccuracy();
+}
@@ -0,0 +1,316 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    ViberHarness: runs the Viber processor offline, without a DAW, and reports
+    how long processBlock takes, how many frames it produces and whether it
+    allocates or locks. Also benchmarks the analyser's kernels against their
+    references, and replays captures recorded by the plugin.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "OfflineRunner.h"
+#include "KernelBenchmarks.h"
+#include "CaptureInspector.h"
+
+namespace {
+constexpr auto runHelp = R"(Input (default: 10 s of a 1 kHz sine, stereo, 48 kHz):
+  --wav=<file>              analyse an audio file instead (WAV, AIFF, ...)
+  --signal=<name>           sine | sweep | noise | silence
+  --frequency=<hz>          sine frequency, default 1000
+  --seconds=<s>             length of the synthetic signal, default 10
+  --channels=<1|2>          main input channels, default 2
+  --sidechain=<name>        also feed a stereo sidechain with this signal
+  --midi=<file>             play a MIDI file alongside the audio
+  --rate=<hz>               sample rate, default 48000
+  --block=<samples>         block size, default 512
+
+Analysis:
+  --param=<id>=<value>      set a parameter, e.g. --param=fftOrder=12 (repeatable)
+  --streams=<a,b,...>       mix, left, right, mid, side, sidechain (default mix)
+  --bands=<scale>[:<n>]     linear | log | mel | thirdoctave, e.g. --bands=log:128
+  --ballistics=<profile>    off | smooth | average | peakhold
+  --features=<stream>       extract onsets, tempo, shape and pitch from this stream
+                            (subscribing it too) and report what was found
+  --save-spectrogram        include the spectrogram in the saved state the report times
+  --realtime                pace blocks in real time and analyse on the worker thread
+  --instances=<n>           run n processors side by side on the same input, and report
+                            what creating each cost and what sharing saved; compare
+                            processBlock times against --instances=1 for the CPU side
+
+Output:
+  --dump=<file.csv>         write every spectrum frame, one per line
+  --capture=<file>          also record a capture of the run, as the plugin does live
+  --json                    print the report as JSON
+  --max-p99-us=<us>         exit with code 2 if p99 processBlock time is higher
+  --rt-report               print every call site that allocated, freed or locked
+                            inside processBlock or the analysis pass, with its stack
+  --max-allocs=<n>          exit with code 2 if any block allocates more than n times
+  --max-rt-violations=<n>   exit with code 2 if there are more than n realtime violations)";
+
+constexpr auto replayHelp = R"(Reads a capture recorded by the plugin or by run --capture, in place through a
+memory mapping, and reports its frames, MIDI events and features, the longest
+gap between frames and the loudest frame.
+
+  --speed=<x>               pace the replay at x times real time, default 0: as fast as possible
+  --from=<s>                start this many seconds in
+  --to=<s>                  stop this many seconds in
+  --dump=<file.csv>         write every replayed frame, one per line, after its time
+  --json                    print the report as JSON)";
+
+OfflineRunner::Signal parseSignal (const juce::String& name)
+{
+    if (name == "sine")     return OfflineRunner::Signal::sine;
+    if (name == "sweep")    return OfflineRunner::Signal::sweep;
+    if (name == "noise")    return OfflineRunner::Signal::noise;
+    if (name == "silence")  return OfflineRunner::Signal::silence;
+
+    juce::ConsoleApplication::fail ("Unknown signal: " + name);
+    return {};
+}
+
+juce::String getOption (const juce::ArgumentList& args, const juce::String& option, const juce::String& fallback)
+{
+    return args.containsOption (option) ? args.getValueForOption (option) : fallback;
+}
+
+OfflineRunner::Settings parseRunSettings (const juce::ArgumentList& args)
+{
+    OfflineRunner::Settings settings;
+
+    settings.sampleRate = getOption (args, "--rate", "48000").getDoubleValue();
+    settings.blockSize = getOption (args, "--block", "512").getIntValue();
+    settings.numChannels = getOption (args, "--channels", "2").getIntValue();
+    settings.seconds = getOption (args, "--seconds", "10").getDoubleValue();
+    settings.signal = parseSignal (getOption (args, "--signal", "sine"));
+    settings.frequency = getOption (args, "--frequency", "1000").getFloatValue();
+    settings.realtime = args.containsOption ("--realtime");
+    settings.numInstances = getOption (args, "--instances", "1").getIntValue();
+    settings.saveSpectrogram = args.containsOption ("--save-spectrogram");
+
+    if (settings.sampleRate <= 0.0 || settings.blockSize <= 0 || settings.seconds <= 0.0 || settings.numInstances <= 0
+        || ! juce::isPositiveAndBelow (settings.numChannels - 1, 2))
+        juce::ConsoleApplication::fail ("--rate, --block, --seconds and --instances must be positive and --channels 1 or 2");
+
+    if (args.containsOption ("--wav"))
+        settings.inputFile = args.getExistingFileForOption ("--wav");
+
+    if (args.containsOption ("--midi"))
+        settings.midiFile = args.getExistingFileForOption ("--midi");
+
+    if (args.containsOption ("--sidechain"))
+        settings.sidechain = parseSignal (args.getValueForOption ("--sidechain"));
+
+    if (args.containsOption ("--dump"))
+        settings.dumpFile = args.getFileForOption ("--dump");
+
+    if (args.containsOption ("--capture"))
+        settings.captureFile = args.getFileForOption ("--capture");
+
+    // --param may appear several times, which getValueForOption can't express
+    for (const auto& arg : args.arguments)
+    {
+        if (arg != "--param")
+            continue;
+
+        const auto assignment = arg.getLongOptionValue();
+
+        if (! assignment.contains ("="))
+            juce::ConsoleApplication::fail ("Expected --param=<id>=<value>, got " + arg.text);
+
+        settings.parameters.set (assignment.upToFirstOccurrenceOf ("=", false, false),
+                                 assignment.fromFirstOccurrenceOf ("=", false, false));
+    }
+
+    if (args.containsOption ("--streams"))
+    {
+        settings.streams = 0;
+
+        for (const auto& name : juce::StringArray::fromTokens (args.getValueForOption ("--streams"), ",", {}))
+        {
+            const auto index = spectrumStreamFromName (name.trim());
+
+            if (index < 0)
+                juce::ConsoleApplication::fail ("Unknown stream: " + name);
+
+            settings.streams |= SpectrumAnalyser::streamBit ((SpectrumStream) index);
+        }
+    }
+
+    if (args.containsOption ("--features"))
+    {
+        const auto name = args.getValueForOption ("--features");
+        settings.featureStream = spectrumStreamFromName (name);
+
+        if (settings.featureStream < 0)
+            juce::ConsoleApplication::fail ("Unknown stream: " + name);
+
+        settings.streams |= SpectrumAnalyser::streamBit ((SpectrumStream) settings.featureStream);
+    }
+
+    if (args.containsOption ("--bands"))
+    {
+        const auto bands = args.getValueForOption ("--bands");
+        settings.bandLayout.scale = BandMap::scaleFromName (bands.upToFirstOccurrenceOf (":", false, false));
+        settings.bandLayout.numBands = bands.fromFirstOccurrenceOf (":", false, false).getIntValue();
+    }
+
+    if (args.containsOption ("--ballistics"))
+    {
+        const auto name = args.getValueForOption ("--ballistics");
+
+        if (! SpectrumBallistics::getProfileNames().contains (name, true))
+            juce::ConsoleApplication::fail ("Unknown ballistics profile: " + name);
+
+        settings.ballistics = SpectrumBallistics::getProfileSettings (SpectrumBallistics::profileFromName (name));
+    }
+
+    return settings;
+}
+
+void runCommand (const juce::ArgumentList& args)
+{
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << "run [options]\n\n" << runHelp << std::endl;
+        return;
+    }
+
+    OfflineRunner runner (parseRunSettings (args));
+    OfflineRunner::Report report;
+
+    if (const auto result = runner.run (report); result.failed())
+        juce::ConsoleApplication::fail (result.getErrorMessage());
+
+    if (args.containsOption ("--json"))
+        std::cout << juce::JSON::toString (report.toVar()) << std::endl;
+    else
+        std::cout << report.toString();
+
+    if (args.containsOption ("--rt-report") && ! args.containsOption ("--json"))
+        std::cout << "\n" << report.realtimeReport;
+
+    if (args.containsOption ("--max-p99-us")
+        && report.p99Micros > args.getValueForOption ("--max-p99-us").getDoubleValue())
+        juce::ConsoleApplication::fail ("p99 processBlock time over the limit", 2);
+
+    if (args.containsOption ("--max-allocs")
+        && (double) report.maxAllocationsInBlock > args.getValueForOption ("--max-allocs").getDoubleValue())
+        juce::ConsoleApplication::fail ("processBlock allocated more than the limit", 2);
+
+    if (args.containsOption ("--max-rt-violations")
+        && (double) report.realtimeViolations > args.getValueForOption ("--max-rt-violations").getDoubleValue())
+        juce::ConsoleApplication::fail ("more realtime violations than the limit", 2);
+}
+
+void replayCommand (const juce::ArgumentList& args)
+{
+    if (args.containsOption ("--help|-h") || args.size() < 2)
+    {
+        std::cout << "replay <capture> [options]\n\n" << replayHelp << std::endl;
+        return;
+    }
+
+    CaptureInspector::Settings settings;
+    settings.captureFile = args[1].resolveAsExistingFile();
+    settings.speed = getOption (args, "--speed", "0").getDoubleValue();
+    settings.fromSeconds = getOption (args, "--from", "0").getDoubleValue();
+    settings.toSeconds = getOption (args, "--to", "-1").getDoubleValue();
+
+    if (args.containsOption ("--dump"))
+        settings.dumpFile = args.getFileForOption ("--dump");
+
+    CaptureInspector inspector (settings);
+    CaptureInspector::Report report;
+
+    if (const auto result = inspector.run (report); result.failed())
+        juce::ConsoleApplication::fail (result.getErrorMessage());
+
+    if (args.containsOption ("--json"))
+        std::cout << juce::JSON::toString (report.toVar()) << std::endl;
+    else
+        std::cout << report.toString();
+}
+
+void benchCommand (const juce::ArgumentList& args)
+{
+    const auto blockSize = getOption (args, "--block", "512").getIntValue();
+
+    std::cout << "downmix, " << blockSize << "-sample block      reference ns   vector ns   speedup\n";
+
+    for (const int numChannels : { 1, 2, 8 })
+    {
+        const auto timing = KernelBenchmarks::timeDownmix (numChannels, blockSize);
+        std::cout << "  " << numChannels << " channel(s)                 "
+                  << juce::String (timing.referenceNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.vectorNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.getSpeedup(), 1).paddedLeft (' ', 7) << "x\n";
+    }
+
+    std::cout << "\ndB kernel                       reference ns   vector ns   speedup\n";
+
+    for (const int numBins : { 128, 512, 8192 })
+    {
+        const auto timing = KernelBenchmarks::timeDecibels (numBins);
+        std::cout << "  " << juce::String (numBins).paddedRight (' ', 5) << " bins                   "
+                  << juce::String (timing.referenceNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.vectorNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.getSpeedup(), 1).paddedLeft (' ', 7) << "x\n";
+    }
+
+    std::cout << "\ngain and meters, one channel     reference ns   vector ns   speedup\n";
+
+    for (const int numSamples : { 64, blockSize, 4096 })
+    {
+        const auto timing = KernelBenchmarks::timeGainAndMeasure (numSamples);
+        std::cout << "  " << juce::String (numSamples).paddedRight (' ', 5) << " samples                "
+                  << juce::String (timing.referenceNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.vectorNanos, 1).paddedLeft (' ', 10) << "  "
+                  << juce::String (timing.getSpeedup(), 1).paddedLeft (' ', 7) << "x\n";
+    }
+
+    const auto accuracy = KernelBenchmarks::checkDecibelAccuracy();
+    std::cout << "\ndB kernel accuracy: max log2 error " << accuracy.maxLog2Error
+              << ", max normalised difference " << accuracy.maxNormalisedError << std::endl;
+
+    if (! accuracy.isWithinBounds())
+        juce::ConsoleApplication::fail ("dB kernel error is over its documented bound", 2);
+}
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor's parameter tree and worker thread expect JUCE's message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ConsoleApplication app;
+    app.addHelpCommand ("--help|-h", "ViberHarness: offline runs and benchmarks of the Viber processor", true);
+    app.addVersionCommand ("--version|-v", "ViberHarness 1.0");
+
+    app.addCommand ({ "run",
+                      "run [options]",
+                      "Feeds audio and MIDI through processBlock faster than realtime and reports timing",
+                      runHelp,
+                      runCommand });
+
+    app.addCommand ({ "replay",
+                      "replay <capture> [options]",
+                      "Replays a capture recorded by the plugin and reports what is in it",
+                      replayHelp,
+                      replayCommand });
+
+    app.addCommand ({ "bench",
+                      "bench [--block=<samples>]",
+                      "Times the downmix, dB and gain kernels against their scalar references",
+                      "Downmix at 1, 2 and 8 channels, the dB kernel at 128, 512 and 8192 bins, the\n"
+                      "gain and meter kernel at 64, --block and 4096 samples, then checks the dB\n"
+                      "kernel's accuracy. Exits with code 2 if it is out of bounds.",
+                      benchCommand });
+
+    // Commands must come first, so "run --help" is the run command's help
+    return app.findAndRunCommand (juce::ArgumentList (argc, argv), true);
+}
@@ -0,0 +1,499 @@
+/*
+  ==============================================================================
+
+    OfflineRunner.cpp
+
+  ==============================================================================
+*/
+
+#include "OfflineRunner.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double secondsSince (Clock::time_point start)
+{
+    return std::chrono::duration<double> (Clock::now() - start).count();
+}
+
+void generate (OfflineRunner::Signal signal, float frequency, float level, double sampleRate,
+               float* dest, int numSamples, juce::Random& random)
+{
+    using Signal = OfflineRunner::Signal;
+    constexpr auto twoPi = juce::MathConstants<double>::twoPi;
+
+    switch (signal)
+    {
+        case Signal::sine:
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = level * (float) std::sin (twoPi * frequency * i / sampleRate);
+            break;
+
+        case Signal::sweep:
+        {
+            // Phase of an exponential chirp from f0 to f1 over the whole buffer
+            const double f0 = 20.0, f1 = 20000.0;
+            const double duration = numSamples / sampleRate;
+            const double k = std::log (f1 / f0) / duration;
+
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = level * (float) std::sin (twoPi * f0 * (std::exp (k * i / sampleRate) - 1.0) / k);
+            break;
+        }
+
+        case Signal::noise:
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = level * (random.nextFloat() * 2.0f - 1.0f);
+            break;
+
+        case Signal::silence:
+        default:
+            juce::FloatVectorOperations::clear (dest, numSamples);
+            break;
+    }
+}
+
+double percentile (const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    const auto index = (size_t) juce::jlimit (0.0, (double) sorted.size() - 1.0, std::ceil (fraction * (double) sorted.size()) - 1.0);
+    return sorted[index];
+}
+} // namespace
+
+//==============================================================================
+OfflineRunner::OfflineRunner (Settings settingsToUse)
+    : settings (std::move (settingsToUse))
+{
+}
+
+juce::Result OfflineRunner::loadInput()
+{
+    juce::Random random (0x5eed);   // fixed seed, so noise runs are repeatable
+
+    if (settings.inputFile != juce::File())
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (settings.inputFile));
+
+        if (reader == nullptr)
+            return juce::Result::fail ("Can't read audio from " + settings.inputFile.getFullPathName());
+
+        settings.sampleRate = reader->sampleRate;
+        settings.numChannels = juce::jlimit (1, 2, (int) reader->numChannels);
+        input.setSize (settings.numChannels, (int) reader->lengthInSamples);
+        reader->read (&input, 0, input.getNumSamples(), 0, true, settings.numChannels > 1);
+    }
+    else
+    {
+        const auto numSamples = juce::roundToInt (settings.seconds * settings.sampleRate);
+        input.setSize (settings.numChannels, numSamples);
+
+        for (int ch = 0; ch < settings.numChannels; ++ch)
+            generate (settings.signal, settings.frequency, settings.level, settings.sampleRate,
+                      input.getWritePointer (ch), numSamples, random);
+    }
+
+    if (settings.sidechain.has_value())
+    {
+        sidechainInput.setSize (2, input.getNumSamples());
+
+        for (int ch = 0; ch < 2; ++ch)
+            generate (*settings.sidechain, settings.frequency * 2.0f, settings.level, settings.sampleRate,
+                      sidechainInput.getWritePointer (ch), sidechainInput.getNumSamples(), random);
+    }
+
+    return juce::Result::ok();
+}
+
+juce::Result OfflineRunner::loadMidi()
+{
+    if (settings.midiFile == juce::File())
+        return juce::Result::ok();
+
+    juce::FileInputStream stream (settings.midiFile);
+    juce::MidiFile file;
+
+    if (! stream.openedOk() || ! file.readFrom (stream))
+        return juce::Result::fail ("Can't read MIDI from " + settings.midiFile.getFullPathName());
+
+    file.convertTimestampTicksToSeconds();
+
+    for (int track = 0; track < file.getNumTracks(); ++track)
+        midiEvents.addSequence (*file.getTrack (track), 0.0);
+
+    midiEvents.sort();
+    return juce::Result::ok();
+}
+
+juce::Result OfflineRunner::configure (ViberAudioProcessor& processor)
+{
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add (settings.numChannels == 1 ? juce::AudioChannelSet::mono() : juce::AudioChannelSet::stereo());
+    layout.inputBuses.add (settings.sidechain.has_value() ? juce::AudioChannelSet::stereo() : juce::AudioChannelSet::disabled());
+    layout.outputBuses.add (juce::AudioChannelSet::stereo());
+
+    if (! processor.setBusesLayout (layout))
+        return juce::Result::fail ("The processor rejected the bus layout");
+
+    for (const auto& id : settings.parameters.getAllKeys())
+    {
+        juce::RangedAudioParameter* parameter = nullptr;
+
+        for (auto* p : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p); ranged != nullptr && ranged->getParameterID() == id)
+                parameter = ranged;
+
+        if (parameter == nullptr)
+            return juce::Result::fail ("Unknown parameter: " + id);
+
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (settings.parameters[id].getFloatValue()));
+    }
+
+    // Offline bounces analyse inline; realtime runs leave it to the worker like a live host
+    processor.setNonRealtime (! settings.realtime);
+    processor.setRateAndBufferSizeDetails (settings.sampleRate, settings.blockSize);
+    processor.prepareToPlay (settings.sampleRate, settings.blockSize);
+    processor.setSubscribedStreams (settings.streams);
+    processor.setBandLayout (settings.bandLayout);
+    processor.setBallistics (settings.ballistics);
+    processor.setSaveSpectrogram (settings.saveSpectrogram);
+    processor.setFeatureStream (settings.featureStream);
+    return juce::Result::ok();
+}
+
+void OfflineRunner::fillBlock (juce::AudioBuffer<float>& block, juce::MidiBuffer& midi, const ViberAudioProcessor& processor,
+                               int startSample, int numSamples)
+{
+    block.clear();
+
+    for (int ch = 0; ch < input.getNumChannels(); ++ch)
+        block.copyFrom (processor.getChannelIndexInProcessBlockBuffer (true, 0, ch), 0, input, ch, startSample, numSamples);
+
+    for (int ch = 0; ch < sidechainInput.getNumChannels(); ++ch)
+        block.copyFrom (processor.getChannelIndexInProcessBlockBuffer (true, 1, ch), 0, sidechainInput, ch, startSample, numSamples);
+
+    midi.clear();
+    const auto blockEnd = (startSample + numSamples) / settings.sampleRate;
+
+    for (; nextMidiEvent < midiEvents.getNumEvents(); ++nextMidiEvent)
+    {
+        const auto& message = midiEvents.getEventPointer (nextMidiEvent)->message;
+
+        if (message.getTimeStamp() >= blockEnd)
+            break;
+
+        const auto position = juce::roundToInt (message.getTimeStamp() * settings.sampleRate) - startSample;
+        midi.addEvent (message, juce::jlimit (0, numSamples - 1, position));
+    }
+}
+
+int OfflineRunner::drainFrames (ViberAudioProcessor& processor, juce::OutputStream* dump, Report* features)
+{
+    int numFrames = 0;
+
+    while (popSpectrumFrame (processor.getSpectrumFrames(), [dump, features] (const SpectrumFrame& frame) {
+        if (features != nullptr && frame.hasFeatures)
+        {
+            features->hasFeatures = true;
+            features->numOnsets += frame.features.onset ? 1 : 0;
+            features->numBeats += frame.features.beat ? 1 : 0;
+
+            if (frame.features.tempoBpm > 0.0f)
+                features->tempoBpm = frame.features.tempoBpm;
+
+            if (frame.features.pitchHz > 0.0f)
+                features->pitchHz = frame.features.pitchHz;
+        }
+
+        if (dump == nullptr)
+            return;
+
+        *dump << (juce::int64) frame.sequence << ',' << frame.samplePosition << ',' << getSpectrumStreamNames()[(int) frame.stream]
+              << ',' << (int) frame.scale << ',' << frame.numBins;
+
+        for (int i = 0; i < frame.numBins; ++i)
+            *dump << ',' << juce::String (frame.bins[(size_t) i], 5);
+
+        *dump << '\n';
+    }))
+        ++numFrames;
+
+    return numFrames;
+}
+
+void OfflineRunner::measureState (ViberAudioProcessor& processor, Report& report)
+{
+    constexpr int numRepeats = 20;
+    juce::MemoryBlock state;
+
+    const auto saveStart = Clock::now();
+
+    for (int i = 0; i < numRepeats; ++i)
+        processor.getStateInformation (state);
+
+    report.saveStateMicros = secondsSince (saveStart) * 1.0e6 / numRepeats;
+    report.stateBytes = (juce::int64) state.getSize();
+
+    const auto loadStart = Clock::now();
+
+    for (int i = 0; i < numRepeats; ++i)
+        processor.setStateInformation (state.getData(), (int) state.getSize());
+
+    report.loadStateMicros = secondsSince (loadStart) * 1.0e6 / numRepeats;
+}
+
+juce::Result OfflineRunner::run (Report& report)
+{
+    if (auto result = loadInput(); result.failed())
+        return result;
+
+    if (auto result = loadMidi(); result.failed())
+        return result;
+
+    std::vector<std::unique_ptr<ViberAudioProcessor>> processors;
+    processors.reserve ((size_t) settings.numInstances);
+    report.numInstances = settings.numInstances;
+
+    for (int i = 0; i < settings.numInstances; ++i)
+    {
+        const auto bytesBefore = RealtimeSafety::getThreadHeapBytes();
+        const auto createStart = Clock::now();
+
+        processors.push_back (std::make_unique<ViberAudioProcessor>());
+
+        if (auto result = configure (*processors.back()); result.failed())
+            return result;
+
+        const auto millis = secondsSince (createStart) * 1000.0;
+        const auto bytes = RealtimeSafety::getThreadHeapBytes() - bytesBefore;
+
+        if (i == 0)
+        {
+            report.firstInstanceBytes = bytes;
+            report.firstInstanceMillis = millis;
+        }
+        else
+        {
+            report.laterInstanceBytes += (double) bytes / (settings.numInstances - 1);
+            report.laterInstanceMillis += millis / (settings.numInstances - 1);
+        }
+    }
+
+    auto& processor = *processors.front();
+
+    std::unique_ptr<juce::FileOutputStream> dump;
+
+    if (settings.dumpFile != juce::File())
+    {
+        settings.dumpFile.deleteFile();
+        dump = std::make_unique<juce::FileOutputStream> (settings.dumpFile);
+
+        if (dump->failedToOpen())
+            return juce::Result::fail ("Can't write " + settings.dumpFile.getFullPathName());
+
+        *dump << "sequence,samplePosition,stream,scale,numBins,values...\n";
+    }
+
+    // Recording from before the first block, so what it costs shows up in the block times
+    if (settings.captureFile != juce::File())
+        if (auto result = processor.startCapture (settings.captureFile); result.failed())
+            return result;
+
+    const int numChannels = juce::jmax (processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+    juce::AudioBuffer<float> block (numChannels, settings.blockSize);
+    juce::MidiBuffer midi;
+    midi.ensureSize (4096);
+
+    const int totalSamples = input.getNumSamples();
+    std::vector<double> micros;
+    micros.reserve ((size_t) (processors.size() * (size_t) (totalSamples / settings.blockSize + 1)));
+
+    // Only this run's violations, not ones from loading or configuring
+    RealtimeSafety::reset();
+
+    const auto runStart = Clock::now();
+
+    for (int start = 0; start < totalSamples; start += settings.blockSize)
+    {
+        const int numSamples = juce::jmin (settings.blockSize, totalSamples - start);
+
+        // The last block may be short; wrap the same channels rather than resizing
+        juce::AudioBuffer<float> buffer (block.getArrayOfWritePointers(), numChannels, numSamples);
+        const auto blockMidiStart = nextMidiEvent;
+
+        for (auto& instance : processors)
+        {
+            // Every instance gets the same audio and MIDI, and only the first is dumped
+            nextMidiEvent = blockMidiStart;
+            fillBlock (buffer, midi, *instance, start, numSamples);
+
+            const auto allocationsBefore = RealtimeSafety::getThreadAllocationCount();
+            const auto blockStart = Clock::now();
+
+            instance->processBlock (buffer, midi);
+
+            const auto elapsed = secondsSince (blockStart);
+            const auto allocations = RealtimeSafety::getThreadAllocationCount() - allocationsBefore;
+
+            micros.push_back (elapsed * 1.0e6);
+            report.processSeconds += elapsed;
+            report.allocations += allocations;
+            report.maxAllocationsInBlock = juce::jmax (report.maxAllocationsInBlock, allocations);
+            report.blocksWithAllocations += allocations > 0 ? 1 : 0;
+            const auto isFirst = instance.get() == &processor;
+            report.numFrames += (juce::uint64) drainFrames (*instance, isFirst ? dump.get() : nullptr, isFirst ? &report : nullptr);
+        }
+
+        if (settings.realtime)
+        {
+            const auto due = (start + numSamples) / settings.sampleRate;
+            const auto ahead = due - secondsSince (runStart);
+
+            if (ahead > 0.0)
+                juce::Thread::sleep (juce::roundToInt (ahead * 1000.0));
+        }
+    }
+
+    // Give the worker a moment to publish whatever it still had queued
+    if (settings.realtime)
+        juce::Thread::sleep (50);
+
+    // Outside the timed run, while the analysis settings and spectrogram are still there to save
+    measureState (processor, report);
+
+    for (auto& instance : processors)
+    {
+        const auto isFirst = instance.get() == &processor;
+        report.numFrames += (juce::uint64) drainFrames (*instance, isFirst ? dump.get() : nullptr, isFirst ? &report : nullptr);
+        report.droppedFrames += instance->getSpectrumFrameStats().dropped;
+        report.droppedSamples += instance->getNumDroppedAnalysisSamples();
+        instance->releaseResources();
+    }
+
+    if (settings.captureFile != juce::File())
+    {
+        processor.stopCapture();
+        const auto capture = processor.getCaptureStats();
+
+        if (capture.error.isNotEmpty())
+            return juce::Result::fail (capture.error);
+
+        report.hasCapture = true;
+        report.captureBytes = capture.bytesWritten;
+        report.capturedFrames = capture.numFrames;
+        report.capturedMidiEvents = capture.numMidiEvents;
+        report.captureDropped = capture.droppedRecords;
+    }
+
+    report.wallSeconds = secondsSince (runStart);
+    report.numBlocks = (int) micros.size();
+    report.audioSeconds = totalSamples / settings.sampleRate;
+
+    report.realtimeViolations = RealtimeSafety::getTotalViolationCount();
+    report.realtimeReport = RealtimeSafety::getReport();
+
+    std::sort (micros.begin(), micros.end());
+    report.meanMicros = micros.empty() ? 0.0 : report.processSeconds * 1.0e6 / (double) micros.size();
+    report.p50Micros = percentile (micros, 0.5);
+    report.p90Micros = percentile (micros, 0.9);
+    report.p99Micros = percentile (micros, 0.99);
+    report.p999Micros = percentile (micros, 0.999);
+    report.maxMicros = micros.empty() ? 0.0 : micros.back();
+
+    return juce::Result::ok();
+}
+
+//==============================================================================
+juce::String OfflineRunner::Report::toString() const
+{
+    juce::String s;
+    s << "blocks             " << numBlocks << " (" << juce::String (audioSeconds, 2) << " s of audio in "
+      << juce::String (wallSeconds, 3) << " s, " << juce::String (getRealtimeFactor(), 1) << "x realtime)\n"
+      << "processBlock us    mean " << juce::String (meanMicros, 2) << "  p50 " << juce::String (p50Micros, 2)
+      << "  p90 " << juce::String (p90Micros, 2) << "  p99 " << juce::String (p99Micros, 2)
+      << "  p99.9 " << juce::String (p999Micros, 2) << "  max " << juce::String (maxMicros, 2) << "\n"
+      << "frames             " << (juce::int64) numFrames << " (" << juce::String (getFramesPerSecond(), 0) << " per second of processing, "
+      << juce::String (getFramesPerAudioSecond(), 1) << " per second of audio)\n"
+      << "dropped            " << (juce::int64) droppedFrames << " frames, " << (juce::int64) droppedSamples << " samples\n"
+      << "allocations        " << (juce::int64) allocations << " (" << juce::String (getAllocationsPerBlock(), 3) << " per block, "
+      << blocksWithAllocations << " blocks allocated, at most " << (juce::int64) maxAllocationsInBlock << " in one)\n"
+      << "rt violations      " << (juce::int64) realtimeViolations << " (allocations, frees and locks in processBlock or the analysis pass)\n";
+
+    if (numInstances > 1)
+    {
+        constexpr auto kilobytes = 1.0 / 1024.0;
+        s << "instances          " << numInstances << ": the first kept " << juce::String (firstInstanceBytes * kilobytes, 0)
+          << " KB and took " << juce::String (firstInstanceMillis, 2) << " ms to create, each later one "
+          << juce::String (laterInstanceBytes * kilobytes, 0) << " KB and " << juce::String (laterInstanceMillis, 2) << " ms\n"
+          << "shared             " << juce::String (getSharedBytesPerInstance() * kilobytes, 0) << " KB and "
+          << juce::String (getSharedMillisPerInstance(), 2) << " ms saved per later instance\n";
+    }
+
+    if (hasFeatures)
+    {
+        s << "features           " << numOnsets << " onsets, " << numBeats << " beats, last tempo "
+          << juce::String (tempoBpm, 1) << " BPM, last pitch " << juce::String (pitchHz, 1) << " Hz\n";
+    }
+
+    if (hasCapture)
+    {
+        s << "capture            " << (juce::int64) capturedFrames << " frames, " << (juce::int64) capturedMidiEvents
+          << " MIDI events, " << captureBytes << " bytes, " << (juce::int64) captureDropped << " records dropped\n";
+    }
+
+    s << "state              " << stateBytes << " bytes, saved in " << juce::String (saveStateMicros, 1)
+      << " us, loaded in " << juce::String (loadStateMicros, 1) << " us\n";
+
+    return s;
+}
+
+juce::var OfflineRunner::Report::toVar() const
+{
+    auto* object = new juce::DynamicObject();
+    object->setProperty ("blocks", numBlocks);
+    object->setProperty ("audioSeconds", audioSeconds);
+    object->setProperty ("processSeconds", processSeconds);
+    object->setProperty ("wallSeconds", wallSeconds);
+    object->setProperty ("realtimeFactor", getRealtimeFactor());
+    object->setProperty ("meanMicros", meanMicros);
+    object->setProperty ("p50Micros", p50Micros);
+    object->setProperty ("p90Micros", p90Micros);
+    object->setProperty ("p99Micros", p99Micros);
+    object->setProperty ("p999Micros", p999Micros);
+    object->setProperty ("maxMicros", maxMicros);
+    object->setProperty ("frames", (juce::int64) numFrames);
+    object->setProperty ("framesPerSecond", getFramesPerSecond());
+    object->setProperty ("framesPerAudioSecond", getFramesPerAudioSecond());
+    object->setProperty ("droppedFrames", (juce::int64) droppedFrames);
+    object->setProperty ("droppedSamples", (juce::int64) droppedSamples);
+    object->setProperty ("allocations", (juce::int64) allocations);
+    object->setProperty ("allocationsPerBlock", getAllocationsPerBlock());
+    object->setProperty ("blocksWithAllocations", blocksWithAllocations);
+    object->setProperty ("maxAllocationsInBlock", (juce::int64) maxAllocationsInBlock);
+    object->setProperty ("realtimeViolations", (juce::int64) realtimeViolations);
+    object->setProperty ("realtimeReport", realtimeReport);
+    object->setProperty ("instances", numInstances);
+    object->setProperty ("firstInstanceBytes", firstInstanceBytes);
+    object->setProperty ("laterInstanceBytes", laterInstanceBytes);
+    object->setProperty ("firstInstanceMillis", firstInstanceMillis);
+    object->setProperty ("laterInstanceMillis", laterInstanceMillis);
+    object->setProperty ("sharedBytesPerInstance", getSharedBytesPerInstance());
+    object->setProperty ("sharedMillisPerInstance", getSharedMillisPerInstance());
+    object->setProperty ("onsets", numOnsets);
+    object->setProperty ("beats", numBeats);
+    object->setProperty ("tempoBpm", tempoBpm);
+    object->setProperty ("pitchHz", pitchHz);
+    object->setProperty ("captureBytes", captureBytes);
+    object->setProperty ("capturedFrames", (juce::int64) capturedFrames);
+    object->setProperty ("capturedMidiEvents", (juce::int64) capturedMidiEvents);
+    object->setProperty ("captureDropped", (juce::int64) captureDropped);
+    object->setProperty ("stateBytes", stateBytes);
+    object->setProperty ("saveStateMicros", saveStateMicros);
+    object->setProperty ("loadStateMicros", loadStateMicros);
+    return juce::var (object);
+}
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    OfflineRunner.h
+    Drives ViberAudioProcessor block by block, outside any host, and measures it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+/**
+    Feeds a WAV file or a synthetic signal (plus optional MIDI file and sidechain)
+    through prepareToPlay/processBlock as fast as it will go, the way a host does
+    for an offline bounce, and records what each processBlock call cost.
+
+    Everything is loaded or generated before the first block, so the timed region
+    is processBlock alone. Frames are drained from the processor's queue between
+    blocks, outside the timed region, and optionally written to a CSV file.
+
+    With more than one instance, every instance gets the same input, one after
+    the other for each block, as a host would run a template with many Vibers.
+    Creating each one is measured too: the first pays for everything shared
+    through AnalysisResources and AnalysisWorker, later ones only for their own
+    state, so the difference is what sharing saves per instance.
+*/
+class OfflineRunner
+{
+public:
+    enum class Signal
+    {
+        sine,
+        sweep,          // logarithmic, 20 Hz to 20 kHz over the whole run
+        noise,
+        silence
+    };
+
+    struct Settings
+    {
+        double sampleRate = 48000.0;            // replaced by the file's rate for WAV input
+        int blockSize = 512;
+        int numChannels = 2;                    // main input, 1 or 2
+        double seconds = 10.0;                  // length of synthetic input
+        Signal signal = Signal::sine;
+        float frequency = 1000.0f;
+        float level = 0.5f;
+        juce::File inputFile;                   // analysed instead of `signal` when set
+        std::optional<Signal> sidechain;        // stereo sidechain, disabled when empty
+        juce::File midiFile;
+        juce::File dumpFile;                    // CSV of every frame, when set
+        juce::File captureFile;                 // the first instance records a capture here, when set
+        juce::StringPairArray parameters;       // parameter ID -> plain value
+        juce::uint32 streams = SpectrumAnalyser::defaultStreams;
+        BandMap::Layout bandLayout;
+        SpectrumBallistics::Settings ballistics;
+        bool realtime = false;                  // pace blocks in real time and let the worker analyse
+        int numInstances = 1;
+        bool saveSpectrogram = false;           // include the spectrogram in the saved state
+        int featureStream = -1;                 // stream to extract audio features from, -1 for none
+    };
+
+    struct Report
+    {
+        int numBlocks = 0;
+        double audioSeconds = 0.0;
+        double processSeconds = 0.0;            // sum of processBlock times
+        double wallSeconds = 0.0;
+
+        // processBlock times in microseconds
+        double meanMicros = 0.0, p50Micros = 0.0, p90Micros = 0.0, p99Micros = 0.0, p999Micros = 0.0, maxMicros = 0.0;
+
+        juce::uint64 numFrames = 0;
+        juce::uint64 droppedFrames = 0;
+        juce::uint64 droppedSamples = 0;
+
+        // Heap allocations made on the processing thread inside processBlock
+        juce::uint64 allocations = 0;
+        int blocksWithAllocations = 0;
+        juce::uint64 maxAllocationsInBlock = 0;
+
+        // Allocations, frees and locks inside realtime sections, on any thread (see RealtimeSafety.h)
+        juce::uint64 realtimeViolations = 0;
+        juce::String realtimeReport;
+
+        // Heap kept and time taken by creating and preparing the instances (see RealtimeSafety::getThreadHeapBytes)
+        int numInstances = 1;
+        juce::int64 firstInstanceBytes = 0;
+        double laterInstanceBytes = 0.0;        // mean over the second instance on
+        double firstInstanceMillis = 0.0;
+        double laterInstanceMillis = 0.0;
+
+        // Audio features from the first instance: events counted, and the last tempo and pitch found
+        bool hasFeatures = false;
+        int numOnsets = 0, numBeats = 0;
+        float tempoBpm = 0.0f, pitchHz = 0.0f;
+
+        // What the first instance captured, when asked to (see AnalysisCapture)
+        bool hasCapture = false;
+        juce::int64 captureBytes = 0;
+        juce::uint64 capturedFrames = 0, capturedMidiEvents = 0, captureDropped = 0;
+
+        // getStateInformation/setStateInformation on the first instance after the run, mean of several calls
+        juce::int64 stateBytes = 0;
+        double saveStateMicros = 0.0;
+        double loadStateMicros = 0.0;
+
+        double getSharedBytesPerInstance() const noexcept   { return numInstances > 1 ? (double) firstInstanceBytes - laterInstanceBytes : 0.0; }
+        double getSharedMillisPerInstance() const noexcept  { return numInstances > 1 ? firstInstanceMillis - laterInstanceMillis : 0.0; }
+
+        double getFramesPerSecond() const noexcept        { return processSeconds > 0.0 ? (double) numFrames / processSeconds : 0.0; }
+        double getFramesPerAudioSecond() const noexcept   { return audioSeconds > 0.0 ? (double) numFrames / audioSeconds : 0.0; }
+        double getAllocationsPerBlock() const noexcept    { return numBlocks > 0 ? (double) allocations / numBlocks : 0.0; }
+        double getRealtimeFactor() const noexcept         { return processSeconds > 0.0 ? audioSeconds / processSeconds : 0.0; }
+
+        juce::String toString() const;
+        juce::var toVar() const;
+    };
+
+    explicit OfflineRunner (Settings settingsToUse);
+
+    /** Loads the input, runs every block and fills `report`. Fails if an input file
+        can't be read or a parameter or bus layout is rejected.
+    */
+    juce::Result run (Report& report);
+
+private:
+    juce::Result loadInput();
+    juce::Result loadMidi();
+    juce::Result configure (ViberAudioProcessor& processor);
+    void fillBlock (juce::AudioBuffer<float>& block, juce::MidiBuffer& midi, const ViberAudioProcessor& processor,
+                    int startSample, int numSamples);
+    int drainFrames (ViberAudioProcessor& processor, juce::OutputStream* dump, Report* features);
+    static void measureState (ViberAudioProcessor& processor, Report& report);
+
+    Settings settings;
+    juce::AudioBuffer<float> input, sidechainInput;
+    juce::MidiMessageSequence midiEvents;
+    int nextMidiEvent = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (OfflineRunner)
+};
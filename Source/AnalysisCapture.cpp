@@ -0,0 +1,353 @@
+/*
+  ==============================================================================
+
+    AnalysisCapture.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisCapture.h"
+
+namespace {
+template <typename IntType>
+void writeLittleEndian (juce::uint8* dest, IntType value)
+{
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        dest[i] = (juce::uint8) ((value >> (8 * i)) & 0xff);
+}
+
+void writeLittleEndian (juce::uint8* dest, double value)
+{
+    juce::uint64 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeLittleEndian (dest, bits);
+}
+
+int paddedSize (int size) noexcept
+{
+    return (size + 7) & ~7;
+}
+
+bool startsWithCaptureMagic (const juce::File& file)
+{
+    juce::FileInputStream in (file);
+    char magic[2] {};
+    return in.openedOk() && in.read (magic, 2) == 2 && magic[0] == 'V' && magic[1] == 'C';
+}
+} // namespace
+
+//==============================================================================
+void AnalysisCapture::RecordRing::allocate (int capacity)
+{
+    if ((int) bytes.size() != capacity)
+    {
+        bytes.assign ((size_t) capacity, 0);
+        fifo.setTotalSize (capacity);
+    }
+
+    fifo.reset();
+}
+
+bool AnalysisCapture::RecordRing::write (RecordKind kind, juce::uint16 epoch, juce::int64 position,
+                                         const void* payload, int payloadSize) noexcept
+{
+    const auto totalSize = recordHeaderSize + paddedSize (payloadSize);
+
+    if (bytes.empty() || fifo.getFreeSpace() < totalSize)
+        return false;
+
+    juce::uint8 header[recordHeaderSize] {};
+    writeLittleEndian (header, (juce::uint32) payloadSize);
+    header[4] = (juce::uint8) kind;
+    writeLittleEndian (header + 6, epoch);
+    writeLittleEndian (header + 8, position);
+
+    // Published when the scope ends, once the whole record is in
+    const auto scope = fifo.write (totalSize);
+
+    // Copies into the record's space, which may wrap around the end of the ring
+    int offset = 0;
+    const auto put = [&] (const void* source, int numBytes)
+    {
+        for (int done = 0; done < numBytes;)
+        {
+            const auto inFirst = offset < scope.blockSize1;
+            const auto index = inFirst ? scope.startIndex1 + offset : scope.startIndex2 + offset - scope.blockSize1;
+            const auto num = juce::jmin (numBytes - done, inFirst ? scope.blockSize1 - offset
+                                                                  : scope.blockSize1 + scope.blockSize2 - offset);
+
+            if (source != nullptr)
+                std::memcpy (bytes.data() + index, static_cast<const juce::uint8*> (source) + done, (size_t) num);
+            else
+                std::memset (bytes.data() + index, 0, (size_t) num);
+
+            done += num;
+            offset += num;
+        }
+    };
+
+    put (header, recordHeaderSize);
+    put (payload, payloadSize);
+    put (nullptr, totalSize - offset);
+    return true;
+}
+
+void AnalysisCapture::RecordRing::read (juce::uint8* dest, int numBytes) noexcept
+{
+    const auto scope = fifo.read (numBytes);
+    std::memcpy (dest, bytes.data() + scope.startIndex1, (size_t) scope.blockSize1);
+    std::memcpy (dest + scope.blockSize1, bytes.data() + scope.startIndex2, (size_t) scope.blockSize2);
+}
+
+//==============================================================================
+AnalysisCapture::AnalysisCapture (int maxBinsToCapture)
+    : juce::Thread ("Viber capture"), maxBins (maxBinsToCapture)
+{
+}
+
+AnalysisCapture::~AnalysisCapture()
+{
+    stop();
+}
+
+juce::Result AnalysisCapture::start (const juce::File& fileToWrite, double sampleRate)
+{
+    stop();
+
+    // Nothing else touches the rings or the scratch frame until recording is set below
+    if (frame.bins.empty())
+    {
+        frame.allocate (maxBins);
+        encoder.reserve (maxBins);
+    }
+
+    frameRing.allocate (frameRingBytes);
+    midiRing.allocate (midiRingBytes);
+    numFrames = 0;
+    numMidiEvents = 0;
+    droppedRecords = 0;
+    committedBytes = headerSize;
+    failed = false;
+    error.clear();
+
+    file = fileToWrite;
+    mappedSize = 0;
+
+    // Only an earlier capture is ever replaced, so a mistyped path can't wipe someone's file
+    if (file.exists() && ! startsWithCaptureMagic (file))
+        return juce::Result::fail (file.getFullPathName() + " isn't a capture, so it won't be replaced");
+
+    if (! file.deleteFile() || file.getParentDirectory().createDirectory().failed())
+        return juce::Result::fail ("Can't replace " + file.getFullPathName());
+
+    if (! reserve (headerSize))
+        return juce::Result::fail (error);
+
+    startMillis = juce::Time::currentTimeMillis();
+
+    auto* header = static_cast<juce::uint8*> (mapping->getData());
+    header[0] = 'V';
+    header[1] = 'C';
+    header[2] = currentVersion;
+    header[3] = SpectrumFrameEncoder::currentVersion;
+    writeLittleEndian (header + 4, (juce::uint32) headerSize);
+    writeLittleEndian (header + 8, (juce::uint64) headerSize);
+    writeLittleEndian (header + 16, startMillis);
+    writeLittleEndian (header + 24, sampleRate);
+
+    isOpen = true;
+    recording = true;
+    startThread (juce::Thread::Priority::low);
+    return juce::Result::ok();
+}
+
+void AnalysisCapture::stop()
+{
+    if (! isOpen)
+        return;
+
+    isOpen = false;
+    recording = false;
+    stopMillis = juce::Time::currentTimeMillis();
+
+    // Producers are brief, so yielding until the last one leaves is fine off the audio thread
+    while (numProducers.load() > 0)
+        juce::Thread::yield();
+
+    // The writer may be extending the file, which can take a while on a slow disk, but it
+    // never blocks indefinitely, so wait it out rather than have stopThread() kill it midway
+    signalThreadShouldExit();
+    notify();
+    waitForThreadToExit (-1);
+
+    if (! failed.load (std::memory_order_acquire))
+        writePending();
+
+    closeFile();
+}
+
+AnalysisCapture::Stats AnalysisCapture::getStats() const
+{
+    Stats stats;
+    stats.isRecording = isRecording();
+    stats.file = file;
+    stats.bytesWritten = committedBytes.load (std::memory_order_relaxed);
+    stats.numFrames = numFrames.load (std::memory_order_relaxed);
+    stats.numMidiEvents = numMidiEvents.load (std::memory_order_relaxed);
+    stats.droppedRecords = droppedRecords.load (std::memory_order_relaxed);
+    const auto endMillis = isOpen ? juce::Time::currentTimeMillis() : stopMillis;
+    stats.seconds = startMillis > 0 ? (double) (endMillis - startMillis) / 1000.0 : 0.0;
+
+    if (failed.load (std::memory_order_acquire))
+        stats.error = error;
+
+    return stats;
+}
+
+void AnalysisCapture::restartClock (double sampleRate) noexcept
+{
+    const auto newEpoch = (juce::uint16) (epoch.load (std::memory_order_relaxed) + 1);
+    epoch.store (newEpoch, std::memory_order_relaxed);
+
+    // prepareToPlay never overlaps processBlock, so this takes the audio thread's ring
+    const ScopedProducer producer (*this);
+
+    if (! producer.isActive())
+        return;
+
+    juce::uint8 payload[clockPayloadSize];
+    writeLittleEndian (payload, sampleRate);
+    writeLittleEndian (payload + 8, juce::Time::currentTimeMillis());
+
+    if (! midiRing.write (RecordKind::clock, newEpoch, 0, payload, clockPayloadSize))
+        droppedRecords.fetch_add (1, std::memory_order_relaxed);
+}
+
+void AnalysisCapture::writeMidi (const MidiEventBatch& batch) noexcept
+{
+    const ScopedProducer producer (*this);
+
+    if (! producer.isActive() || batch.numEvents == 0)
+        return;
+
+    std::array<juce::uint8, MidiEventBatch::maxEvents * midiEventSize> payload;
+
+    for (int i = 0; i < batch.numEvents; ++i)
+    {
+        const auto& event = batch.events[(size_t) i];
+        auto* dest = payload.data() + i * midiEventSize;
+        dest[0] = (juce::uint8) event.type;
+        dest[1] = event.channel;
+        dest[2] = event.note;
+        dest[3] = event.value;
+        writeLittleEndian (dest + 4, (juce::uint32) event.sampleOffset);
+    }
+
+    if (midiRing.write (RecordKind::midi, epoch.load (std::memory_order_relaxed), batch.time,
+                        payload.data(), batch.numEvents * midiEventSize))
+        numMidiEvents.fetch_add ((juce::uint64) batch.numEvents, std::memory_order_relaxed);
+    else
+        droppedRecords.fetch_add (1, std::memory_order_relaxed);
+}
+
+//==============================================================================
+void AnalysisCapture::run()
+{
+    while (! threadShouldExit())
+    {
+        wait (writeIntervalMs);
+
+        if (! writePending())
+            return;
+    }
+}
+
+bool AnalysisCapture::writePending()
+{
+    auto committed = committedBytes.load (std::memory_order_relaxed);
+
+    // Each ring only ever holds whole records, so whatever is ready ends on a record boundary
+    for (auto* ring : { &frameRing, &midiRing })
+    {
+        const auto numReady = ring->getNumReady();
+
+        if (numReady == 0)
+            continue;
+
+        if (! reserve (committed + numReady))
+            return false;
+
+        ring->read (static_cast<juce::uint8*> (mapping->getData()) + committed, numReady);
+        committed += numReady;
+    }
+
+    // Only now do readers get to see the new records
+    writeLittleEndian (static_cast<juce::uint8*> (mapping->getData()) + 8, (juce::uint64) committed);
+    committedBytes.store (committed, std::memory_order_relaxed);
+    return true;
+}
+
+bool AnalysisCapture::reserve (juce::int64 size)
+{
+    if (mapping != nullptr && size <= mappedSize)
+        return true;
+
+    const auto newSize = (size / growthBytes + 1) * growthBytes;
+    mapping.reset();
+
+    {
+        // Write real zeros rather than seeking past the end: a sparse file can run out of
+        // disk underneath the mapping, which faults instead of failing here
+        juce::FileOutputStream out (file);
+
+        if (out.failedToOpen())
+        {
+            fail ("Can't open " + file.getFullPathName());
+            return false;
+        }
+
+        out.writeRepeatedByte (0, (size_t) (newSize - out.getPosition()));
+        out.flush();
+
+        if (out.getStatus().failed())
+        {
+            fail ("Can't grow " + file.getFullPathName() + ": " + out.getStatus().getErrorMessage());
+            return false;
+        }
+    }
+
+    mapping = std::make_unique<juce::MemoryMappedFile> (file, juce::Range<juce::int64> (0, newSize),
+                                                        juce::MemoryMappedFile::readWrite, false);
+
+    if (mapping->getData() == nullptr || (juce::int64) mapping->getSize() < newSize)
+    {
+        mapping.reset();
+        fail ("Can't map " + file.getFullPathName());
+        return false;
+    }
+
+    mappedSize = newSize;
+    return true;
+}
+
+void AnalysisCapture::closeFile()
+{
+    mapping.reset();
+    mappedSize = 0;
+
+    // Drop the zeros past the last record
+    juce::FileOutputStream out (file);
+
+    if (out.openedOk())
+    {
+        out.setPosition (committedBytes.load (std::memory_order_relaxed));
+        out.truncate();
+    }
+}
+
+void AnalysisCapture::fail (const juce::String& message)
+{
+    error = message;
+    failed.store (true, std::memory_order_release);
+    recording = false;
+}
@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    AnalysisCapture.h
+    Records the spectrum frames, levels and MIDI the visualiser is fed to an
+    append-only file, for replaying a show offline (see CaptureFile).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrameEncoder.h"
+#include "MidiEventQueue.h"
+
+//==============================================================================
+/**
+    Captures what the editor is sent while it runs: every frame the analyser
+    publishes, with its meter levels and features, and every batch of MIDI
+    events processBlock queues, each stamped with its position in samples.
+
+    The audio and analysis threads never touch the file. Each copies its
+    records into a lock-free byte ring of its own, and a background thread
+    appends whatever has arrived to a memory-mapped file every writeIntervalMs,
+    growing the file growthBytes at a time. When a ring is full the record is
+    dropped and counted, as frames are when the editor falls behind. The rings
+    are separate from the editor's queues, which only have room for one
+    consumer, so a show is recorded whether the editor is open or not.
+
+    Frames are stored as SpectrumFrameEncoder lays them out, with 16-bit bins,
+    so replaying one is a base64 of bytes straight out of the mapping.
+
+    File layout (all multi-byte fields little endian):
+
+        0   'V' 'C'         magic
+        2   uint8           format version (currentVersion)
+        3   uint8           version of the 'VF' frames in it
+                            (SpectrumFrameEncoder::currentVersion)
+        4   uint32          header size (headerSize)
+        8   uint64          committed size: where the last whole record ends.
+                            Updated after each batch of records, so a capture
+                            cut short by a crash reads back up to there.
+        16  int64           start time, in ms since 1970
+        24  float64         sample rate at the start
+        32  uint8[32]       reserved, 0
+        64  records...      each starting on a multiple of 8 bytes:
+
+            0   uint32      payload size in bytes, without the padding
+            4   uint8       kind (RecordKind)
+            5   uint8       reserved, 0
+            6   uint16      clock epoch, which counts prepareToPlay calls
+            8   int64       position in samples since prepareToPlay: a frame's
+                            window centre, a MIDI batch's block start
+            16  payload...  then zeros up to a multiple of 8 bytes
+
+        Payloads:
+            frame           one 'VF' frame (SpectrumFrameEncoder)
+            midi            8 bytes per event, as in the editor's 'VM' payload:
+                            uint8 type (MidiEvent::Type), channel, note and
+                            value, then uint32 samples after the position
+            clock           float64 sample rate, int64 time in ms since 1970;
+                            written when prepareToPlay restarts the clock
+
+    If this layout changes, bump currentVersion and update CaptureFile. A new
+    frame version needs neither: CaptureFile refuses captures whose frames
+    aren't in the version this build reads.
+*/
+class AnalysisCapture  : private juce::Thread
+{
+public:
+    enum class RecordKind : juce::uint8
+    {
+        frame = 1,
+        midi = 2,
+        clock = 3
+    };
+
+    static constexpr juce::uint8 currentVersion = 1;
+    static constexpr int headerSize = 64;
+    static constexpr int recordHeaderSize = 16;
+    static constexpr int midiEventSize = 8;
+    static constexpr int clockPayloadSize = 16;
+    static constexpr int frameRingBytes = 4 << 20;      // a quarter second of six 8192-bin streams at 128-sample hops
+    static constexpr int midiRingBytes = 256 << 10;
+    static constexpr juce::int64 growthBytes = 16 << 20;
+    static constexpr int writeIntervalMs = 20;
+
+    struct Stats
+    {
+        bool isRecording = false;
+        juce::File file;                    // the current or last capture
+        juce::int64 bytesWritten = 0;       // committed to the file so far
+        juce::uint64 numFrames = 0;
+        juce::uint64 numMidiEvents = 0;
+        juce::uint64 droppedRecords = 0;    // because a ring was full
+        double seconds = 0.0;               // from start() to now, or to stop()
+        juce::String error;                 // why the capture stopped by itself, if it did
+    };
+
+    /** Frames of up to maxBins bins are captured whole. Nothing is allocated
+        until the first start().
+    */
+    explicit AnalysisCapture (int maxBins);
+    ~AnalysisCapture() override;
+
+    /** Message thread: stops any capture in progress, then starts writing a new
+        one to `file`. An earlier capture there is replaced; fails if anything else
+        is there, or if the file can't be created.
+    */
+    juce::Result start (const juce::File& file, double sampleRate);
+
+    /** Message thread: waits for the audio and analysis threads to let go, writes
+        what they left in the rings and trims the file to its last record.
+    */
+    void stop();
+
+    bool isRecording() const noexcept  { return recording.load(); }
+
+    /** Message thread. */
+    Stats getStats() const;
+
+    /** Call from prepareToPlay, after the analyser's: positions in later records
+        count from the restarted clock.
+    */
+    void restartClock (double sampleRate) noexcept;
+
+    /** Analysis thread: while recording, `fill` is called with a scratch
+        SpectrumFrame to fill in, as for SpectrumFrameQueue::push, and the
+        frame is queued for writing. Never allocates or blocks.
+    */
+    template <typename FillFrame>
+    void writeFrame (FillFrame&& fill) noexcept
+    {
+        const ScopedProducer producer (*this);
+
+        if (! producer.isActive())
+            return;
+
+        fill (frame);
+        const auto size = encoder.encodeBinary (frame);
+
+        if (frameRing.write (RecordKind::frame, epoch.load (std::memory_order_relaxed), frame.samplePosition,
+                             encoder.getData(), (int) size))
+            numFrames.fetch_add (1, std::memory_order_relaxed);
+        else
+            droppedRecords.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    /** Audio thread: queues one processBlock's MIDI events while recording.
+        Never allocates or blocks.
+    */
+    void writeMidi (const MidiEventBatch& batch) noexcept;
+
+private:
+    // A byte FIFO of whole records with one producer: a record goes in entirely or not at all
+    class RecordRing
+    {
+    public:
+        /** Empties the ring, allocating it the first time. Only while nothing writes to it. */
+        void allocate (int capacity);
+
+        bool write (RecordKind kind, juce::uint16 epoch, juce::int64 position, const void* payload, int payloadSize) noexcept;
+
+        int getNumReady() const noexcept  { return fifo.getNumReady(); }
+
+        /** Moves the first numBytes ready bytes to dest. */
+        void read (juce::uint8* dest, int numBytes) noexcept;
+
+    private:
+        juce::AbstractFifo fifo { 1 };
+        std::vector<juce::uint8> bytes;
+    };
+
+    // Registers a producer before it looks at the recording flag, so stop() either sees
+    // it and waits, or it sees the flag cleared and leaves the buffers alone
+    struct ScopedProducer
+    {
+        explicit ScopedProducer (AnalysisCapture& c) noexcept
+            : capture (c)
+        {
+            capture.numProducers.fetch_add (1);
+            active = capture.recording.load();
+        }
+
+        ~ScopedProducer()  { capture.numProducers.fetch_sub (1); }
+
+        bool isActive() const noexcept  { return active; }
+
+        AnalysisCapture& capture;
+        bool active = false;
+    };
+
+    void run() override;
+    bool writePending();
+    bool reserve (juce::int64 size);
+    void closeFile();
+    void fail (const juce::String& message);
+
+    const int maxBins;
+
+    std::atomic<bool> recording { false };
+    std::atomic<int> numProducers { 0 };
+    std::atomic<juce::uint16> epoch { 0 };
+    std::atomic<juce::uint64> numFrames { 0 }, numMidiEvents { 0 }, droppedRecords { 0 };
+    std::atomic<juce::int64> committedBytes { 0 };
+
+    // Producer side: the analysis thread's scratch frame and encoder, and a ring per thread
+    SpectrumFrame frame;
+    SpectrumFrameEncoder encoder { SpectrumFrameEncoder::Quantisation::sixteenBit };
+    RecordRing frameRing, midiRing;
+
+    // Writer side: the file and its mapping, touched by the writer thread while it runs
+    // and by the message thread otherwise
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    juce::int64 mappedSize = 0;
+    juce::int64 startMillis = 0, stopMillis = 0;
+    bool isOpen = false;                    // message thread only: between start() and stop()
+
+    // Set by the writer thread when it gives up; the message is written before the flag
+    juce::String error;
+    std::atomic<bool> failed { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisCapture)
+};
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    AnalysisResources.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisResources.h"
+
+namespace {
+using Method = AnalysisResources::WindowingMethod;
+
+// The windows SpectrumAnalyser::WindowType can ask for, in table order
+constexpr Method builtWindows[] = { Method::rectangular, Method::hann, Method::hamming,
+                                    Method::blackman, Method::blackmanHarris, Method::flatTop };
+
+int getWindowSlot (Method method) noexcept
+{
+    const auto* end = std::end (builtWindows);
+    const auto* it = std::find (std::begin (builtWindows), end, method);
+    return it != end ? (int) (it - std::begin (builtWindows)) : -1;
+}
+} // namespace
+
+//==============================================================================
+AnalysisResources::AnalysisResources()
+{
+    for (int order = minFftOrder; order <= maxFftOrder; ++order)
+    {
+        const auto index = (size_t) (order - minFftOrder);
+        ffts[index] = std::make_unique<juce::dsp::FFT> (order);
+        windowOffsets[index] = windowStride;
+        windowStride += (size_t) 1 << order;
+    }
+
+    windows.resize (windowStride * std::size (builtWindows));
+
+    for (size_t slot = 0; slot < std::size (builtWindows); ++slot)
+    {
+        for (int order = minFftOrder; order <= maxFftOrder; ++order)
+        {
+            const auto size = 1 << order;
+            auto* table = windows.data() + slot * windowStride + windowOffsets[(size_t) (order - minFftOrder)];
+            juce::dsp::WindowingFunction<float>::fillWindowingTables (table, (size_t) size, builtWindows[slot], true);
+            juce::FloatVectorOperations::multiply (table, (float) referenceFftSize / (float) size, size);
+        }
+    }
+}
+
+const juce::dsp::FFT& AnalysisResources::getFft (int fftOrder) const noexcept
+{
+    jassert (juce::isPositiveAndBelow (fftOrder - minFftOrder, numOrders));
+    return *ffts[(size_t) juce::jlimit (0, numOrders - 1, fftOrder - minFftOrder)];
+}
+
+const float* AnalysisResources::getWindow (int fftOrder, WindowingMethod method) const noexcept
+{
+    const auto slot = getWindowSlot (method);
+    const auto index = fftOrder - minFftOrder;
+
+    if (slot < 0 || ! juce::isPositiveAndBelow (index, numOrders))
+    {
+        jassertfalse;
+        return nullptr;
+    }
+
+    return windows.data() + (size_t) slot * windowStride + windowOffsets[(size_t) index];
+}
+
+std::shared_ptr<const BandMap> AnalysisResources::getBandMap (BandMap::Layout layout, double sampleRate)
+{
+    const juce::ScopedLock sl (bandMapLock);
+
+    // Forget maps nobody holds any more
+    bandMaps.erase (std::remove_if (bandMaps.begin(), bandMaps.end(),
+                                    [] (const CachedBandMap& cached) { return cached.map.expired(); }),
+                    bandMaps.end());
+
+    for (const auto& cached : bandMaps)
+    {
+        if (cached.layout.scale == layout.scale && cached.layout.numBands == layout.numBands
+            && cached.sampleRate == sampleRate)
+        {
+            if (auto map = cached.map.lock())
+                return map;
+        }
+    }
+
+    auto map = std::make_shared<const BandMap> (layout, sampleRate, minFftOrder, maxFftOrder);
+    bandMaps.push_back ({ layout, sampleRate, map });
+    return map;
+}
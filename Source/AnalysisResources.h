@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    AnalysisResources.h
+    The read-only tables every analyser in the process can share: FFT plans,
+    window tables and band maps.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandMap.h"
+
+//==============================================================================
+/**
+    Hold one of these through a juce::SharedResourcePointer<AnalysisResources>,
+    like AnalysisWorker, so every plugin instance in the host process uses the
+    same copy. It is built with the first instance and freed with the last one.
+
+    FFT plans and window tables for every supported order are built up front, so
+    a config change is a lookup and the analysis never allocates. Window tables
+    are normalised with unit gain and then scaled by referenceFftSize / fftSize.
+    The transform's magnitudes grow with its size, so this keeps a steady tone at
+    the same dB at every order, where the display range and ballistics were set.
+
+    juce::dsp::FFT's fallback engine serialises transforms on a plan with a
+    spin lock, so the plans are only for threads that may wait: the one
+    AnalysisWorker thread, and the message thread while no analysis runs. An
+    analyser processing inline on an audio thread uses a private plan instead.
+
+    Band maps depend on the layout and sample rate, so they are built on demand
+    and cached only while some analyser still uses them.
+*/
+class AnalysisResources
+{
+public:
+    static constexpr int minFftOrder = 8;           // 256 samples
+    static constexpr int maxFftOrder = 14;          // 16384 samples
+    static constexpr int referenceFftSize = 1024;   // the size the dB calibration was set at
+
+    using WindowingMethod = juce::dsp::WindowingFunction<float>::WindowingMethod;
+
+    AnalysisResources();
+
+    /** The plan for one FFT order in [minFftOrder, maxFftOrder]. Never transform
+        with it on an audio thread.
+    */
+    const juce::dsp::FFT& getFft (int fftOrder) const noexcept;
+
+    /** The normalised, size-calibrated window of size 1 << fftOrder. Any thread.
+        Kaiser and triangular windows aren't built and return nullptr.
+    */
+    const float* getWindow (int fftOrder, WindowingMethod method) const noexcept;
+
+    /** A map for every supported FFT order, shared with any other analyser that
+        asked for the same layout at the same sample rate. Builds it if nobody
+        holds one. Allocates, so message thread only.
+    */
+    std::shared_ptr<const BandMap> getBandMap (BandMap::Layout layout, double sampleRate);
+
+private:
+    static constexpr int numOrders = maxFftOrder - minFftOrder + 1;
+
+    std::array<std::unique_ptr<juce::dsp::FFT>, numOrders> ffts;
+
+    // Every order's table for one method, smallest first, then the next method
+    std::vector<float> windows;
+    std::array<size_t, numOrders> windowOffsets {};
+    size_t windowStride = 0;
+
+    struct CachedBandMap
+    {
+        BandMap::Layout layout;
+        double sampleRate = 0.0;
+        std::weak_ptr<const BandMap> map;
+    };
+
+    juce::CriticalSection bandMapLock;      // never taken on the audio thread
+    std::vector<CachedBandMap> bandMaps;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisResources)
+};
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    AnalysisWorker.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisWorker.h"
+#include "RealtimeSafety.h"
+
+//==============================================================================
+AnalysisWorker::AnalysisWorker()
+    : juce::Thread ("Viber analysis")
+{
+    startThread (juce::Thread::Priority::low);
+}
+
+AnalysisWorker::~AnalysisWorker()
+{
+    stopThread (1000);
+}
+
+void AnalysisWorker::addAnalyser (SpectrumAnalyser& analyser)
+{
+    const juce::ScopedLock sl (lock);
+    analysers.addIfNotAlreadyThere (&analyser);
+}
+
+void AnalysisWorker::removeAnalyser (SpectrumAnalyser& analyser)
+{
+    // Taking the lock also waits for a pass that might be using this analyser
+    const juce::ScopedLock sl (lock);
+    analysers.removeFirstMatchingValue (&analyser);
+}
+
+void AnalysisWorker::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl (lock);
+
+            for (auto* analyser : analysers)
+            {
+                // Allocates, so outside the realtime section, and never on the audio thread
+                analyser->updateInlinePlan();
+
+                if (analyser->usesWorkerThread())
+                {
+                    // Not the audio thread, but this is the same code processBlock
+                    // runs inline, so it has to stay allocation- and lock-free too
+                    const RealtimeSafety::ScopedRealtimeSection realtimeSection ("analysis worker");
+                    analyser->processPendingSamples (true);
+                }
+            }
+        }
+
+        wait (pollIntervalMs);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    AnalysisWorker.h
+    One low-priority thread per process that runs the FFT for every plugin
+    instance in worker mode.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumAnalyser.h"
+
+//==============================================================================
+/**
+    Hold one of these through a juce::SharedResourcePointer<AnalysisWorker>, so
+    every ViberAudioProcessor in the host process shares the same thread. The
+    thread starts with the first instance and stops when the last one goes away.
+
+    The worker polls rather than being woken by the audio thread: signalling a
+    WaitableEvent can take a lock, which processBlock must never do.
+*/
+class AnalysisWorker  : private juce::Thread
+{
+public:
+    AnalysisWorker();
+    ~AnalysisWorker() override;
+
+    /** Message thread. The analyser must stay alive until removeAnalyser() returns. */
+    void addAnalyser (SpectrumAnalyser& analyser);
+    void removeAnalyser (SpectrumAnalyser& analyser);
+
+    /** How long the thread sleeps between passes when there's nothing to do. */
+    static constexpr int pollIntervalMs = 2;
+
+private:
+    void run() override;
+
+    juce::CriticalSection lock;     // guards analysers; never taken on the audio thread
+    juce::Array<SpectrumAnalyser*> analysers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisWorker)
+};
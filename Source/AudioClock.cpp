@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    AudioClock.cpp
+
+  ==============================================================================
+*/
+
+#include "AudioClock.h"
+
+//==============================================================================
+void AudioClock::reset (double sampleRate) noexcept
+{
+    Anchor fresh;
+    fresh.sampleRate = sampleRate;
+    write (fresh);
+}
+
+void AudioClock::advance (juce::int64 position, int numSamples, double sampleRate,
+                          juce::AudioPlayHead* playHead) noexcept
+{
+    Anchor next;
+    next.position = position;
+    next.ticks = juce::Time::getHighResolutionTicks();
+    next.numSamples = numSamples;
+    next.sampleRate = sampleRate;
+
+    if (playHead != nullptr)
+    {
+        if (const auto info = playHead->getPosition())
+        {
+            next.hostPosition = info->getTimeInSamples().orFallback (-1);
+            next.ppqPosition = info->getPpqPosition().orFallback (0.0);
+            next.bpm = info->getBpm().orFallback (0.0);
+            next.isPlaying = info->getIsPlaying();
+        }
+    }
+
+    write (next);
+}
+
+void AudioClock::write (const Anchor& newAnchor) noexcept
+{
+    version.fetch_add (1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    anchor = newAnchor;
+    version.fetch_add (1, std::memory_order_release);
+}
+
+AudioClock::Anchor AudioClock::read() const noexcept
+{
+    for (;;)
+    {
+        const auto before = version.load (std::memory_order_acquire);
+
+        if ((before & 1) == 0)
+        {
+            const auto copy = anchor;
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            if (version.load (std::memory_order_relaxed) == before)
+                return copy;
+        }
+
+        juce::Thread::yield();
+    }
+}
+
+//==============================================================================
+double AudioClock::getOutputLatency (const Anchor& a) const noexcept
+{
+    const auto blockSeconds = a.sampleRate > 0.0 ? a.numSamples / a.sampleRate : 0.0;
+    return juce::jmax (0.0, blockSeconds + getDeviceLatency() + getUserLatency());
+}
+
+double AudioClock::getHeardPosition (const Anchor& a, juce::int64 ticks) const noexcept
+{
+    const auto elapsed = juce::Time::highResolutionTicksToSeconds (ticks - a.ticks);
+    const auto heard = (double) a.position + (elapsed - getOutputLatency (a)) * a.sampleRate;
+    return juce::jmin (heard, (double) (a.position + a.numSamples));
+}
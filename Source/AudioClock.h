@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    AudioClock.h
+    Where the audio thread is, in samples and on the host's timeline, and
+    which sample is coming out of the speakers right now.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Frames, MIDI events and held notes are all stamped with their position in
+    samples since prepareToPlay. At the start of every block processBlock calls
+    advance(), which stores an anchor: that position, the time it was called,
+    and whatever the host's AudioPlayHead says about its own timeline.
+
+    From the latest anchor any thread can work out which sample is being heard
+    at a given moment. The block that started at `ticks` is heard once it has
+    been through the output buffer, so the heard position runs one block plus
+    the output latency behind the processing position. The plugin can't see
+    the device's latency from inside a host, so the editor sets it when it can
+    measure it (the standalone app) and the frontend can add a calibration
+    offset on top.
+
+    The audio thread is the only writer once playback starts. Readers copy the
+    anchor and retry if it changed while they were copying, as MidiNoteState does.
+*/
+class AudioClock
+{
+public:
+    struct Anchor
+    {
+        juce::int64 position = 0;       // samples since prepareToPlay at the start of the block
+        juce::int64 ticks = 0;          // juce::Time high resolution ticks when the block started, 0 before the first
+        int numSamples = 0;             // length of that block
+        double sampleRate = 44100.0;
+        juce::int64 hostPosition = -1;  // the block's position on the host timeline, -1 if the host didn't say
+        double ppqPosition = 0.0;
+        double bpm = 0.0;
+        bool isPlaying = false;
+
+        bool isRunning() const noexcept  { return ticks != 0; }
+
+        /** Maps a position in samples since prepareToPlay onto the host timeline,
+            assuming the transport ran straight on from the anchor. -1 if unknown.
+        */
+        juce::int64 toHostPosition (juce::int64 samplePosition) const noexcept
+        {
+            return hostPosition < 0 ? -1 : hostPosition + (samplePosition - position);
+        }
+    };
+
+    //==============================================================================
+    /** prepareToPlay: forgets the previous anchor. */
+    void reset (double sampleRate) noexcept;
+
+    /** Audio thread, at the start of every block. Asks `playHead`, if there is
+        one, where the host's transport is.
+    */
+    void advance (juce::int64 position, int numSamples, double sampleRate, juce::AudioPlayHead* playHead) noexcept;
+
+    /** Any thread: a consistent copy of the latest anchor. Never blocks the writer. */
+    Anchor read() const noexcept;
+
+    //==============================================================================
+    /** Any thread: the output device's latency, when the editor can measure it,
+        and a calibration offset from the frontend. Both in seconds.
+    */
+    void setDeviceLatency (double seconds) noexcept   { deviceLatency.store (juce::jmax (0.0, seconds), std::memory_order_relaxed); }
+    void setUserLatency (double seconds) noexcept     { userLatency.store (seconds, std::memory_order_relaxed); }
+    double getDeviceLatency() const noexcept          { return deviceLatency.load (std::memory_order_relaxed); }
+    double getUserLatency() const noexcept            { return userLatency.load (std::memory_order_relaxed); }
+
+    /** How long a sample takes from the start of its block to the speakers, in seconds. */
+    double getOutputLatency (const Anchor& anchor) const noexcept;
+
+    /** The position being heard at `ticks`, in samples since prepareToPlay,
+        fractional. Never later than the end of the last block processed, so it
+        stops when the host stops calling processBlock.
+    */
+    double getHeardPosition (const Anchor& anchor, juce::int64 ticks) const noexcept;
+
+private:
+    Anchor anchor;
+    std::atomic<juce::uint32> version { 0 };       // odd while an anchor is being written
+    std::atomic<double> deviceLatency { 0.0 }, userLatency { 0.0 };
+
+    void write (const Anchor& newAnchor) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioClock)
+};
@@ -0,0 +1,199 @@
+/*
+  ==============================================================================
+
+    BandMap.cpp
+
+  ==============================================================================
+*/
+
+#include "BandMap.h"
+
+namespace {
+double hzToMel(double hz)   { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+double melToHz(double mel)  { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+// Collects one band's (bin, weight) pairs and normalises them so they sum to one
+struct BandBuilder
+{
+    void add(int bin, double w)
+    {
+        if (w > 0.0) {
+            bins.push_back(bin);
+            weights.push_back(w);
+        }
+    }
+
+    // Used when a band is narrower than one bin: interpolate at its centre frequency
+    void addInterpolated(double binPosition, int numBins)
+    {
+        const auto lower = juce::jlimit(0, numBins - 1, (int) std::floor(binPosition));
+        const auto upper = juce::jmin(lower + 1, numBins - 1);
+        const auto frac = juce::jlimit(0.0, 1.0, binPosition - lower);
+
+        add(lower, 1.0 - frac);
+        if (upper != lower)
+            add(upper, frac);
+    }
+
+    std::vector<int> bins;
+    std::vector<double> weights;
+};
+} // namespace
+
+//==============================================================================
+BandMap::Scale BandMap::scaleFromName(const juce::String& name)
+{
+    static const std::unordered_map<juce::String, Scale> scales =
+    {
+        { { "linear"      },  Scale::linear      },
+        { { "log"         },  Scale::log         },
+        { { "mel"         },  Scale::mel         },
+        { { "thirdoctave" },  Scale::thirdOctave }
+    };
+
+    if (const auto it = scales.find(name.toLowerCase()); it != scales.end())
+        return it->second;
+
+    return Scale::linear;
+}
+
+BandMap::BandMap(Layout l, double rate, int minFftOrder, int maxFftOrder)
+    : layout(l), sampleRate(rate > 0.0 ? rate : 44100.0), minOrder(minFftOrder)
+{
+    layout.numBands = juce::jlimit(0, maxBands, layout.numBands);
+
+    for (int order = minFftOrder; order <= maxFftOrder; ++order)
+        matrices.push_back(buildMatrix(order));
+}
+
+const BandMap::Matrix* BandMap::getMatrix(int fftOrder) const noexcept
+{
+    const auto index = fftOrder - minOrder;
+    return juce::isPositiveAndBelow(index, (int) matrices.size()) ? &matrices[(size_t) index] : nullptr;
+}
+
+int BandMap::getNumBands(int fftOrder) const noexcept
+{
+    if (isPassthrough())
+        return (1 << fftOrder) / 2;
+
+    const auto* matrix = getMatrix(fftOrder);
+    return matrix != nullptr ? matrix->getNumBands() : 0;
+}
+
+void BandMap::apply(int fftOrder, const float* bins, float* bands) const noexcept
+{
+    const auto* matrix = getMatrix(fftOrder);
+    jassert(matrix != nullptr && ! isPassthrough());
+
+    if (matrix == nullptr)
+        return;
+
+    const auto* start = matrix->bandStart.data();
+    const auto* index = matrix->binIndex.data();
+    const auto* weight = matrix->weight.data();
+
+    for (int band = 0; band < matrix->getNumBands(); ++band) {
+        float sum = 0.0f;
+
+        for (int i = start[band]; i < start[band + 1]; ++i)
+            sum += weight[i] * bins[index[i]];
+
+        bands[band] = sum;
+    }
+}
+
+BandMap::Matrix BandMap::buildMatrix(int fftOrder) const
+{
+    Matrix matrix;
+
+    if (isPassthrough())
+        return matrix;
+
+    const int fftSize = 1 << fftOrder;
+    const int numBins = fftSize / 2;
+    const double binHz = sampleRate / fftSize;
+    const double topHz = juce::jmin(maxFrequency, sampleRate * 0.5);
+
+    std::vector<BandBuilder> bands;
+
+    if (layout.scale == Scale::linear) {
+        // Equal-width groups of bins
+        const int numBands = juce::jmin(layout.numBands, numBins);
+
+        for (int b = 0; b < numBands; ++b) {
+            BandBuilder band;
+            const int first = b * numBins / numBands;
+            const int last = juce::jmax(first + 1, (b + 1) * numBins / numBands);
+
+            for (int k = first; k < last; ++k)
+                band.add(k, 1.0);
+
+            bands.push_back(std::move(band));
+        }
+    }
+    else if (layout.scale == Scale::thirdOctave) {
+        // ISO 266 style centres, 1 kHz * 2^(n/3), each band one third of an octave wide
+        for (int n = -17; ; ++n) {
+            const double centre = 1000.0 * std::pow(2.0, n / 3.0);
+            if (centre > topHz)
+                break;
+
+            const double lo = centre * std::pow(2.0, -1.0 / 6.0);
+            const double hi = centre * std::pow(2.0, 1.0 / 6.0);
+
+            BandBuilder band;
+            for (int k = (int) std::ceil(lo / binHz); k < numBins && k * binHz < hi; ++k)
+                band.add(k, 1.0);
+
+            if (band.bins.empty())
+                band.addInterpolated(centre / binHz, numBins);
+
+            bands.push_back(std::move(band));
+        }
+    }
+    else {
+        // Triangular filters between neighbouring points spaced evenly on the log or mel scale
+        const bool mel = layout.scale == Scale::mel;
+        const double lo = mel ? hzToMel(minFrequency) : std::log(minFrequency);
+        const double hi = mel ? hzToMel(topHz) : std::log(topHz);
+        const int numBands = juce::jmax(1, layout.numBands);
+
+        auto pointHz = [&](int i) {
+            const double v = lo + (hi - lo) * i / (numBands + 1);
+            return mel ? melToHz(v) : std::exp(v);
+        };
+
+        for (int b = 0; b < numBands; ++b) {
+            const double left = pointHz(b), centre = pointHz(b + 1), right = pointHz(b + 2);
+
+            BandBuilder band;
+            for (int k = (int) std::ceil(left / binHz); k < numBins && k * binHz < right; ++k) {
+                const double f = k * binHz;
+                band.add(k, f <= centre ? (f - left) / (centre - left) : (right - f) / (right - centre));
+            }
+
+            if (band.bins.empty())
+                band.addInterpolated(centre / binHz, numBins);
+
+            bands.push_back(std::move(band));
+        }
+    }
+
+    matrix.bandStart.push_back(0);
+
+    for (const auto& band : bands) {
+        double total = 0.0;
+        for (auto w : band.weights)
+            total += w;
+
+        for (size_t i = 0; i < band.bins.size(); ++i) {
+            matrix.binIndex.push_back(band.bins[i]);
+            matrix.weight.push_back((float) (band.weights[i] / total));
+        }
+
+        matrix.bandStart.push_back((int) matrix.binIndex.size());
+    }
+
+    return matrix;
+}
@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    BandMap.h
+    Precomputed sparse matrices that reduce linear FFT bins to display bands.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Maps the linear bins of an FFT frame onto a smaller number of display bands
+    spaced on a log, mel, third-octave or linear frequency scale.
+
+    The weights are built once, for every FFT order the analyser supports, and
+    stored in compressed sparse row form: each band's (bin, weight) pairs sit
+    next to each other in memory, so apply() is a single forward pass. Every
+    band's weights sum to one, so a band's level is the weighted average
+    magnitude of the bins it covers. Bands narrower than a bin interpolate
+    between the two nearest bins.
+
+    A BandMap is immutable once built, which is what lets it be handed from the
+    message thread to the analysis thread through a single pointer swap.
+*/
+class BandMap
+{
+public:
+    enum class Scale
+    {
+        linear,
+        log,
+        mel,
+        thirdOctave
+    };
+
+    struct Layout
+    {
+        Scale scale = Scale::linear;
+        int numBands = 0;           // linear with 0 bands means raw FFT bins; ignored for third-octave
+
+        bool isPassthrough() const noexcept   { return scale == Scale::linear && numBands <= 0; }
+    };
+
+    static constexpr int maxBands = 1024;
+    static constexpr double minFrequency = 20.0;
+    static constexpr double maxFrequency = 20000.0;
+
+    /** Parses the frontend's scale names: "linear", "log", "mel" or "thirdoctave".
+        Anything else is linear.
+    */
+    static Scale scaleFromName (const juce::String& name);
+
+    /** Builds matrices for every FFT order in [minFftOrder, maxFftOrder]. Allocates,
+        so only call it off the audio thread.
+    */
+    BandMap (Layout layout, double sampleRate, int minFftOrder, int maxFftOrder);
+
+    const Layout& getLayout() const noexcept  { return layout; }
+    bool isPassthrough() const noexcept       { return layout.isPassthrough(); }
+
+    /** Number of bands produced for frames of the given FFT order. */
+    int getNumBands (int fftOrder) const noexcept;
+
+    /** bands[b] = sum of weight * bins[k] over band b's entries. Never allocates. */
+    void apply (int fftOrder, const float* bins, float* bands) const noexcept;
+
+private:
+    struct Matrix
+    {
+        std::vector<int> bandStart;     // numBands + 1 offsets into binIndex / weight
+        std::vector<int> binIndex;
+        std::vector<float> weight;
+
+        int getNumBands() const noexcept  { return juce::jmax(0, (int) bandStart.size() - 1); }
+    };
+
+    Matrix buildMatrix (int fftOrder) const;
+    const Matrix* getMatrix (int fftOrder) const noexcept;
+
+    Layout layout;
+    double sampleRate;
+    int minOrder;
+    std::vector<Matrix> matrices;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BandMap)
+};
@@ -0,0 +1,285 @@
+/*
+  ==============================================================================
+
+    CaptureFile.cpp
+
+  ==============================================================================
+*/
+
+#include "CaptureFile.h"
+
+namespace {
+template <typename IntType>
+IntType readLittleEndian (const juce::uint8* source)
+{
+    IntType value = 0;
+
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        value = (IntType) (value | ((IntType) source[i] << (8 * i)));
+
+    return value;
+}
+
+double readDouble (const juce::uint8* source)
+{
+    const auto bits = readLittleEndian<juce::uint64> (source);
+    double value;
+    std::memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+juce::int64 paddedSize (juce::int64 size) noexcept
+{
+    return (size + 7) & ~(juce::int64) 7;
+}
+
+// What the first pass learns about one clock epoch
+struct Epoch
+{
+    double sampleRate = 0.0;
+    juce::int64 firstPosition = std::numeric_limits<juce::int64>::max();
+    juce::int64 lastPosition = std::numeric_limits<juce::int64>::min();
+    double start = 0.0;                     // on the capture's timeline
+
+    bool hasRecords() const noexcept  { return firstPosition <= lastPosition; }
+};
+} // namespace
+
+//==============================================================================
+juce::Result CaptureFile::open (const juce::File& fileToOpen)
+{
+    using Capture = AnalysisCapture;
+
+    file = fileToOpen;
+    index.clear();
+    numFrames = numMidiEvents = 0;
+    duration = 0.0;
+    mapping = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+
+    const auto* bytes = static_cast<const juce::uint8*> (mapping->getData());
+    const auto fileSize = (juce::int64) mapping->getSize();
+
+    if (bytes == nullptr || fileSize < Capture::headerSize)
+    {
+        mapping.reset();
+        return juce::Result::fail ("Can't read " + file.getFullPathName());
+    }
+
+    if (bytes[0] != 'V' || bytes[1] != 'C' || bytes[2] != Capture::currentVersion
+        || readLittleEndian<juce::uint32> (bytes + 4) != (juce::uint32) Capture::headerSize)
+    {
+        mapping.reset();
+        return juce::Result::fail (file.getFileName() + " isn't a version " + juce::String (Capture::currentVersion) + " capture");
+    }
+
+    // Frames are replayed as they were stored, so they have to be in the current format
+    if (const auto frameVersion = (int) bytes[3]; frameVersion != SpectrumFrameEncoder::currentVersion)
+    {
+        mapping.reset();
+        return juce::Result::fail (file.getFileName() + " holds version " + juce::String (frameVersion)
+                                   + " frames; this build reads version " + juce::String ((int) SpectrumFrameEncoder::currentVersion));
+    }
+
+    committedSize = juce::jmin (fileSize, (juce::int64) readLittleEndian<juce::uint64> (bytes + 8));
+    startTime = juce::Time (readLittleEndian<juce::int64> (bytes + 16));
+    const auto startSampleRate = readDouble (bytes + 24);
+
+    // First pass: check every record fits and find where each epoch's positions run
+    std::vector<Epoch> epochs;
+    std::vector<juce::int64> offsets;
+    const auto firstEpoch = committedSize > Capture::headerSize + Capture::recordHeaderSize
+                              ? readLittleEndian<juce::uint16> (bytes + Capture::headerSize + 6) : (juce::uint16) 0;
+
+    const auto getEpoch = [&] (juce::uint16 number) -> Epoch&
+    {
+        // Epochs count up from the first record's, wrapping at 65536
+        const auto slot = (size_t) (juce::uint16) (number - firstEpoch);
+
+        if (epochs.size() <= slot)
+            epochs.resize (slot + 1);
+
+        return epochs[slot];
+    };
+
+    for (auto offset = (juce::int64) Capture::headerSize; offset + Capture::recordHeaderSize <= committedSize;)
+    {
+        const auto* header = bytes + offset;
+        const auto size = (juce::int64) readLittleEndian<juce::uint32> (header);
+        const auto end = offset + Capture::recordHeaderSize + paddedSize (size);
+
+        if (end > committedSize)
+            break;
+
+        auto& epoch = getEpoch (readLittleEndian<juce::uint16> (header + 6));
+        const auto position = readLittleEndian<juce::int64> (header + 8);
+
+        switch ((RecordKind) header[4])
+        {
+            case RecordKind::clock:
+                if (size >= Capture::clockPayloadSize)
+                    epoch.sampleRate = readDouble (header + Capture::recordHeaderSize);
+                break;
+
+            case RecordKind::frame:
+            case RecordKind::midi:
+                epoch.firstPosition = juce::jmin (epoch.firstPosition, position);
+                epoch.lastPosition = juce::jmax (epoch.lastPosition, position);
+                numFrames += header[4] == (juce::uint8) RecordKind::frame ? 1 : 0;
+                numMidiEvents += header[4] == (juce::uint8) RecordKind::midi ? (int) (size / Capture::midiEventSize) : 0;
+                break;
+
+            default:
+                break;  // from a later version; skipped
+        }
+
+        offsets.push_back (offset);
+        offset = end;
+    }
+
+    // Lay the epochs end to end. The first one's rate is in the header, not a clock record.
+    double start = 0.0;
+
+    for (auto& epoch : epochs)
+    {
+        if (epoch.sampleRate <= 0.0)
+            epoch.sampleRate = startSampleRate > 0.0 ? startSampleRate : 44100.0;
+
+        epoch.start = start;
+
+        if (epoch.hasRecords())
+            start += (double) (epoch.lastPosition - epoch.firstPosition) / epoch.sampleRate;
+    }
+
+    duration = start;
+
+    // Second pass: stamp each record with its time, then order them by it
+    index.reserve (offsets.size());
+
+    for (const auto offset : offsets)
+    {
+        const auto* header = bytes + offset;
+        const auto& epoch = getEpoch (readLittleEndian<juce::uint16> (header + 6));
+        const auto kind = (RecordKind) header[4];
+        auto time = epoch.start;
+
+        if (kind != RecordKind::clock && epoch.hasRecords())
+            time += (double) (readLittleEndian<juce::int64> (header + 8) - epoch.firstPosition) / epoch.sampleRate;
+
+        index.push_back ({ time, epoch.sampleRate, offset });
+    }
+
+    std::stable_sort (index.begin(), index.end(), [] (const Entry& a, const Entry& b) { return a.time < b.time; });
+    return juce::Result::ok();
+}
+
+CaptureFile::Record CaptureFile::getRecord (int recordIndex) const noexcept
+{
+    jassert (juce::isPositiveAndBelow (recordIndex, getNumRecords()));
+
+    const auto& entry = index[(size_t) recordIndex];
+    const auto* header = static_cast<const juce::uint8*> (mapping->getData()) + entry.offset;
+
+    Record record;
+    record.kind = (RecordKind) header[4];
+    record.epoch = readLittleEndian<juce::uint16> (header + 6);
+    record.position = readLittleEndian<juce::int64> (header + 8);
+    record.time = entry.time;
+    record.sampleRate = entry.sampleRate;
+    record.data = header + AnalysisCapture::recordHeaderSize;
+    record.size = (int) readLittleEndian<juce::uint32> (header);
+    return record;
+}
+
+int CaptureFile::findRecord (double seconds) const noexcept
+{
+    const auto found = std::lower_bound (index.begin(), index.end(), seconds,
+                                         [] (const Entry& entry, double time) { return entry.time < time; });
+    return (int) std::distance (index.begin(), found);
+}
+
+MidiEvent CaptureFile::getMidiEvent (const Record& record, int eventIndex) noexcept
+{
+    jassert (record.kind == RecordKind::midi && juce::isPositiveAndBelow (eventIndex, getNumMidiEvents (record)));
+
+    const auto* source = record.data + eventIndex * AnalysisCapture::midiEventSize;
+
+    MidiEvent event;
+    event.type = (MidiEvent::Type) source[0];
+    event.channel = source[1];
+    event.note = source[2];
+    event.value = source[3];
+    event.sampleOffset = (int) readLittleEndian<juce::uint32> (source + 4);
+    return event;
+}
+
+//==============================================================================
+CaptureReplay::CaptureReplay (std::unique_ptr<CaptureFile> fileToPlay)
+    : file (std::move (fileToPlay))
+{
+    jassert (file != nullptr);
+    seek (0.0);
+}
+
+void CaptureReplay::setPlaying (bool shouldPlay)
+{
+    anchorPosition = getPosition();
+    anchorTime = now();
+    playing = shouldPlay;
+}
+
+void CaptureReplay::setSpeed (double newSpeed)
+{
+    anchorPosition = getPosition();
+    anchorTime = now();
+    speed = juce::jmax (0.0, newSpeed);
+}
+
+void CaptureReplay::seek (double seconds)
+{
+    anchorPosition = juce::jlimit (0.0, file->getDuration(), seconds);
+    anchorTime = now();
+    nextFrame = file->findRecord (anchorPosition - seekLookbackSeconds);
+    nextMidi = file->findRecord (anchorPosition);
+}
+
+double CaptureReplay::getPosition() const noexcept
+{
+    if (! playing)
+        return anchorPosition;
+
+    return juce::jmin (file->getDuration(), anchorPosition + (now() - anchorTime) * speed);
+}
+
+juce::Array<juce::var> CaptureReplay::pullFrames()
+{
+    const auto position = getPosition();
+    std::array<int, numSpectrumStreams> newest;
+    newest.fill (-1);
+
+    for (; nextFrame < file->getNumRecords(); ++nextFrame)
+    {
+        const auto record = file->getRecord (nextFrame);
+
+        if (record.time > position)
+            break;
+
+        EncodedFrame frame;
+
+        if (record.kind == CaptureFile::RecordKind::frame && frame.read (record.data, (size_t) record.size)
+            && (int) frame.stream < numSpectrumStreams)
+            newest[(size_t) frame.stream] = nextFrame;
+    }
+
+    juce::Array<juce::var> encoded;
+
+    for (const auto recordIndex : newest)
+    {
+        if (recordIndex >= 0)
+        {
+            const auto record = file->getRecord (recordIndex);
+            encoded.add (juce::Base64::toBase64 (record.data, (size_t) record.size));
+        }
+    }
+
+    return encoded;
+}
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+    CaptureFile.h
+    Reads captures written by AnalysisCapture through a memory mapping, and
+    replays them at any speed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisCapture.h"
+
+//==============================================================================
+/**
+    Maps a capture read-only and indexes its records by time once, in open().
+    Nothing is copied after that: a Record points into the mapping and stays
+    valid while the CaptureFile is open, so replaying a show or dumping it
+    costs a pass over pages the OS already has, however long the show was.
+
+    Positions restart at every prepareToPlay, so the clock epochs are laid end
+    to end on one timeline, in seconds from the first record of the first one.
+    Seeking and replay use that timeline. Records at the same time keep their
+    order in the file.
+
+    Only the committed part of the file is read, so a capture that is still
+    being written, or was cut short by a crash, opens up to its last whole
+    batch of records.
+*/
+class CaptureFile
+{
+public:
+    using RecordKind = AnalysisCapture::RecordKind;
+
+    struct Record
+    {
+        RecordKind kind = RecordKind::frame;
+        juce::uint16 epoch = 0;
+        juce::int64 position = 0;           // samples since prepareToPlay, as recorded
+        double time = 0.0;                  // seconds on the capture's timeline
+        double sampleRate = 44100.0;        // of the epoch the record is in
+        const juce::uint8* data = nullptr;  // the payload, inside the mapping
+        int size = 0;
+    };
+
+    CaptureFile() = default;
+
+    /** Maps and indexes `file`. Fails if it isn't a capture in the current
+        version, or its frames aren't in the current 'VF' version; a truncated
+        last record is left out rather than failing.
+    */
+    juce::Result open (const juce::File& file);
+
+    const juce::File& getFile() const noexcept  { return file; }
+    juce::Time getStartTime() const noexcept    { return startTime; }
+    double getDuration() const noexcept         { return duration; }
+    juce::int64 getSize() const noexcept        { return committedSize; }
+
+    int getNumRecords() const noexcept          { return (int) index.size(); }
+    int getNumFrames() const noexcept           { return numFrames; }
+    int getNumMidiEvents() const noexcept       { return numMidiEvents; }
+
+    /** The index-th record in time order. */
+    Record getRecord (int recordIndex) const noexcept;
+
+    /** The first record at or after `seconds`, or getNumRecords() if none is. */
+    int findRecord (double seconds) const noexcept;
+
+    /** The events of a midi record, with sampleOffset counting from its position. */
+    static int getNumMidiEvents (const Record& record) noexcept  { return record.size / AnalysisCapture::midiEventSize; }
+    static MidiEvent getMidiEvent (const Record& record, int eventIndex) noexcept;
+
+private:
+    struct Entry
+    {
+        double time;
+        double sampleRate;
+        juce::int64 offset;                 // of the record header in the mapping
+    };
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    std::vector<Entry> index;
+    juce::Time startTime;
+    juce::int64 committedSize = 0;
+    double duration = 0.0;
+    int numFrames = 0, numMidiEvents = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptureFile)
+};
+
+//==============================================================================
+/**
+    Plays a CaptureFile back against the wall clock, at any speed, in place of
+    the live analysis. Frames are handed out as FramePacer hands out live ones:
+    for each stream, the newest that has fallen due since the last pull. MIDI
+    records are visited as they fall due.
+
+    Seeking shows the frames of the seekLookbackSeconds before the new position
+    on the next pull, so a paused replay still shows where it is. Notes before
+    it aren't replayed. Message thread only.
+*/
+class CaptureReplay
+{
+public:
+    static constexpr double seekLookbackSeconds = 0.25;
+
+    explicit CaptureReplay (std::unique_ptr<CaptureFile> fileToPlay);
+
+    const CaptureFile& getFile() const noexcept  { return *file; }
+
+    void setPlaying (bool shouldPlay);
+    bool isPlaying() const noexcept             { return playing; }
+
+    /** 1 is real time; 0 freezes the position like pausing. */
+    void setSpeed (double newSpeed);
+    double getSpeed() const noexcept            { return speed; }
+
+    void seek (double seconds);
+
+    /** Seconds on the capture's timeline, stopping at the end. */
+    double getPosition() const noexcept;
+
+    /** The newest due frame of each stream since the last pull, as base64 'VF'
+        frames, the same as FramePacer::pull().
+    */
+    juce::Array<juce::var> pullFrames();
+
+    /** Calls `visit (const CaptureFile::Record&)` for every midi record that has
+        fallen due since the last call.
+    */
+    template <typename Visit>
+    void takeMidi (Visit&& visit)
+    {
+        const auto position = getPosition();
+
+        for (; nextMidi < file->getNumRecords(); ++nextMidi)
+        {
+            const auto record = file->getRecord (nextMidi);
+
+            if (record.time > position)
+                break;
+
+            if (record.kind == CaptureFile::RecordKind::midi)
+                visit (record);
+        }
+    }
+
+private:
+    static double now() noexcept  { return juce::Time::getMillisecondCounterHiRes() / 1000.0; }
+
+    std::unique_ptr<CaptureFile> file;
+    bool playing = false;
+    double speed = 1.0;
+    double anchorPosition = 0.0;            // where the replay was at anchorTime
+    double anchorTime = 0.0;
+    int nextFrame = 0, nextMidi = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptureReplay)
+};
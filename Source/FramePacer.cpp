@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    FramePacer.cpp
+
+  ==============================================================================
+*/
+
+#include "FramePacer.h"
+
+namespace {
+void copyFrame (const SpectrumFrame& source, SpectrumFrame& dest)
+{
+    // Slots start empty and only grow, so this allocates for the first frames of a new size
+    if ((int) dest.bins.size() < source.numBins)
+        dest.allocate (source.numBins);
+
+    dest.setBins (source.bins.data(), source.numBins);
+    dest.setPeaks (source.hasPeaks ? source.peaks.data() : nullptr);
+    dest.scale = source.scale;
+    dest.stream = source.stream;
+    dest.sequence = source.sequence;
+    dest.analysedTicks = source.analysedTicks;
+    dest.samplePosition = source.samplePosition;
+    dest.hostPosition = source.hostPosition;
+    dest.levels = source.levels;
+    dest.hasFeatures = source.hasFeatures;
+    dest.features = source.features;
+}
+
+// Onsets and beats are events rather than state, so a frame that replaces others, or
+// is sent instead of them, takes theirs along
+struct Events
+{
+    bool onset = false, beat = false;
+};
+
+Events getEvents (const SpectrumFrame& frame) noexcept
+{
+    return frame.hasFeatures ? Events { frame.features.onset, frame.features.beat } : Events {};
+}
+
+void addEvents (SpectrumFrame& frame, Events events) noexcept
+{
+    if (frame.hasFeatures)
+    {
+        frame.features.onset = frame.features.onset || events.onset;
+        frame.features.beat = frame.features.beat || events.beat;
+    }
+}
+} // namespace
+
+//==============================================================================
+bool FramePacer::isSilent (const SpectrumFrame& frame) noexcept
+{
+    // Decaying peaks or a slow release still move, so they count as sound
+    const auto isQuiet = [&frame] (const std::vector<float>& values)
+    {
+        return juce::FloatVectorOperations::findMaximum (values.data(), frame.numBins) < silenceThreshold;
+    };
+
+    return frame.numBins == 0 || (isQuiet (frame.bins) && (! frame.hasPeaks || isQuiet (frame.peaks)));
+}
+
+bool FramePacer::isSame (const SpectrumFrame& a, const SpectrumFrame& b) noexcept
+{
+    const auto equal = [n = a.numBins] (const std::vector<float>& x, const std::vector<float>& y)
+    {
+        return std::equal (x.begin(), x.begin() + n, y.begin());
+    };
+
+    return a.numBins == b.numBins
+        && a.scale == b.scale
+        && a.hasPeaks == b.hasPeaks
+        && a.levels == b.levels
+        && a.hasFeatures == b.hasFeatures
+        && (! a.hasFeatures || a.features == b.features)
+        && equal (a.bins, b.bins)
+        && (! a.hasPeaks || equal (a.peaks, b.peaks));
+}
+
+void FramePacer::schedule (Slot& slot, const SpectrumFrame& frame)
+{
+    if (slot.numScheduled > 0)
+    {
+        auto& newest = slot.get (slot.numScheduled - 1);
+
+        // Frames share a slot when they fall in the same minFrameSpacing-wide bucket, so a
+        // run of close frames can't creep forward one replacement at a time
+        const auto bucket = [this] (const SpectrumFrame& f) { return std::floor ((double) f.samplePosition / minFrameSpacingSamples); };
+
+        if (frame.samplePosition < newest.samplePosition)
+        {
+            // The clock went backwards, so the processor was re-prepared: start over
+            slot.numScheduled = 0;
+        }
+        else if (bucket (frame) == bucket (newest))
+        {
+            const auto events = getEvents (newest);
+            copyFrame (frame, newest);
+            addEvents (newest, events);
+            return;
+        }
+    }
+
+    // Further ahead of the audio than we can hold: the oldest is never shown
+    if (slot.numScheduled == maxScheduledFrames)
+    {
+        addEvents (slot.get (1), getEvents (slot.get (0)));
+        slot.first = (slot.first + 1) % maxScheduledFrames;
+        --slot.numScheduled;
+    }
+
+    copyFrame (frame, slot.get (slot.numScheduled++));
+}
+
+void FramePacer::collect (SpectrumFrameQueue& queue)
+{
+    while (popSpectrumFrame (queue, [this] (const SpectrumFrame& frame) { schedule (slots[(size_t) frame.stream], frame); }))
+    {
+    }
+}
+
+juce::Array<juce::var> FramePacer::pull (SpectrumFrameQueue& queue, PerfTelemetry& telemetry,
+                                         const AudioClock* clock, double presentAheadSeconds)
+{
+    collect (queue);
+
+    // The sample being heard when whatever we send now reaches the screen
+    AudioClock::Anchor anchor;
+    auto presentedPosition = std::numeric_limits<double>::max();
+
+    if (clock != nullptr)
+    {
+        anchor = clock->read();
+
+        if (anchor.isRunning())
+        {
+            const auto presentTicks = PerfTelemetry::now() + juce::Time::secondsToHighResolutionTicks (presentAheadSeconds);
+            presentedPosition = clock->getHeardPosition (anchor, presentTicks);
+            minFrameSpacingSamples = anchor.sampleRate * minFrameSpacingSeconds;
+            lastPresentAhead = presentAheadSeconds;
+        }
+    }
+
+    juce::Array<juce::var> encoded;
+
+    for (auto& slot : slots)
+    {
+        int numDue = 0;
+
+        while (numDue < slot.numScheduled && (double) slot.get (numDue).samplePosition <= presentedPosition)
+            ++numDue;
+
+        if (numDue == 0)
+            continue;
+
+        // Anything older than the newest due frame would be shown after its time, so drop it
+        auto& frame = slot.get (numDue - 1);
+
+        for (int i = 0; i < numDue - 1; ++i)
+            addEvents (frame, getEvents (slot.get (i)));
+
+        slot.first = (slot.first + numDue) % maxScheduledFrames;
+        slot.numScheduled -= numDue;
+
+        const auto events = getEvents (frame);
+
+        if (slot.hasSent && ! events.onset && ! events.beat
+            && (isSame (frame, slot.lastSent) || (isSilent (frame) && isSilent (slot.lastSent))))
+        {
+            ++numSkipped;
+            continue;
+        }
+
+        if (anchor.isRunning())
+        {
+            frame.hostPosition = anchor.toHostPosition (frame.samplePosition);
+            lastSyncError = (presentedPosition - (double) frame.samplePosition) / anchor.sampleRate;
+            telemetry.record (PerfTelemetry::Stage::avSync, (juce::int64) (juce::jmax (0.0, lastSyncError) * 1.0e9));
+        }
+
+        const auto encodeStart = PerfTelemetry::now();
+        encoded.add (encoder.encode (frame));
+        telemetry.recordSince (PerfTelemetry::Stage::encode, encodeStart);
+        telemetry.recordSince (PerfTelemetry::Stage::frameLatency, frame.analysedTicks);
+
+        copyFrame (frame, slot.lastSent);
+        slot.hasSent = true;
+        ++numSent;
+    }
+
+    return encoded;
+}
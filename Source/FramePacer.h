@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    FramePacer.h
+    Holds the processor's spectrum frames until the frontend asks for them and
+    their audio is being heard.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+#include "SpectrumFrameEncoder.h"
+#include "PerfTelemetry.h"
+#include "AudioClock.h"
+
+//==============================================================================
+/**
+    The frontend pulls frames once per requestAnimationFrame through the
+    editor's pullFrames native function, so frames go out at the display's
+    refresh rate rather than at a fixed timer rate.
+
+    A frame is ready well before its audio reaches the speakers, by up to a
+    host buffer plus the device's latency. So between pulls, collect() drains
+    the processor's queue into a short schedule per stream, and pull() sends
+    the newest frame whose audio will be heard by the time the frontend shows
+    it: the clock's heard position, `presentAhead` from now, which covers the
+    trip back to the WebView and the wait for its next paint. Later frames
+    wait for a later pull; earlier ones are never shown. Frames that land in
+    the same minFrameSpacing-wide slice of time replace one another, as no
+    display would show both, so the schedule stays short even with small hops
+    and large buffers. Without a running clock every pull just sends the
+    newest frame.
+
+    A stream is skipped when the frame due is identical to the one sent last,
+    meter levels and features included, or when it is silent (every value
+    under one 8-bit step) and the last frame sent already was, so a quiet input
+    costs no encoding and no traffic after the frame that clears the display.
+    Onsets and beats are never lost this way: a frame that replaces or skips
+    past others carries their events, and a frame with an event is always sent.
+
+    Message thread only. Schedule slots are sized as frames arrive, so memory
+    follows the frame size actually in use.
+*/
+class FramePacer
+{
+public:
+    /** Normalised values under this are indistinguishable from 0 once quantised. */
+    static constexpr float silenceThreshold = 0.5f / 255.0f;
+
+    /** Frames closer together than this are coalesced: a quarter of a 60 Hz frame. */
+    static constexpr double minFrameSpacingSeconds = 1.0 / 240.0;
+
+    /** Frames held per stream. At minFrameSpacing that's over a quarter of a second. */
+    static constexpr int maxScheduledFrames = 64;
+
+    FramePacer() = default;
+
+    /** Moves every frame waiting in `queue` into the per-stream schedules. */
+    void collect (SpectrumFrameQueue& queue);
+
+    /** collect()s, then returns the encoded frames (see SpectrumFrameEncoder)
+        of every stream with something new to show, scheduled against `clock`
+        if there is one. Encoding time, frame latency and A/V sync go to
+        `telemetry`.
+    */
+    juce::Array<juce::var> pull (SpectrumFrameQueue& queue, PerfTelemetry& telemetry,
+                                 const AudioClock* clock = nullptr, double presentAheadSeconds = 0.0);
+
+    /** Frames pulled and frames skipped as silent or unchanged, since construction. */
+    juce::uint64 getNumSent() const noexcept       { return numSent; }
+    juce::uint64 getNumSkipped() const noexcept    { return numSkipped; }
+
+    /** How far behind its audio the last frame sent will be shown, in seconds,
+        negative if ahead. Includes the analysis window: a frame is stamped at
+        its window's centre, so it can't be shown before half a window has passed.
+    */
+    double getLastSyncError() const noexcept           { return lastSyncError; }
+    double getLastPresentAhead() const noexcept        { return lastPresentAhead; }
+
+private:
+    struct Slot
+    {
+        std::array<SpectrumFrame, maxScheduledFrames> scheduled;    // ring, oldest at `first`
+        int first = 0, numScheduled = 0;
+        SpectrumFrame lastSent;     // what the frontend is showing
+        bool hasSent = false;
+
+        SpectrumFrame& get (int i) noexcept  { return scheduled[(size_t) ((first + i) % maxScheduledFrames)]; }
+    };
+
+    void schedule (Slot& slot, const SpectrumFrame& frame);
+
+    static bool isSilent (const SpectrumFrame& frame) noexcept;
+    static bool isSame (const SpectrumFrame& a, const SpectrumFrame& b) noexcept;
+
+    std::array<Slot, numSpectrumStreams> slots;
+    SpectrumFrameEncoder encoder;
+    juce::uint64 numSent = 0, numSkipped = 0;
+    double minFrameSpacingSamples = 44100.0 * minFrameSpacingSeconds;
+    double lastSyncError = 0.0, lastPresentAhead = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FramePacer)
+};
@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    FrontendResources.cpp
+
+  ==============================================================================
+*/
+
+#include "FrontendResources.h"
+
+namespace {
+using Entry = FrontendResources::Entry;
+
+// One row per file in the "Frontend" group of Viber.jucer. Projucer names each
+// BinaryData symbol after the file name with the dot replaced, so new files need
+// a row here too. Keep the rows sorted by path: lookups are a binary search.
+constexpr Entry embeddedFiles[] =
+{
+    { "css/styles.css",                    &BinaryData::styles_css,               BinaryData::styles_cssSize,               "text/css"        },
+    { "images/cat.gif",                    &BinaryData::cat_gif,                  BinaryData::cat_gifSize,                  "image/gif"       },
+    { "images/close.jpeg",                 &BinaryData::close_jpeg,               BinaryData::close_jpegSize,               "image/jpeg"      },
+    { "images/open.jpg",                   &BinaryData::open_jpg,                 BinaryData::open_jpgSize,                 "image/jpeg"      },
+    { "index.html",                        &BinaryData::index_html,               BinaryData::index_htmlSize,               "text/html"       },
+    { "js/juce/check_native_interop.js",   &BinaryData::check_native_interop_js,  BinaryData::check_native_interop_jsSize,  "text/javascript" },
+    { "js/juce/index.js",                  &BinaryData::index_js,                 BinaryData::index_jsSize,                 "text/javascript" },
+    { "js/juce/viber.js",                  &BinaryData::viber_js,                 BinaryData::viber_jsSize,                 "text/javascript" },
+    { "js/p5animation.js",                 &BinaryData::p5animation_js,           BinaryData::p5animation_jsSize,           "text/javascript" },
+    { "js/p5fft.js",                       &BinaryData::p5fft_js,                 BinaryData::p5fft_jsSize,                 "text/javascript" },
+    { "js/p5fft3d.js",                     &BinaryData::p5fft3d_js,               BinaryData::p5fft3d_jsSize,               "text/javascript" },
+    { "js/p5fft3dcircle.js",               &BinaryData::p5fft3dcircle_js,         BinaryData::p5fft3dcircle_jsSize,         "text/javascript" },
+    { "js/selector.js",                    &BinaryData::selector_js,              BinaryData::selector_jsSize,              "text/javascript" },
+    { "js/threeanimation.js",              &BinaryData::threeanimation_js,        BinaryData::threeanimation_jsSize,        "text/javascript" }
+};
+
+constexpr bool isSortedByPath()
+{
+    for (size_t i = 1; i < std::size (embeddedFiles); ++i)
+        if (! (embeddedFiles[i - 1].path < embeddedFiles[i].path))
+            return false;
+
+    return true;
+}
+
+static_assert (isSortedByPath(), "embeddedFiles must be sorted by path, with no duplicates");
+
+const char* getMimeForExtension (const juce::String& extension)
+{
+    static const std::unordered_map<juce::String, const char*> mimeMap =
+    {
+        { { "htm"   },  "text/html"                },
+        { { "html"  },  "text/html"                },
+        { { "txt"   },  "text/plain"               },
+        { { "jpg"   },  "image/jpeg"               },
+        { { "jpeg"  },  "image/jpeg"               },
+        { { "gif"   },  "image/gif"                },
+        { { "svg"   },  "image/svg+xml"            },
+        { { "ico"   },  "image/vnd.microsoft.icon" },
+        { { "json"  },  "application/json"         },
+        { { "png"   },  "image/png"                },
+        { { "css"   },  "text/css"                 },
+        { { "map"   },  "application/json"         },
+        { { "js"    },  "text/javascript"          },
+        { { "woff2" },  "font/woff2"               }
+    };
+
+    if (const auto it = mimeMap.find (extension.toLowerCase()); it != mimeMap.end())
+        return it->second;
+
+    jassertfalse;
+    return "";
+}
+} // namespace
+
+//==============================================================================
+FrontendResources::FrontendResources()
+{
+   #if JUCE_DEBUG
+    const auto directory = juce::SystemStats::getEnvironmentVariable ("VIBER_FRONTEND_DIR", {});
+
+    if (juce::File::isAbsolutePath (directory) && juce::File (directory).isDirectory())
+        developmentDirectory = juce::File (directory);
+   #endif
+}
+
+const FrontendResources::Entry* FrontendResources::findEmbedded (std::string_view path) noexcept
+{
+    const auto* end = std::end (embeddedFiles);
+    const auto* it = std::lower_bound (std::begin (embeddedFiles), end, path,
+                                       [] (const Entry& entry, std::string_view p) { return entry.path < p; });
+
+    return it != end && it->path == path ? it : nullptr;
+}
+
+auto FrontendResources::get (const juce::String& url) const -> std::optional<Resource>
+{
+    // Drop the leading slash and any cache-busting query; "/" is the page itself
+    auto path = url.upToFirstOccurrenceOf ("?", false, false).fromFirstOccurrenceOf ("/", false, false);
+
+    if (path.isEmpty())
+        path = "index.html";
+
+    if (isServingFromDirectory())
+        return loadFromDirectory (path);
+
+    if (const auto* entry = findEmbedded (path.toRawUTF8()))
+    {
+        // Resource owns its bytes, so this one copy out of the binary is all the work there is
+        const auto* bytes = reinterpret_cast<const std::byte*> (*entry->data);
+        return Resource { std::vector<std::byte> (bytes, bytes + entry->size), entry->mimeType };
+    }
+
+    return std::nullopt;
+}
+
+auto FrontendResources::loadFromDirectory (const juce::String& path) const -> std::optional<Resource>
+{
+    const auto file = developmentDirectory.getChildFile (path);
+
+    // Never serve anything outside the folder, whatever the page asks for
+    if (! file.isAChildOf (developmentDirectory) || ! file.existsAsFile())
+        return std::nullopt;
+
+    juce::MemoryBlock contents;
+
+    if (! file.loadFileAsData (contents))
+        return std::nullopt;
+
+    const auto* bytes = static_cast<const std::byte*> (contents.getData());
+    return Resource { std::vector<std::byte> (bytes, bytes + contents.getSize()),
+                      getMimeForExtension (file.getFileExtension().substring (1)) };
+}
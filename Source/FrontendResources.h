@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    FrontendResources.h
+    Serves the Frontend/public tree to the editor's WebBrowserComponent.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Resource provider for the editor's web view. The frontend files are compiled
+    into BinaryData (the "Frontend" group in Viber.jucer) and found through a
+    sorted constexpr table of path -> (data, size, mime type), so a request is a
+    binary search and a single copy into the response, with no file access.
+
+    In debug builds, setting the VIBER_FRONTEND_DIR environment variable to a
+    Frontend/public folder serves the files from disk instead, so sketches can be
+    edited without rebuilding the plugin.
+*/
+class FrontendResources
+{
+public:
+    using Resource = juce::WebBrowserComponent::Resource;
+
+    struct Entry
+    {
+        std::string_view path;          // relative to Frontend/public
+        const char* const* data;        // the BinaryData symbol for the file
+        int size;
+        const char* mimeType;
+    };
+
+    FrontendResources();
+
+    /** The resource provider callback. url is the request path, e.g. "/js/p5fft.js?t=123". */
+    std::optional<Resource> get (const juce::String& url) const;
+
+    /** The embedded file at a path relative to Frontend/public, or nullptr. */
+    static const Entry* findEmbedded (std::string_view path) noexcept;
+
+    bool isServingFromDirectory() const noexcept  { return developmentDirectory != juce::File(); }
+
+private:
+    std::optional<Resource> loadFromDirectory (const juce::String& path) const;
+
+    juce::File developmentDirectory;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FrontendResources)
+};
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    GainStage.cpp
+
+  ==============================================================================
+*/
+
+#include "GainStage.h"
+
+//==============================================================================
+void BlockLevels::merge (const BlockLevels& other) noexcept
+{
+    numChannels = juce::jmax (numChannels, other.numChannels);
+    numSamples += other.numSamples;
+    endPosition = other.endPosition;
+
+    for (int ch = 0; ch < other.numChannels; ++ch)
+    {
+        sumSquares[(size_t) ch] += other.sumSquares[(size_t) ch];
+        peak[(size_t) ch] = juce::jmax (peak[(size_t) ch], other.peak[(size_t) ch]);
+        truePeak[(size_t) ch] = juce::jmax (truePeak[(size_t) ch], other.truePeak[(size_t) ch]);
+    }
+}
+
+MeterLevels BlockLevels::toMeterLevels() const noexcept
+{
+    MeterLevels levels;
+    levels.numChannels = numChannels;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto& channel = levels.channels[(size_t) ch];
+        channel.rms = numSamples > 0 ? (float) std::sqrt (sumSquares[(size_t) ch] / numSamples) : 0.0f;
+        channel.peak = peak[(size_t) ch];
+        channel.truePeak = truePeak[(size_t) ch];
+    }
+
+    return levels;
+}
+
+//==============================================================================
+void GainStage::prepare (double sampleRate, int maxBlockSize, float initialGain)
+{
+    gain.reset (sampleRate, rampSeconds);
+    gain.setCurrentAndTargetValue (initialGain);
+
+    chunkSize = juce::jmax (1, maxBlockSize);
+    scratchStride = historySize + chunkSize;
+    scratch.assign ((size_t) (maxChannels * scratchStride), 0.0f);
+}
+
+BlockLevels GainStage::process (juce::AudioBuffer<float>& buffer, float targetGain) noexcept
+{
+    const int numChannels = buffer.getNumChannels();
+    const int numMetered = juce::jmin (numChannels, maxChannels);
+    const int numSamples = buffer.getNumSamples();
+
+    BlockLevels levels;
+    levels.numChannels = numMetered;
+    levels.numSamples = numSamples;
+
+    gain.setTargetValue (targetGain);
+
+    for (int start = 0; start < numSamples; start += chunkSize)
+    {
+        const int num = juce::jmin (chunkSize, numSamples - start);
+        const auto startGain = gain.getCurrentValue();
+        const auto endGain = gain.skip (num);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* samples = buffer.getWritePointer (ch, start);
+            const auto sums = SpectrumKernels::applyGainAndMeasure (samples, num, startGain, endGain);
+
+            if (ch >= numMetered)
+                continue;
+
+            // Copy behind the previous chunk's tail, measure, then keep this chunk's tail
+            auto* row = scratch.data() + ch * scratchStride;
+            juce::FloatVectorOperations::copy (row + historySize, samples, num);
+            const auto interpolated = SpectrumKernels::truePeak (row + historySize, num);
+            std::memmove (row, row + num, sizeof (float) * (size_t) historySize);
+
+            levels.sumSquares[(size_t) ch] += sums.sumSquares;
+            levels.peak[(size_t) ch] = juce::jmax (levels.peak[(size_t) ch], sums.peak);
+            levels.truePeak[(size_t) ch] = juce::jmax (levels.truePeak[(size_t) ch], sums.peak, interpolated);
+        }
+    }
+
+    return levels;
+}
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    GainStage.h
+    The gain parameter, applied to the main input before anything else sees
+    it, with RMS, peak and true-peak metering in the same pass.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+#include "SpectrumKernels.h"
+
+//==============================================================================
+/** What one block measured, kept as sums so consecutive blocks can be merged
+    before they are turned into MeterLevels.
+*/
+struct BlockLevels
+{
+    static constexpr int maxChannels = MeterLevels::maxChannels;
+
+    juce::int64 endPosition = 0;    // input position after the block, set by SpectrumAnalyser::writeLevels
+    int numSamples = 0;
+    int numChannels = 0;
+    std::array<double, maxChannels> sumSquares {};
+    std::array<float, maxChannels> peak {};
+    std::array<float, maxChannels> truePeak {};
+
+    /** Folds a later block into this one. */
+    void merge (const BlockLevels& other) noexcept;
+
+    MeterLevels toMeterLevels() const noexcept;
+};
+
+//==============================================================================
+/**
+    Applies the gain parameter to the main input in place, so the output and
+    every analysed stream are after it. Changes are ramped over rampSeconds
+    with a juce::SmoothedValue, so automation never clicks.
+
+    Each channel is handled by two kernels while it is still in cache: one
+    multiplies by the ramp and measures the RMS and peak on the way, the
+    other interpolates at four times the rate for the true peak. Only the first
+    maxChannels channels are metered; any others just get the gain.
+
+    The interpolator needs the end of the previous block, so each metered
+    channel keeps a short history in front of a scratch copy of the block.
+    Everything is sized in prepare(); process() never allocates, and blocks
+    longer than announced are handled in chunks.
+*/
+class GainStage
+{
+public:
+    static constexpr int maxChannels = BlockLevels::maxChannels;
+    static constexpr double rampSeconds = 0.02;
+
+    /** Call from prepareToPlay. Jumps straight to `initialGain` rather than
+        ramping to it, and forgets the interpolator history.
+    */
+    void prepare (double sampleRate, int maxBlockSize, float initialGain);
+
+    /** Audio thread: ramps towards `targetGain` across the buffer's channels and
+        returns what they measured afterwards.
+    */
+    BlockLevels process (juce::AudioBuffer<float>& buffer, float targetGain) noexcept;
+
+private:
+    static constexpr int historySize = SpectrumKernels::truePeakTapsPerPhase - 1;
+
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> gain;
+
+    // One row per metered channel: historySize samples of the previous block, then the current one
+    std::vector<float> scratch;
+    int scratchStride = 0;
+    int chunkSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GainStage)
+};
@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    MidiEventQueue.h
+    Raw note and pressure events captured on the audio thread, one batch per
+    block, for delivery by the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeQueue.h"
+
+//==============================================================================
+/**
+    The fields of a note or pressure message we care about, kept as plain bytes
+    so that capturing one on the audio thread is a handful of stores. Anything
+    that needs a juce::String (note names etc.) is built later, in the frontend.
+*/
+struct MidiEvent
+{
+    enum class Type : juce::uint8
+    {
+        noteOn,
+        noteOff,
+        polyPressure,       // aftertouch on one note
+        channelPressure     // aftertouch on the whole channel, e.g. per note in MPE
+    };
+
+    /** Fills the event from raw MIDI bytes. Returns false for anything that
+        isn't a note on/off or pressure (CC, pitch bend, sysex...), so the caller
+        can skip it without looking any further.
+    */
+    bool parse (const juce::uint8* data, int numBytes, int samplePosition) noexcept
+    {
+        if (numBytes < 2)
+            return false;
+
+        const auto status = (juce::uint8) (data[0] & 0xf0);
+        channel = (juce::uint8) ((data[0] & 0x0f) + 1);
+        sampleOffset = samplePosition;
+
+        if (status == 0xd0)
+        {
+            type = Type::channelPressure;
+            note = 0;
+            value = (juce::uint8) (data[1] & 0x7f);
+            return true;
+        }
+
+        if (numBytes < 3 || (status != 0x90 && status != 0x80 && status != 0xa0))
+            return false;
+
+        // A note-on with zero velocity is a note-off by convention
+        if (status == 0xa0)
+            type = Type::polyPressure;
+        else
+            type = (status == 0x90 && data[2] != 0) ? Type::noteOn : Type::noteOff;
+
+        note = (juce::uint8) (data[1] & 0x7f);
+        value = (juce::uint8) (data[2] & 0x7f);
+        return true;
+    }
+
+    Type type = Type::noteOn;
+    juce::uint8 note = 0;
+    juce::uint8 value = 0;          // velocity for notes, pressure for pressure events
+    juce::uint8 channel = 1;        // 1..16, as in juce::MidiMessage
+    int sampleOffset = 0;           // position inside the processBlock buffer
+};
+
+//==============================================================================
+/**
+    The events of one processBlock call, stamped with the block's start time in
+    samples since prepareToPlay. A block with more than maxEvents events takes
+    several consecutive batches with the same time; a block with none takes no
+    slot at all.
+*/
+struct MidiEventBatch
+{
+    static constexpr int maxEvents = 32;
+
+    bool isFull() const noexcept  { return numEvents == maxEvents; }
+
+    void add (const MidiEvent& event) noexcept
+    {
+        jassert (! isFull());
+        events[(size_t) numEvents++] = event;
+    }
+
+    juce::int64 time = 0;
+    int numEvents = 0;
+    std::array<MidiEvent, maxEvents> events;
+};
+
+using MidiEventQueue = RealtimeQueue<MidiEventBatch>;
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    MidiNoteState.cpp
+
+  ==============================================================================
+*/
+
+#include "MidiNoteState.h"
+
+//==============================================================================
+int MidiNoteState::Snapshot::getNumHeld (int channel) const noexcept
+{
+    int count = 0;
+
+    for (int ch = 1; ch <= numChannels; ++ch)
+        if (channel == 0 || channel == ch)
+            for (const auto word : held[(size_t) (ch - 1)])
+                count += juce::countNumberOfBits (word);
+
+    return count;
+}
+
+//==============================================================================
+void MidiNoteState::reset() noexcept
+{
+    beginChanges();
+    state = {};
+    endChanges();
+}
+
+void MidiNoteState::apply (const MidiEvent& event, juce::int64 time) noexcept
+{
+    if (event.channel < 1 || event.channel > numChannels)
+        return;
+
+    const auto channel = (size_t) (event.channel - 1);
+    const auto key = (size_t) Snapshot::getKey (event.channel, event.note);
+    auto& word = state.held[channel][(size_t) (event.note / 64)];
+    const auto bit = (juce::uint64) 1 << (event.note % 64);
+
+    switch (event.type)
+    {
+        case MidiEvent::Type::noteOn:
+            word |= bit;
+            state.velocity[key] = event.value;
+            state.pressure[key] = 0;
+            state.onTime[key] = time;
+            break;
+
+        case MidiEvent::Type::noteOff:
+            word &= ~bit;
+            state.pressure[key] = 0;
+            break;
+
+        case MidiEvent::Type::polyPressure:
+            state.pressure[key] = event.value;
+            break;
+
+        case MidiEvent::Type::channelPressure:
+            state.channelPressure[channel] = event.value;
+            break;
+    }
+}
+
+void MidiNoteState::read (Snapshot& dest) const noexcept
+{
+    for (;;)
+    {
+        const auto before = version.load (std::memory_order_acquire);
+
+        if ((before & 1) == 0)
+        {
+            dest = state;
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            if (version.load (std::memory_order_relaxed) == before)
+                return;
+        }
+
+        // The writer finishes a block in microseconds, so just try again
+        juce::Thread::yield();
+    }
+}
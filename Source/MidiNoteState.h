@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    MidiNoteState.h
+    Which notes are down on which channel, with velocity, pressure and start
+    time, kept by the audio thread and readable from any other.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiEventQueue.h"
+
+//==============================================================================
+/**
+    128 keys on each of 16 channels. Each key has a held bit in a per-channel
+    bitmap, plus velocity, polyphonic pressure and the sample time of its
+    note-on in flat arrays indexed by (channel - 1) * numNotes + note. Each
+    channel also has a channel pressure. The bitmaps make "what's held" and
+    polyphony a few popcounts, however dense the chord or MPE stream.
+
+    The audio thread is the only writer. It wraps each block's updates in
+    beginChanges()/endChanges(), which bump a version counter. read() copies
+    the whole state and retries if the version moved while it was copying, so
+    readers never lock the writer out and never see a half-applied block.
+*/
+class MidiNoteState
+{
+public:
+    static constexpr int numChannels = 16;
+    static constexpr int numNotes = 128;
+    static constexpr int numKeys = numChannels * numNotes;
+
+    struct Snapshot
+    {
+        std::array<std::array<juce::uint64, numNotes / 64>, numChannels> held {};
+        std::array<juce::uint8, numKeys> velocity {};
+        std::array<juce::uint8, numKeys> pressure {};
+        std::array<juce::int64, numKeys> onTime {};     // samples since prepareToPlay
+        std::array<juce::uint8, numChannels> channelPressure {};
+
+        static constexpr int getKey (int channel, int note) noexcept  { return (channel - 1) * numNotes + note; }
+
+        /** channel is 1..16, as in MidiEvent. */
+        bool isHeld (int channel, int note) const noexcept
+        {
+            return ((held[(size_t) (channel - 1)][(size_t) (note / 64)] >> (note % 64)) & 1) != 0;
+        }
+
+        /** Notes held on one channel, or on all of them for channel 0. */
+        int getNumHeld (int channel = 0) const noexcept;
+    };
+
+    //==============================================================================
+    /** Audio thread: releases every note and clears all pressure. */
+    void reset() noexcept;
+
+    /** Audio thread: bracket each block's apply() calls. */
+    void beginChanges() noexcept  { version.fetch_add (1, std::memory_order_relaxed); std::atomic_thread_fence (std::memory_order_release); }
+    void endChanges() noexcept    { version.fetch_add (1, std::memory_order_release); }
+
+    /** Audio thread: updates the state for one event that happened at `time`. */
+    void apply (const MidiEvent& event, juce::int64 time) noexcept;
+
+    /** Any thread: copies a consistent state into `dest`. Never blocks the writer. */
+    void read (Snapshot& dest) const noexcept;
+
+private:
+    Snapshot state;
+    std::atomic<juce::uint32> version { 0 };       // odd while the writer is mid-block
+};
@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    PerfTelemetry.cpp
+
+  ==============================================================================
+*/
+
+#include "PerfTelemetry.h"
+
+namespace {
+const double nanosPerTick = 1.0e9 / (double) juce::Time::getHighResolutionTicksPerSecond();
+
+// The geometric middle of a bucket, in microseconds
+double getBucketMicros (int bucket) noexcept
+{
+    return std::exp2 ((double) (bucket + PerfTelemetry::minBucketShift) - 0.5) * 1.0e-3;
+}
+
+double getPercentileMicros (const std::array<juce::uint32, PerfTelemetry::numBuckets>& counts,
+                            juce::uint64 total, double fraction) noexcept
+{
+    const auto target = (juce::uint64) std::ceil (fraction * (double) total);
+    juce::uint64 seen = 0;
+
+    for (int i = 0; i < PerfTelemetry::numBuckets; ++i)
+    {
+        seen += counts[(size_t) i];
+
+        if (seen >= target)
+            return getBucketMicros (i);
+    }
+
+    return getBucketMicros (PerfTelemetry::numBuckets - 1);
+}
+} // namespace
+
+//==============================================================================
+const char* PerfTelemetry::getStageName (Stage stage) noexcept
+{
+    switch (stage)
+    {
+        case Stage::processBlock:   return "processBlock";
+        case Stage::fft:            return "fft";
+        case Stage::decibels:       return "decibels";
+        case Stage::encode:         return "encode";
+        case Stage::frameLatency:   return "frameLatency";
+        case Stage::avSync:         return "avSync";
+    }
+
+    return "";
+}
+
+int PerfTelemetry::getBucket (juce::int64 nanoseconds) noexcept
+{
+    if (nanoseconds <= 0)
+        return 0;
+
+    const auto clamped = (juce::uint32) juce::jmin (nanoseconds, (juce::int64) 0xffffffff);
+    const auto bitWidth = juce::findHighestSetBit (clamped) + 1;
+    return juce::jlimit (0, numBuckets - 1, bitWidth - minBucketShift);
+}
+
+void PerfTelemetry::record (Stage stage, juce::int64 nanoseconds) noexcept
+{
+    auto& histogram = histograms[(size_t) stage];
+    histogram.buckets[(size_t) getBucket (nanoseconds)].fetch_add (1, std::memory_order_relaxed);
+    histogram.totalNanos.fetch_add ((juce::uint64) juce::jmax ((juce::int64) 0, nanoseconds), std::memory_order_relaxed);
+
+    auto previousMax = histogram.maxNanos.load (std::memory_order_relaxed);
+
+    while (nanoseconds > previousMax
+           && ! histogram.maxNanos.compare_exchange_weak (previousMax, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+void PerfTelemetry::recordBetween (Stage stage, juce::int64 startTicks, juce::int64 endTicks) noexcept
+{
+    record (stage, (juce::int64) ((double) (endTicks - startTicks) * nanosPerTick));
+}
+
+void PerfTelemetry::addProcessedAudio (int numSamples, double sampleRate) noexcept
+{
+    if (sampleRate > 0.0)
+        processedAudioNanos.fetch_add ((juce::uint64) ((double) numSamples * 1.0e9 / sampleRate), std::memory_order_relaxed);
+}
+
+//==============================================================================
+PerfTelemetry::Snapshot PerfTelemetry::takeSnapshot()
+{
+    Snapshot snapshot;
+
+    const auto ticks = now();
+    snapshot.intervalSeconds = (double) (ticks - lastSnapshotTicks) * nanosPerTick * 1.0e-9;
+    lastSnapshotTicks = ticks;
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        auto& histogram = histograms[(size_t) stage];
+        auto& stats = snapshot.stages[(size_t) stage];
+
+        std::array<juce::uint32, numBuckets> counts;
+
+        for (int i = 0; i < numBuckets; ++i)
+        {
+            counts[(size_t) i] = histogram.buckets[(size_t) i].exchange (0, std::memory_order_relaxed);
+            stats.count += counts[(size_t) i];
+        }
+
+        const auto totalNanos = histogram.totalNanos.exchange (0, std::memory_order_relaxed);
+        const auto maxNanos = histogram.maxNanos.exchange (0, std::memory_order_relaxed);
+
+        if (stats.count == 0)
+            continue;
+
+        stats.meanMicros = (double) totalNanos * 1.0e-3 / (double) stats.count;
+        stats.p50Micros = getPercentileMicros (counts, stats.count, 0.5);
+        stats.p99Micros = getPercentileMicros (counts, stats.count, 0.99);
+        stats.maxMicros = (double) maxNanos * 1.0e-3;
+    }
+
+    const auto processNanos = snapshot[Stage::processBlock].meanMicros * 1.0e3 * (double) snapshot[Stage::processBlock].count;
+    const auto audioNanos = processedAudioNanos.exchange (0, std::memory_order_relaxed);
+    snapshot.dspLoad = audioNanos > 0 ? processNanos / (double) audioNanos : 0.0;
+
+    return snapshot;
+}
+
+juce::var PerfTelemetry::Snapshot::toVar() const
+{
+    auto* stageObject = new juce::DynamicObject();
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        const auto& stats = stages[(size_t) stage];
+
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty ("count", (juce::int64) stats.count);
+        entry->setProperty ("mean", stats.meanMicros);
+        entry->setProperty ("p50", stats.p50Micros);
+        entry->setProperty ("p99", stats.p99Micros);
+        entry->setProperty ("max", stats.maxMicros);
+        stageObject->setProperty (getStageName ((Stage) stage), juce::var (entry));
+    }
+
+    auto* object = new juce::DynamicObject();
+    object->setProperty ("interval", intervalSeconds);
+    object->setProperty ("dspLoad", dspLoad);
+    object->setProperty ("stages", juce::var (stageObject));
+    return juce::var (object);
+}
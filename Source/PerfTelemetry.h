@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    PerfTelemetry.h
+    Per-stage timing histograms for the hot paths, read by the editor's
+    performance overlay.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Each stage (processBlock, the FFT, the dB conversion, encoding a frame for
+    the WebView, a frame's age when it's sent, and how far behind its audio it
+    is shown) keeps a histogram of how long it took, in power-of-two nanosecond
+    buckets. Recording a sample is a couple of relaxed atomic increments, so the
+    audio thread, the analysis worker and the message thread can all record
+    without locks or allocations.
+
+    The editor calls takeSnapshot() a few times a second on the message thread.
+    That drains the counters, so every snapshot covers just the interval since
+    the previous one, and turns them into percentiles and a DSP load figure.
+    Percentiles are only as fine as the buckets: each is reported as the
+    geometric middle of the bucket it falls in, so within a factor of 1.4.
+*/
+class PerfTelemetry
+{
+public:
+    enum class Stage
+    {
+        processBlock,       // the whole callback
+        fft,                // windowing plus the transform, per stream
+        decibels,           // band reduction, the dB kernel, audio features and ballistics, per stream
+        encode,             // SpectrumFrameEncoder, on the message thread
+        frameLatency,       // analysis of a frame to the editor sending it
+        avSync              // a frame's audio being heard to the frame being shown, as scheduled
+    };
+
+    static constexpr int numStages = 6;
+
+    /** The names stages go by in the perfstats event, in Stage order. */
+    static const char* getStageName (Stage stage) noexcept;
+
+    // Bucket i holds times in [2^(i + minBucketShift - 1), 2^(i + minBucketShift)) ns;
+    // the first also takes anything shorter and the last anything longer.
+    static constexpr int minBucketShift = 6;        // up to 64 ns
+    static constexpr int numBuckets = 22;           // last bucket from 67 ms up
+
+    //==============================================================================
+    /** A timestamp for recordBetween() and recordSince(), in juce::Time high resolution ticks. */
+    static juce::int64 now() noexcept  { return juce::Time::getHighResolutionTicks(); }
+
+    /** Records one sample. Any thread. */
+    void record (Stage stage, juce::int64 nanoseconds) noexcept;
+
+    /** Records the time between two now() timestamps. Any thread. */
+    void recordBetween (Stage stage, juce::int64 startTicks, juce::int64 endTicks) noexcept;
+
+    /** Records the time since `startTicks`, from now(). Any thread. */
+    void recordSince (Stage stage, juce::int64 startTicks) noexcept  { recordBetween (stage, startTicks, now()); }
+
+    /** Audio thread: counts the audio processBlock was asked for, so the
+        snapshot can relate processBlock time to the time available for it.
+    */
+    void addProcessedAudio (int numSamples, double sampleRate) noexcept;
+
+    //==============================================================================
+    struct StageStats
+    {
+        juce::uint64 count = 0;
+        double meanMicros = 0.0, p50Micros = 0.0, p99Micros = 0.0, maxMicros = 0.0;
+    };
+
+    struct Snapshot
+    {
+        std::array<StageStats, numStages> stages;
+        double intervalSeconds = 0.0;   // wall time the snapshot covers
+        double dspLoad = 0.0;           // processBlock time over the audio it processed, 1 = all of it
+
+        const StageStats& operator[] (Stage stage) const noexcept  { return stages[(size_t) stage]; }
+
+        /** { interval, dspLoad, stages: { <name>: { count, mean, p50, p99, max } } }, times in microseconds. */
+        juce::var toVar() const;
+    };
+
+    /** Message thread: what was recorded since the previous call, then starts afresh.
+        Samples recorded while this runs land in this snapshot or the next one.
+    */
+    Snapshot takeSnapshot();
+
+private:
+    struct Histogram
+    {
+        std::array<std::atomic<juce::uint32>, numBuckets> buckets {};
+        std::atomic<juce::uint64> totalNanos { 0 };
+        std::atomic<juce::int64> maxNanos { 0 };
+    };
+
+    static int getBucket (juce::int64 nanoseconds) noexcept;
+
+    std::array<Histogram, numStages> histograms;
+    std::atomic<juce::uint64> processedAudioNanos { 0 };
+    juce::int64 lastSnapshotTicks = now();
+};
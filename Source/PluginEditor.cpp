@@ -9,40 +9,154 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#if JucePlugin_Build_Standalone
+ #include <juce_audio_plugin_client/Standalone/juce_StandaloneFilterWindow.h>
+#endif
+
 namespace {
-const char* getMimeForExtension (const String& extension)
+BandMap::Layout bandLayoutFromVar (const var& scale, const var& numBands)
 {
-    static const std::unordered_map<String, const char*> mimeMap =
-    {
-        { { "htm"   },  "text/html"                },
-        { { "html"  },  "text/html"                },
-        { { "txt"   },  "text/plain"               },
-        { { "jpg"   },  "image/jpeg"               },
-        { { "jpeg"  },  "image/jpeg"               },
-        { { "svg"   },  "image/svg+xml"            },
-        { { "ico"   },  "image/vnd.microsoft.icon" },
-        { { "json"  },  "application/json"         },
-        { { "png"   },  "image/png"                },
-        { { "css"   },  "text/css"                 },
-        { { "map"   },  "application/json"         },
-        { { "js"    },  "text/javascript"          },
-        { { "woff2" },  "font/woff2"               }
-    };
+    BandMap::Layout layout;
+    layout.scale = BandMap::scaleFromName (scale.toString());
+    layout.numBands = (int) numBands;
+    return layout;
+}
+
+// Either a profile name from SpectrumBallistics::getProfileNames(), or an object with any of
+// { profile, attackMs, releaseMs, averageFrames, peaks, peakHoldMs, peakDecayDbPerSecond }
+// overriding that profile's values
+SpectrumBallistics::Settings ballisticsFromVar (const var& value)
+{
+    const auto profileName = value.isString() ? value.toString() : value.getProperty("profile", "off").toString();
+    auto settings = SpectrumBallistics::getProfileSettings(SpectrumBallistics::profileFromName(profileName));
+
+    if (value.isObject()) {
+        settings.attackMs = (float) value.getProperty("attackMs", settings.attackMs);
+        settings.releaseMs = (float) value.getProperty("releaseMs", settings.releaseMs);
+        settings.averageFrames = (int) value.getProperty("averageFrames", settings.averageFrames);
+        settings.peaks = (bool) value.getProperty("peaks", settings.peaks);
+        settings.peakHoldMs = (float) value.getProperty("peakHoldMs", settings.peakHoldMs);
+        settings.peakDecayDbPerSecond = (float) value.getProperty("peakDecayDbPerSecond", settings.peakDecayDbPerSecond);
+    }
+
+    return settings;
+}
+
+// { notes: [{ channel, note, velocity, pressure, time }], channelPressure: [16 values] }
+juce::var noteStateToVar (const MidiNoteState::Snapshot& state)
+{
+    juce::Array<juce::var> notes, channelPressure;
+
+    for (int channel = 1; channel <= MidiNoteState::numChannels; ++channel) {
+        channelPressure.add((int) state.channelPressure[(size_t) (channel - 1)]);
+
+        for (int note = 0; note < MidiNoteState::numNotes; ++note) {
+            if (! state.isHeld(channel, note))
+                continue;
+
+            const auto key = (size_t) MidiNoteState::Snapshot::getKey(channel, note);
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty("channel", channel);
+            entry->setProperty("note", note);
+            entry->setProperty("velocity", (int) state.velocity[key]);
+            entry->setProperty("pressure", (int) state.pressure[key]);
+            entry->setProperty("time", state.onTime[key]);
+            notes.add(juce::var(entry));
+        }
+    }
+
+    auto* result = new juce::DynamicObject();
+    result->setProperty("notes", notes);
+    result->setProperty("channelPressure", channelPressure);
+    return juce::var(result);
+}
+
+// { sampleRate, blockSize, position, heardPosition, hostPosition, ppqPosition, bpm, isPlaying,
+//   outputLatencyMs, deviceLatencyMs, userLatencyMs, presentAheadMs, syncErrorMs, endToEndLatencyMs }
+juce::var syncInfoToVar (const AudioClock& clock, const FramePacer& pacer)
+{
+    const auto anchor = clock.read();
+    const auto heard = anchor.isRunning() ? clock.getHeardPosition(anchor, juce::Time::getHighResolutionTicks()) : 0.0;
+    const auto outputLatencyMs = clock.getOutputLatency(anchor) * 1000.0;
+    const auto syncErrorMs = pacer.getLastSyncError() * 1000.0;
+
+    auto* result = new juce::DynamicObject();
+    result->setProperty("sampleRate", anchor.sampleRate);
+    result->setProperty("blockSize", anchor.numSamples);
+    result->setProperty("position", anchor.position);
+    result->setProperty("heardPosition", heard);
+    result->setProperty("hostPosition", anchor.hostPosition < 0 ? -1.0 : (double) anchor.toHostPosition((juce::int64) heard));
+    result->setProperty("ppqPosition", anchor.ppqPosition);
+    result->setProperty("bpm", anchor.bpm);
+    result->setProperty("isPlaying", anchor.isPlaying);
+    result->setProperty("outputLatencyMs", outputLatencyMs);
+    result->setProperty("deviceLatencyMs", clock.getDeviceLatency() * 1000.0);
+    result->setProperty("userLatencyMs", clock.getUserLatency() * 1000.0);
+    result->setProperty("presentAheadMs", pacer.getLastPresentAhead() * 1000.0);
+    result->setProperty("syncErrorMs", syncErrorMs);
+
+    // From a block being processed to its frame reaching the screen
+    result->setProperty("endToEndLatencyMs", outputLatencyMs + syncErrorMs);
+    return juce::var(result);
+}
+
+// A path from the frontend, or a new file named after the time in Documents/Viber/Captures
+// when it is empty or relative
+juce::File captureFileFromVar (const var& path)
+{
+    const auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("Viber/Captures");
+    const auto name = path.toString();
 
-    if (const auto it = mimeMap.find (extension.toLowerCase()); it != mimeMap.end())
-        return it->second;
+    if (name.isEmpty())
+        return folder.getNonexistentChildFile(juce::Time::getCurrentTime().formatted("Viber %Y-%m-%d %H-%M-%S"), ".vcap");
 
-    jassertfalse;
-    return "";
+    return juce::File::isAbsolutePath(name) ? juce::File(name) : folder.getChildFile(name);
 }
 
-auto streamToVector (InputStream& stream)
+// { recording, file, seconds, bytes, frames, midiEvents, dropped, error }
+juce::var captureStatsToVar (const AnalysisCapture::Stats& stats)
 {
-    std::vector<std::byte> result ((size_t) stream.getTotalLength());
-    stream.setPosition (0);
-    [[maybe_unused]] const auto bytesRead = stream.read (result.data(), result.size());
-    jassert (bytesRead == (ssize_t) result.size());
-    return result;
+    auto* result = new juce::DynamicObject();
+    result->setProperty("recording", stats.isRecording);
+    result->setProperty("file", stats.file.getFullPathName());
+    result->setProperty("seconds", stats.seconds);
+    result->setProperty("bytes", stats.bytesWritten);
+    result->setProperty("frames", (juce::int64) stats.numFrames);
+    result->setProperty("midiEvents", (juce::int64) stats.numMidiEvents);
+    result->setProperty("dropped", (juce::int64) stats.droppedRecords);
+    result->setProperty("error", stats.error);
+    return juce::var(result);
+}
+
+// { file, position, duration, playing, speed, frames, midiEvents, startTime }, or null with no replay
+juce::var replayStateToVar (const CaptureReplay* replay)
+{
+    if (replay == nullptr)
+        return {};
+
+    const auto& file = replay->getFile();
+    auto* result = new juce::DynamicObject();
+    result->setProperty("file", file.getFile().getFullPathName());
+    result->setProperty("position", replay->getPosition());
+    result->setProperty("duration", file.getDuration());
+    result->setProperty("playing", replay->isPlaying());
+    result->setProperty("speed", replay->getSpeed());
+    result->setProperty("frames", file.getNumFrames());
+    result->setProperty("midiEvents", file.getNumMidiEvents());
+    result->setProperty("startTime", file.getStartTime().toISO8601(true));
+    return juce::var(result);
+}
+
+juce::uint32 streamMaskFromVar (const var& names)
+{
+    juce::uint32 mask = 0;
+
+    if (const auto* array = names.getArray())
+        for (const auto& name : *array)
+            if (const auto index = spectrumStreamFromName (name.toString()); index >= 0)
+                mask |= SpectrumAnalyser::streamBit ((SpectrumStream) index);
+
+    return mask;
 }
 } // namespace
 
@@ -55,14 +169,169 @@ ViberAudioProcessorEditor::ViberAudioProcessorEditor (ViberAudioProcessor& p)
                 const auto h = (double) params[1];
                 setSize((int) w, (int) h);
             })
+            .withNativeFunction("setBandLayout", [this] (auto& params, auto complete) {
+                // setBandLayout(scale, numBands): scale is "linear", "log", "mel" or "thirdoctave",
+                // "linear" with 0 bands sends the raw FFT bins
+                audioProcessor.setBandLayout(bandLayoutFromVar(params[0], params[1]));
+                complete(juce::var());
+            })
+            .withNativeFunction("subscribeStreams", [this] (auto& params, auto complete) {
+                // subscribeStreams(["mix", "left", ...]): only these spectra are computed and sent
+                audioProcessor.setSubscribedStreams(streamMaskFromVar(params[0]));
+                complete(juce::var());
+            })
+            .withNativeFunction("setBallistics", [this] (auto& params, auto complete) {
+                // setBallistics(profile or settings): see ballisticsFromVar
+                audioProcessor.setBallistics(ballisticsFromVar(params[0]));
+                complete(juce::var());
+            })
+            .withNativeFunction("pullFrames", [this] (auto& params, auto complete) {
+                // pullFrames(presentAheadMs): for every stream that changed, the newest frame whose
+                // audio will be heard presentAheadMs from now, when the frontend expects to show it,
+                // as an array of base64 strings; see SpectrumFrameEncoder for the layout
+                // While a capture is replayed its frames stand in for the live ones
+                if (replay != nullptr) {
+                    complete(replay->pullFrames());
+                    return;
+                }
+
+                const auto presentAhead = params.size() > 0 ? juce::jlimit(0.0, 1.0, (double) params[0] / 1000.0) : 0.0;
+                complete(framePacer.pull(audioProcessor.getSpectrumFrames(), audioProcessor.getTelemetry(),
+                                         &audioProcessor.getClock(), presentAhead));
+            })
+            .withNativeFunction("getSyncInfo", [this] (auto&, auto complete) {
+                // getSyncInfo(): where playback is and the latencies frames are scheduled against
+                // (see syncInfoToVar)
+                complete(syncInfoToVar(audioProcessor.getClock(), framePacer));
+            })
+            .withNativeFunction("setOutputLatency", [this] (auto& params, auto complete) {
+                // setOutputLatency(ms): extra output latency the plugin can't see, such as a
+                // Bluetooth headset, added to whatever the device reports
+                audioProcessor.getClock().setUserLatency((double) params[0] / 1000.0);
+                complete(juce::var());
+            })
+            .withNativeFunction("getSpectrogramRows", [this] (auto& params, auto complete) {
+                // getSpectrogramRows(since): { first, numRows, data } with every history row from
+                // index `since` on (or the oldest held); data is base64, see SpectrogramHistory
+                juce::MemoryBlock rows;
+                int numRows = 0;
+                const auto since = params.size() > 0 ? (juce::int64) params[0] : (juce::int64) 0;
+                const auto first = audioProcessor.getSpectrogramHistory().read((juce::uint64) juce::jmax((juce::int64) 0, since),
+                                                                              rows, numRows);
+
+                auto* result = new juce::DynamicObject();
+                result->setProperty("first", (juce::int64) first);
+                result->setProperty("numRows", numRows);
+                result->setProperty("data", juce::Base64::toBase64(rows.getData(), rows.getSize()));
+                complete(juce::var(result));
+            })
+            .withNativeFunction("setSpectrogramStream", [this] (auto& params, auto complete) {
+                // setSpectrogramStream(name): which stream the waterfall history records
+                if (const auto index = spectrumStreamFromName(params[0].toString()); index >= 0)
+                    audioProcessor.setSpectrogramStream((SpectrumStream) index);
+                complete(juce::var());
+            })
+            .withNativeFunction("setFeatureStream", [this] (auto& params, auto complete) {
+                // setFeatureStream(name or null): which stream's frames carry audio features;
+                // null, or a name that isn't a stream, turns them off
+                audioProcessor.setFeatureStream(params[0].isString() ? spectrumStreamFromName(params[0].toString()) : -1);
+                complete(juce::var());
+            })
+            .withNativeFunction("setVisualiser", [this] (auto& params, auto complete) {
+                // setVisualiser(name): the sketch on show, saved with the session
+                audioProcessor.setVisualiser(params[0].toString());
+                complete(juce::var());
+            })
+            .withNativeFunction("getVisualiser", [this] (auto&, auto complete) {
+                // getVisualiser(): the sketch saved with the session, or "" for the default
+                complete(audioProcessor.getVisualiser());
+            })
+            .withNativeFunction("setSaveSpectrogram", [this] (auto& params, auto complete) {
+                // setSaveSpectrogram(enabled): also save the spectrogram history with the session
+                audioProcessor.setSaveSpectrogram((bool) params[0]);
+                complete(juce::var());
+            })
+            .withNativeFunction("getNoteState", [this] (auto&, auto complete) {
+                // getNoteState(): every held note, for a frontend that starts mid-performance
+                // (see noteStateToVar); afterwards the midievents deltas keep it current
+                MidiNoteState::Snapshot state;
+                audioProcessor.getNoteState().read(state);
+                complete(noteStateToVar(state));
+            })
+            .withNativeFunction("startCapture", [this] (auto& params, auto complete) {
+                // startCapture(path): records every frame and MIDI event from now on to `path`,
+                // or to a new file in Documents/Viber/Captures; resolves to getCaptureInfo()
+                const auto result = audioProcessor.startCapture(captureFileFromVar(params.size() > 0 ? params[0] : juce::var()));
+                auto info = captureStatsToVar(audioProcessor.getCaptureStats());
+
+                if (result.failed())
+                    info.getDynamicObject()->setProperty("error", result.getErrorMessage());
+
+                complete(info);
+            })
+            .withNativeFunction("stopCapture", [this] (auto&, auto complete) {
+                // stopCapture(): finishes the file; resolves to getCaptureInfo()
+                audioProcessor.stopCapture();
+                complete(captureStatsToVar(audioProcessor.getCaptureStats()));
+            })
+            .withNativeFunction("getCaptureInfo", [this] (auto&, auto complete) {
+                // getCaptureInfo(): the current or last capture (see captureStatsToVar)
+                complete(captureStatsToVar(audioProcessor.getCaptureStats()));
+            })
+            .withNativeFunction("openReplay", [this] (auto& params, auto complete) {
+                // openReplay(path): replays a capture in place of the live frames and MIDI, paused
+                // at its start; resolves to its state (see replayStateToVar) or { error }
+                auto file = std::make_unique<CaptureFile>();
+
+                if (const auto result = file->open(captureFileFromVar(params[0])); result.failed()) {
+                    auto* error = new juce::DynamicObject();
+                    error->setProperty("error", result.getErrorMessage());
+                    complete(juce::var(error));
+                    return;
+                }
+
+                replay = std::make_unique<CaptureReplay>(std::move(file));
+                complete(replayStateToVar(replay.get()));
+            })
+            .withNativeFunction("setReplay", [this] (auto& params, auto complete) {
+                // setReplay({ playing, speed, position }): any of them, position in seconds;
+                // resolves to the replay's state, or null if none is open
+                if (replay != nullptr && params.size() > 0) {
+                    const auto& options = params[0];
+
+                    if (options.hasProperty("position"))
+                        replay->seek((double) options["position"]);
+
+                    if (options.hasProperty("speed"))
+                        replay->setSpeed((double) options["speed"]);
+
+                    if (options.hasProperty("playing"))
+                        replay->setPlaying((bool) options["playing"]);
+                }
+
+                complete(replayStateToVar(replay.get()));
+            })
+            .withNativeFunction("closeReplay", [this] (auto&, auto complete) {
+                // closeReplay(): back to the live frames and MIDI
+                replay.reset();
+                complete(juce::var());
+            })
+            .withNativeFunction("getRealtimeReport", [] (auto& params, auto complete) {
+                // getRealtimeReport(): allocations, frees and locks seen on the audio thread,
+                // with call sites, in Debug builds (see RealtimeSafety.h)
+                complete(RealtimeSafety::getReport());
+            })
             .withResourceProvider([this](const auto& url) {
-                return getResource(url);
+                return frontendResources.get(url);
             })
             .withNativeIntegrationEnabled()
     }
 {
     setSize (700, 200);
     setResizable(true, false);
+
+    // Notes played while the editor was closed are stale, don't replay them on open
+    while (audioProcessor.midiEvents.pop([](const MidiEventBatch&) {})) {}
     
     // Add the webview
     // webView.goToURL("https://editor.p5js.org/benman604/full/lL8UyeZrz");
@@ -87,7 +356,9 @@ ViberAudioProcessorEditor::ViberAudioProcessorEditor (ViberAudioProcessor& p)
         webView.emitEventIfBrowserIsVisible(EVENT_ID, "hai");
     };
 
-    startTimerHz(30); // Update 30 times per second (adjust as needed)
+    // Frames are pulled by the frontend; this only drives MIDI, perfstats and coalescing
+    updateDeviceLatency();
+    startTimerHz(30);
 }
 
 ViberAudioProcessorEditor::~ViberAudioProcessorEditor()
@@ -104,40 +375,130 @@ void ViberAudioProcessorEditor::paint (juce::Graphics& g)
 void ViberAudioProcessorEditor::timerCallback() {
     // This method is called periodically by the timer.
     // Check if the last MIDI note has changed and update the label.
-    if (audioProcessor.lastMidiNoteNumber != -1) {
-        midiNoteDisplayLabel.setText (audioProcessor.lastMidiNoteName, juce::dontSendNotification);
+    if (audioProcessor.lastMidiNoteNumber.load() != -1) {
+        midiNoteDisplayLabel.setText (audioProcessor.getLastMidiNoteName(), juce::dontSendNotification);
     } else {
         midiNoteDisplayLabel.setText ("No MIDI Input !!!! lol change works", juce::dontSendNotification);
     }
-    
-    auto* proc = dynamic_cast<ViberAudioProcessor*>(&processor);
-    
-    if (proc != nullptr && proc->fftReady.load()) {
-        proc->fftReady.store(false);
-        juce::String data;
-        for (float mag : proc->fftDisplay) {
-            data += juce::String(mag) + ",";
-        }
 
-        if (data.endsWith(",")) {
-            data = data.dropLastCharacters(1);
-        }
+    sendMidiEvents();
+    
+    // Keep only the newest frame per stream until the frontend's next pullFrames, so the
+    // processor's queue doesn't fill up while the WebView is hidden or between animation frames
+    framePacer.collect(audioProcessor.getSpectrumFrames());
 
-        webView.emitEventIfBrowserIsVisible(broadcast_fft_data, data);
+    if (--ticksUntilPerfStats <= 0) {
+        ticksUntilPerfStats = perfStatsInterval;
+        sendPerfStats();
+        updateDeviceLatency();
     }
-    
-    repaint();
 }
 
-void ViberAudioProcessorEditor::sendNoteChangeEvent(const juce::String& noteName)
+void ViberAudioProcessorEditor::updateDeviceLatency()
+{
+    // Only the standalone app owns its audio device; inside a host the device's latency is
+    // hidden from plugins and the frontend's setOutputLatency() has to stand in for it
+   #if JucePlugin_Build_Standalone
+    if (auto* holder = juce::StandalonePluginHolder::getInstance())
+        if (auto* device = holder->deviceManager.getCurrentAudioDevice())
+            if (const auto sampleRate = device->getCurrentSampleRate(); sampleRate > 0.0)
+                audioProcessor.getClock().setDeviceLatency(device->getOutputLatencyInSamples() / sampleRate);
+   #endif
+}
+
+void ViberAudioProcessorEditor::sendMidiEvents()
 {
-    // Emit a custom event to the webview
-    webView.emitEventIfBrowserIsVisible(broadcast_note_change_event, noteName);
+    // Drain every batch the audio thread queued since the last tick and send them as one
+    // base64 string, decoded by decodeMidiEvents() in viber.js. Little endian throughout:
+    //
+    //   0  'V' 'M'   magic
+    //   2  uint8     version (midiPayloadVersion)
+    //   3  uint8     reserved
+    //   4  uint32    number of events
+    //   8  float64   base time, in samples since prepareToPlay
+    //   16 float64   sample rate
+    //   24 float64   position being heard as this is sent, on the same clock as the base time
+    //   32 float64   base time on the host's timeline, or -1 if the host didn't say
+    //   40 events... 8 bytes each: uint8 type (MidiEvent::Type), uint8 channel (1..16),
+    //                uint8 note, uint8 velocity or pressure, uint32 samples after the base time
+    //
+    // Events are sent as soon as they are played, which is ahead of the audio by the output
+    // latency; the heard position lets the frontend hold each one until it is heard.
+    // A replayed capture sends its events as they fall due instead, so they are heard already.
+    constexpr size_t headerSize = 40;
+
+    juce::MemoryOutputStream out(midiPayload, false);
+    out.writeRepeatedByte(0, headerSize);   // filled in once the events are counted
+
+    juce::uint32 numEvents = 0;
+    juce::int64 baseTime = -1;
+
+    const auto addEvent = [&](const MidiEvent& event, juce::int64 batchTime) {
+        if (baseTime < 0)
+            baseTime = batchTime;
+
+        out.writeByte((char) event.type);
+        out.writeByte((char) event.channel);
+        out.writeByte((char) event.note);
+        out.writeByte((char) event.value);
+        out.writeInt((int) (juce::uint32) (batchTime + event.sampleOffset - baseTime));
+        ++numEvents;
+    };
+
+    // Live events are drained even while replaying, so they don't turn up stale afterwards
+    while (audioProcessor.midiEvents.pop([&](const MidiEventBatch& batch) {
+        for (int i = 0; replay == nullptr && i < batch.numEvents; ++i)
+            addEvent(batch.events[(size_t) i], batch.time);
+    })) {}
+
+    auto sampleRate = audioProcessor.getSampleRate();
+    double heardPosition = 0.0;
+    juce::int64 hostBaseTime = -1;
+
+    if (replay != nullptr) {
+        replay->takeMidi([&](const CaptureFile::Record& record) {
+            if (baseTime < 0) {
+                sampleRate = record.sampleRate;
+                heardPosition = (double) record.position + (replay->getPosition() - record.time) * sampleRate;
+            }
+
+            for (int i = 0; i < CaptureFile::getNumMidiEvents(record); ++i)
+                addEvent(CaptureFile::getMidiEvent(record, i), record.position);
+        });
+    }
+
+    if (numEvents == 0)
+        return;
+
+    if (replay == nullptr) {
+        const auto& clock = audioProcessor.getClock();
+        const auto anchor = clock.read();
+        heardPosition = anchor.isRunning() ? clock.getHeardPosition(anchor, juce::Time::getHighResolutionTicks())
+                                           : (double) baseTime;
+        hostBaseTime = anchor.toHostPosition(baseTime);
+    }
+
+    out.setPosition(0);
+    out.writeByte('V');
+    out.writeByte('M');
+    out.writeByte((char) midiPayloadVersion);
+    out.writeByte(0);
+    out.writeInt((int) numEvents);
+    out.writeDouble((double) baseTime);
+    out.writeDouble(sampleRate);
+    out.writeDouble(heardPosition);
+    out.writeDouble((double) hostBaseTime);
+
+    webView.emitEventIfBrowserIsVisible(broadcast_midi_events, juce::Base64::toBase64(out.getData(), out.getDataSize()));
 }
 
-void ViberAudioProcessorEditor::sendNoteOffEvent(const juce::String& noteName)
+void ViberAudioProcessorEditor::sendPerfStats()
 {
-    webView.emitEventIfBrowserIsVisible(broadcast_note_off_event, noteName);
+    // { instance, interval, dspLoad, stages: { processBlock, fft, decibels, encode, frameLatency, avSync } },
+    // each stage { count, mean, p50, p99, max } in microseconds over the last interval
+    auto stats = audioProcessor.getTelemetry().takeSnapshot().toVar();
+    stats.getDynamicObject()->setProperty("instance", audioProcessor.getInstanceId());
+    webView.emitEventIfBrowserIsVisible(broadcast_perf_stats, stats);
 }
 
 void ViberAudioProcessorEditor::resized()
@@ -147,17 +508,3 @@ void ViberAudioProcessorEditor::resized()
 //    midiNoteDisplayLabel.setBounds(bounds.removeFromTop(50).reduced(5));
 //    runJsBtn.setBounds(bounds.removeFromTop(50).reduced(5));
 }
-
-auto ViberAudioProcessorEditor::getResource(const juce::String& url) -> std::optional<Resource> {
-    static const auto resourceFileRoot = juce::File("/Users/benjaminman/Desktop/dev/juce/Viber/Frontend/public");
-
-    const auto resourceToRetrieve = url == "/" ? "index.html" : url.fromFirstOccurrenceOf("/", false, false);
-    const auto resoruce = resourceFileRoot.getChildFile(resourceToRetrieve).createInputStream();
-
-    if (resoruce) {
-        const auto extension = resourceToRetrieve.fromLastOccurrenceOf(".", false, false);
-        return Resource{streamToVector(*resoruce), getMimeForExtension(extension)};
-    }
-
-    return std::nullopt;
-}
@@ -11,6 +11,9 @@
 #include <JuceHeader.h>
 #include <juce_gui_extra/juce_gui_extra.h>
 #include "PluginProcessor.h"
+#include "FramePacer.h"
+#include "CaptureFile.h"
+#include "FrontendResources.h"
 
 using namespace juce;
 
@@ -32,8 +35,9 @@ public:
     
     void timerCallback() override;
 
-    void sendNoteChangeEvent(const juce::String& noteName);
-    void sendNoteOffEvent(const juce::String& noteName);
+    void sendMidiEvents();
+    void sendPerfStats();
+    void updateDeviceLatency();
 
 private:
     // This reference is provided as a quick way for your editor to
@@ -42,15 +46,27 @@ private:
     
     juce::Label midiNoteDisplayLabel;
     juce::TextButton runJsBtn{"Run JS"};
-    
+
+    // Declared before webView, whose resource provider uses it
+    FrontendResources frontendResources;
     juce::WebBrowserComponent webView;
 
-    using Resource = juce::WebBrowserComponent::Resource;
-    std::optional<Resource> getResource(const juce::String& url);
+    // Holds frames until the frontend pulls them on requestAnimationFrame and their audio is heard
+    FramePacer framePacer;
+
+    // A capture being replayed in place of the live frames and MIDI, or nullptr
+    std::unique_ptr<CaptureReplay> replay;
+
+    // One tick's MIDI batches, encoded for the midievents event (layout in sendMidiEvents)
+    juce::MemoryBlock midiPayload;
+    static constexpr juce::uint8 midiPayloadVersion = 2;
+
+    const juce::Identifier broadcast_midi_events{"midievents"};
+    const juce::Identifier broadcast_perf_stats{"perfstats"};
 
-    const juce::Identifier broadcast_note_change_event{"notechange"};
-    const juce::Identifier broadcast_note_off_event{"noteoff"};
-    const juce::Identifier broadcast_fft_data{"fftframe"};
+    // Timer ticks between perfstats events, about twice a second at 30 Hz
+    static constexpr int perfStatsInterval = 15;
+    int ticksUntilPerfStats = perfStatsInterval;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ViberAudioProcessorEditor)
 };
@@ -7,36 +7,49 @@
 */
 
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! VIBER_HEADLESS
+ #include "PluginEditor.h"
+#endif
+
+namespace {
+std::atomic<int> nextInstanceId { 1 };
+} // namespace
 
 //==============================================================================
 ViberAudioProcessor::ViberAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
      : AudioProcessor (BusesProperties()
                        .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                       // Always expose a sidechain input so synth builds can receive audio
+                       .withInput("Sidechain", juce::AudioChannelSet::stereo(), true)
                        .withOutput("Output", juce::AudioChannelSet::stereo(), true)
-//                     #if ! JucePlugin_IsMidiEffect
-//                                            #if ! JucePlugin_IsSynth
-//                                             .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-//                                            #endif
-//                                             // Always expose a sidechain input so synth builds can receive audio
-//                                             .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), true)
-//                                             .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-//                     #endif
                        ),
     parameters (*this, nullptr, "PARAMS", createParameterLayout())
 #endif
 {
-    fftInput.resize(fftSize * 2, 0.0f);
-    fftMagnitudes.resize(fftSize / 2, 0.0f);
-    fftDisplay.resize(fftSize / 2, 0.0f);
-    fft = juce::dsp::FFT(fftOrder);
+    instanceId = nextInstanceId.fetch_add(1);
+
+    // Reasonable default until the host tells us its block size in prepareToPlay
+    analysisBuffer.setSize(SpectrumAnalyser::numStreams, 512);
+
+    midiEvents.prepare(midiQueueCapacity, [](MidiEventBatch&) {});
     
     gainParam = parameters.getRawParameterValue("gain");
+    floorDbParam = parameters.getRawParameterValue("floorDb");
+    ceilingDbParam = parameters.getRawParameterValue("ceilingDb");
+    analysisModeParam = parameters.getRawParameterValue("analysisMode");
+    fftOrderParam = parameters.getRawParameterValue("fftOrder");
+    overlapParam = parameters.getRawParameterValue("overlap");
+    windowTypeParam = parameters.getRawParameterValue("windowType");
+
+    analyser.setTelemetry(&telemetry);
+    analyser.setCapture(&capture);
+    analysisWorker->addAnalyser(analyser);
 }
 
 ViberAudioProcessor::~ViberAudioProcessor()
 {
+    analysisWorker->removeAnalyser(analyser);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout
@@ -44,9 +57,49 @@ ViberAudioProcessor::createParameterLayout()
 {
     std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
 
+    // Linear gain on the main input, ahead of the output, the meters and the analysis.
+    // Unity by default, so inserting the plugin leaves the level alone.
     params.push_back (std::make_unique<juce::AudioParameterFloat>(
         "gain", "Gain",
-        0.0f, 1.0f, 0.5f
+        0.0f, 1.0f, 1.0f
+    ));
+
+    // dB range the spectrum display maps onto 0..1
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "floorDb", "Display Floor",
+        juce::NormalisableRange<float> (-140.0f, -20.0f, 1.0f), SpectrumKernels::defaultFloorDb
+    ));
+
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "ceilingDb", "Display Ceiling",
+        juce::NormalisableRange<float> (-60.0f, 24.0f, 1.0f), SpectrumKernels::defaultCeilingDb
+    ));
+
+    // Where the FFT runs: inline in processBlock, or on the shared low-priority worker thread
+    // so the audio thread only copies samples
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "analysisMode", "Analysis Mode",
+        juce::StringArray { "Inline", "Worker" }, 1
+    ));
+
+    // STFT shape: bigger FFTs resolve more frequency detail, more overlap gives more
+    // frames per second. Both are applied without reallocating on the audio thread.
+    params.push_back (std::make_unique<juce::AudioParameterInt>(
+        "fftOrder", "FFT Order",
+        SpectrumAnalyser::minFftOrder, SpectrumAnalyser::maxFftOrder, SpectrumAnalyser::defaultFftOrder,
+        juce::AudioParameterIntAttributes().withStringFromValueFunction ([] (int order, int) {
+            return juce::String (1 << order);
+        })
+    ));
+
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "overlap", "Overlap",
+        juce::StringArray { "0%", "50%", "75%", "87.5%" }, 0
+    ));
+
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "windowType", "Window",
+        juce::StringArray { "Hann", "Hamming", "Blackman", "Blackman-Harris", "Flat Top", "Rectangular" }, 0
     ));
 
     return { params.begin(), params.end() };
@@ -119,6 +172,21 @@ void ViberAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    analysisBuffer.setSize(SpectrumAnalyser::numStreams, juce::jmax(1, samplesPerBlock), false, false, true);
+    analyser.setConfig(getAnalysisConfig());
+    analyser.setUseWorkerThread(shouldUseWorkerThread());
+    analyser.prepare(juce::jmax(1, samplesPerBlock), sampleRate);
+    gainStage.prepare(sampleRate, juce::jmax(1, samplesPerBlock), gainParam->load());
+
+    // Band edges are in Hz, so the bin weights depend on the sample rate
+    currentSampleRate = sampleRate;
+    setBandLayout(bandLayout);
+
+    // Restart the MIDI clock; notes held across a re-prepare won't get their note-off
+    processedSamples.store(0, std::memory_order_relaxed);
+    clock.reset(sampleRate);
+    noteState.reset();
+    capture.restartClock(sampleRate);
 }
 
 void ViberAudioProcessor::releaseResources()
@@ -152,6 +220,13 @@ bool ViberAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
                 return false;
      #endif
 
+    // The sidechain is optional, and only ever analysed
+    const auto sidechain = layouts.getChannelSet(true, 1);
+    if (! sidechain.isDisabled()
+     && sidechain != juce::AudioChannelSet::mono()
+     && sidechain != juce::AudioChannelSet::stereo())
+        return false;
+
     return true;
   #endif
 }
@@ -160,126 +235,256 @@ bool ViberAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
 void ViberAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
+    const RealtimeSafety::ScopedRealtimeSection realtimeSection("processBlock");
+    const auto blockStart = PerfTelemetry::now();
+
+    // The sidechain only feeds the analyser, so only the main input counts towards the outputs
+    auto mainInput = getBusBuffer(buffer, true, 0);
+    const auto sidechainInput = getBusBuffer(buffer, true, 1);
+    auto totalNumInputChannels  = mainInput.getNumChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Read and send MIDI data to frontend
-    int midiCount = 0;
-    for (const auto metadata : midiMessages)
-        ++midiCount;
-    DBG("processBlock MIDI message count = " << midiCount);
+    // Stamp where this block starts, on our clock and the host's, so the editor can tell
+    // which frames and notes are being heard
+    const auto blockTime = processedSamples.load(std::memory_order_relaxed);
+    clock.advance(blockTime, buffer.getNumSamples(), currentSampleRate, getPlayHead());
+
+    // Track held notes and queue this block's note and pressure events for the editor
+    // as one batch. This only copies raw bytes: no MidiMessage, no strings and no editor
+    // access happen on the audio thread.
+    pendingMidi.time = blockTime;
+    pendingMidi.numEvents = 0;
+    noteState.beginChanges();
 
-    int printed = 0;
     for (const auto metadata : midiMessages) {
-        auto message = metadata.getMessage();
+        MidiEvent event;
+        if (! event.parse(metadata.data, metadata.numBytes, metadata.samplePosition))
+            continue;
 
-        if (printed < 8) {
-            DBG("MIDI msg: " << message.getDescription());
-            ++printed;
-        }
+        noteState.apply(event, blockTime + metadata.samplePosition);
 
-        juce::AudioProcessorEditor* editor = getActiveEditor();
-        auto* myeditor = dynamic_cast<ViberAudioProcessorEditor*>(editor);
-        
-        if (myeditor != nullptr) {
-            lastMidiNoteNumber = message.getNoteNumber();
-            lastMidiNoteName = juce::MidiMessage::getMidiNoteName(lastMidiNoteNumber, true, true, true);
-            if (message.isNoteOn()) {
-                myeditor->sendNoteChangeEvent(lastMidiNoteName);
-            }
-            else if (message.isNoteOff()) {
-                myeditor->sendNoteOffEvent(lastMidiNoteName);
-            }
-        }
+        if (event.type == MidiEvent::Type::noteOn)
+            lastMidiNoteNumber.store(event.note, std::memory_order_relaxed);
+
+        if (pendingMidi.isFull())
+            flushMidiEvents();
+
+        pendingMidi.add(event);
     }
+
+    noteState.endChanges();
+    flushMidiEvents();
     
-    // Process audio buffer: mix all available input channels and feed into FFT FIFO
-    int numSamples = buffer.getNumSamples();
-    int numInputCh = juce::jmax(1, totalNumInputChannels);
-
-    for (int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex) {
-        float mixed = 0.0f;
-        for (int ch = 0; ch < numInputCh; ++ch) {
-            mixed += buffer.getReadPointer(ch)[sampleIndex];
-        }
-        mixed /= static_cast<float>(numInputCh);
-        pushNextSampleIntoFifo(mixed);
-    }
+    // Apply the gain to the main input in place, metering it on the way, then build every
+    // subscribed stream from the result and feed them into the FFT FIFO
+    const auto levels = gainStage.process(mainInput, gainParam->load());
+
+    const auto floorDb = floorDbParam->load();
+    analyser.setDisplayRange(floorDb, juce::jmax(ceilingDbParam->load(), floorDb + 1.0f));
+    analyser.setConfig(getAnalysisConfig());
+    pushBlockToAnalyser(mainInput, sidechainInput);
+    analyser.writeLevels(levels);
+
+    const bool useWorker = shouldUseWorkerThread();
+    analyser.setUseWorkerThread(useWorker);
+
+    if (! useWorker)
+        analyser.processPendingSamples(false);
+
+    processedSamples.store(blockTime + buffer.getNumSamples(), std::memory_order_relaxed);
+
+    telemetry.recordSince(PerfTelemetry::Stage::processBlock, blockStart);
+    telemetry.addProcessedAudio(buffer.getNumSamples(), currentSampleRate);
 }
 
-void ViberAudioProcessor::pushNextSampleIntoFifo(float sample) {
-    fftInput[fifoIndex++] = sample;
+void ViberAudioProcessor::flushMidiEvents() noexcept
+{
+    if (pendingMidi.numEvents == 0)
+        return;
 
-    if (fifoIndex == static_cast<int>(fftSize)) {
-        fifoIndex = 0;
+    // If the editor has fallen behind the batch is dropped; the note state stays correct
+    midiEvents.push([this](MidiEventBatch& slot) { slot = pendingMidi; });
+    capture.writeMidi(pendingMidi);
+    pendingMidi.numEvents = 0;
+}
 
-        // Apply window to the real samples (first fftSize elements)
-        window.multiplyWithWindowingTable(fftInput.data(), static_cast<int>(fftSize));
+void ViberAudioProcessor::pushBlockToAnalyser(const juce::AudioBuffer<float>& mainInput,
+                                              const juce::AudioBuffer<float>& sidechainInput) noexcept
+{
+    using Stream = SpectrumAnalyser::Stream;
+
+    const auto streams = analyser.getStreams();
+    const auto wants = [streams](Stream s) { return (streams & SpectrumAnalyser::streamBit(s)) != 0; };
+    const auto scratch = [this](Stream s) { return analysisBuffer.getWritePointer((int) s); };
+    const auto downmix = [](const juce::AudioBuffer<float>& bus, int start, int num, float* dest) {
+        return SpectrumKernels::downmix(bus.getArrayOfReadPointers(), bus.getNumChannels(), start, num, dest);
+    };
+
+    const int numSamples = mainInput.getNumSamples();
+    const int chunkSize = analysisBuffer.getNumSamples();
+
+    // Build every subscribed stream from the same chunk of input with vector ops, in chunks
+    // the size of the scratch buffer in case the host hands us a bigger block than it
+    // announced in prepareToPlay. Host channels are used in place; only derived streams
+    // (averages, mid and side) are written to scratch rows.
+    for (int start = 0; start < numSamples; start += chunkSize) {
+        const int num = juce::jmin(chunkSize, numSamples - start);
+        SpectrumAnalyser::StreamPointers pointers {};
+
+        const bool wantsStereo = wants(Stream::left) || wants(Stream::right) || wants(Stream::mid) || wants(Stream::side);
+
+        if (wants(Stream::mix))
+            pointers[(size_t) Stream::mix] = downmix(mainInput, start, num, scratch(Stream::mix));
+
+        if (wantsStereo) {
+            // A mono input shows up as identical left and right, so mid = L and side = 0
+            const float* left = mainInput.getNumChannels() > 0 ? mainInput.getReadPointer(0, start)
+                                                                : downmix(mainInput, start, num, scratch(Stream::left));
+            const float* right = mainInput.getNumChannels() > 1 ? mainInput.getReadPointer(1, start) : left;
+
+            if (wants(Stream::left))
+                pointers[(size_t) Stream::left] = left;
+
+            if (wants(Stream::right))
+                pointers[(size_t) Stream::right] = right;
+
+            if (wants(Stream::mid)) {
+                auto* mid = scratch(Stream::mid);
+                juce::FloatVectorOperations::add(mid, left, right, num);
+                juce::FloatVectorOperations::multiply(mid, 0.5f, num);
+                pointers[(size_t) Stream::mid] = mid;
+            }
 
-        // Zero the imaginary / upper half to ensure a clean real-valued FFT input
-        if (fftInput.size() >= fftSize * 2) {
-            std::fill(fftInput.begin() + fftSize, fftInput.begin() + fftSize * 2, 0.0f);
+            if (wants(Stream::side)) {
+                auto* side = scratch(Stream::side);
+                juce::FloatVectorOperations::subtract(side, left, right, num);
+                juce::FloatVectorOperations::multiply(side, 0.5f, num);
+                pointers[(size_t) Stream::side] = side;
+            }
         }
 
-        // Perform FFT (in-place, frequency-only optimized output)
-        fft.performFrequencyOnlyForwardTransform(fftInput.data());
-
-        // Store magnitudes (first fftSize/2 bins) and compute normalized display values
-        for (size_t i = 0; i < fftSize / 2; ++i) {
-            const float mag = fftInput[i];
-            fftMagnitudes[i] = mag;
-            // Convert to dB and normalize to [0,1] where -100 dB -> 0, 0 dB -> 1
-            const float safe = std::max(mag, 1e-8f);
-            const float db = 20.0f * std::log10(safe);
-            float norm = (db + 100.0f) / 100.0f;
-            if (norm < 0.0f) norm = 0.0f;
-            if (norm > 1.0f) norm = 1.0f;
-            if (fftDisplay.size() < fftMagnitudes.size()) fftDisplay.resize(fftMagnitudes.size(), 0.0f);
-            fftDisplay[i] = norm;
-        }
+        if (wants(Stream::sidechain))
+            pointers[(size_t) Stream::sidechain] = downmix(sidechainInput, start, num, scratch(Stream::sidechain));
 
-        fftReady.store(true);
+        analyser.writeSamples(pointers, num);
     }
 }
 
+SpectrumAnalyser::Config ViberAudioProcessor::getAnalysisConfig() const noexcept
+{
+    SpectrumAnalyser::Config config;
+    config.fftOrder = juce::roundToInt(fftOrderParam->load());
+    config.overlapIndex = juce::roundToInt(overlapParam->load());
+    config.window = static_cast<SpectrumAnalyser::WindowType>(juce::roundToInt(windowTypeParam->load()));
+    return config;
+}
 
+bool ViberAudioProcessor::shouldUseWorkerThread() const noexcept
+{
+    // Offline renders run faster than realtime and would outpace the polling worker,
+    // so they always analyse inline
+    return analysisModeParam->load() > 0.5f && ! isNonRealtime();
+}
+
+void ViberAudioProcessor::setBandLayout(BandMap::Layout newLayout)
+{
+    bandLayout = newLayout;
+    analyser.setBandMap(analysisResources->getBandMap(bandLayout, currentSampleRate));
+}
 
+juce::String ViberAudioProcessor::getLastMidiNoteName() const
+{
+    const auto note = lastMidiNoteNumber.load(std::memory_order_relaxed);
+    return note < 0 ? juce::String() : juce::MidiMessage::getMidiNoteName(note, true, true, 1);
+}
 
 //==============================================================================
 bool ViberAudioProcessor::hasEditor() const
 {
-    return true; // (change this to false if you choose to not supply an editor)
+    return ! VIBER_HEADLESS; // (change this to false if you choose to not supply an editor)
 }
 
 juce::AudioProcessorEditor* ViberAudioProcessor::createEditor()
 {
+   #if VIBER_HEADLESS
+    return nullptr;
+   #else
     return new ViberAudioProcessorEditor (*this);
+   #endif
     // return editorRef; // Return a new instance of your editor class
 }
 
 //==============================================================================
 void ViberAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    
-    juce::MemoryOutputStream mos (destData, true);
-    mos.writeInt(lastMidiNoteNumber);
-    mos.writeString(lastMidiNoteName);
+    // Straight to the binary form, no XML: sessions with many instances save them all at once
+    captureState().write(destData);
 }
 
 void ViberAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    
-    juce::MemoryInputStream mis (data, sizeInBytes, false);
-    lastMidiNoteNumber = mis.readInt();
-    lastMidiNoteName = mis.readString();
+    PluginState state;
+    const auto result = state.read(data, (size_t) juce::jmax(0, sizeInBytes));
+
+    // A truncated or foreign state keeps whatever settings we have rather than half-applying
+    if (result.failed()) {
+        DBG("Ignoring saved state: " + result.getErrorMessage());
+        return;
+    }
+
+    applyState(std::move(state));
+}
+
+PluginState ViberAudioProcessor::captureState() const
+{
+    PluginState state;
+
+    for (auto* parameter : getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            state.parameters.push_back({ ranged->getParameterID(), ranged->convertFrom0to1(ranged->getValue()) });
+
+    state.hasAnalysis = true;
+    state.bandLayout = bandLayout;
+    state.streams = getSubscribedStreams();
+    state.spectrogramStream = analyser.getSpectrogramStream();
+    state.featureStream = getFeatureStream();
+    state.saveSpectrogram = getSaveSpectrogram();
+    state.ballistics = getBallistics();
+    state.visualiser = visualiser;
+    state.lastMidiNote = lastMidiNoteNumber.load(std::memory_order_relaxed);
+
+    if (state.saveSpectrogram) {
+        int numRows = 0;
+        getSpectrogramHistory().read(0, state.spectrogram, numRows);
+    }
+
+    return state;
+}
+
+void ViberAudioProcessor::applyState(PluginState state)
+{
+    // Parameters the state doesn't mention, e.g. ones added since it was saved, keep their values
+    for (const auto& saved : state.parameters)
+        if (auto* parameter = parameters.getParameter(saved.id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(saved.value));
+
+    if (state.hasAnalysis) {
+        setBandLayout(state.bandLayout);
+        setSubscribedStreams(state.streams);
+        setSpectrogramStream(state.spectrogramStream);
+        setFeatureStream(state.featureStream);
+        setBallistics(state.ballistics);
+        setSaveSpectrogram(state.saveSpectrogram);
+    }
+
+    visualiser = state.visualiser;
+    lastMidiNoteNumber.store(state.lastMidiNote, std::memory_order_relaxed);
+
+    if (! state.spectrogram.isEmpty())
+        analyser.restoreSpectrogram(std::move(state.spectrogram));
 }
 
 //==============================================================================
@@ -9,6 +9,30 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SpectrumAnalyser.h"
+#include "AnalysisWorker.h"
+#include "MidiEventQueue.h"
+#include "MidiNoteState.h"
+#include "AudioClock.h"
+#include "GainStage.h"
+#include "PluginState.h"
+#include "AnalysisCapture.h"
+#include "RealtimeSafety.h"
+
+// Set by the offline harness (Harness/ViberHarness.jucer), which builds the processor
+// into a console app with no editor and no plugin wrapper
+#ifndef VIBER_HEADLESS
+ #define VIBER_HEADLESS 0
+#endif
+
+#if VIBER_HEADLESS
+ // No JucePluginDefines.h outside a plugin build; these mirror the settings in Viber.jucer
+ #define JucePlugin_Name                "Viber"
+ #define JucePlugin_IsSynth             1
+ #define JucePlugin_WantsMidiInput      1
+ #define JucePlugin_ProducesMidiOutput  1
+ #define JucePlugin_IsMidiEffect        0
+#endif
 
 //==============================================================================
 /**
@@ -54,31 +78,113 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
-    int lastMidiNoteNumber = -1;
-    juce::String lastMidiNoteName;
-    
-    const int fftOrder = 10;
-    const size_t fftSize = 1 << fftOrder;
-    
-    juce::dsp::FFT fft { fftOrder }; // e.g. fftOrder = 10 → 1024 samples
-    std::vector<float> fftWindow;    // Holds latest time-domain samples
-    std::vector<float> fftInput;     // Zero-padded input buffer
-    std::vector<float> fftMagnitudes;
-    std::vector<float> fftDisplay; // normalized 0..1 values for frontend
-    std::vector<std::complex<float>> fftOutput; // Output after FFT
-    juce::dsp::WindowingFunction<float> window { fftSize, juce::dsp::WindowingFunction<float>::hann };
-    std::atomic<bool> fftReady = false;
+    std::atomic<int> lastMidiNoteNumber { -1 };
+    juce::String getLastMidiNoteName() const;
+
+    // Note and pressure events captured in processBlock, one batch per block, drained
+    // and sent to the frontend by the editor
+    MidiEventQueue midiEvents;
+    static constexpr int midiQueueCapacity = 256;   // batches, i.e. blocks with MIDI in them
+
+    // Held notes with velocity, pressure and start time. Read from any thread.
+    const MidiNoteState& getNoteState() const noexcept { return noteState; }
+
+    // Samples processed since prepareToPlay; the clock MIDI batches and note times use
+    juce::int64 getProcessedSamples() const noexcept { return processedSamples.load(std::memory_order_relaxed); }
+
+    // Where each block started, on that clock and the host's, for lining the visuals up
+    // with what is heard. The editor and frontend set its latencies.
+    AudioClock& getClock() noexcept { return clock; }
+    const AudioClock& getClock() const noexcept { return clock; }
     
-    void pushNextSampleIntoFifo(float sample);
+    // Completed frames, published by the audio thread and drained by the editor
+    SpectrumFrameQueue& getSpectrumFrames() noexcept { return analyser.getFrameQueue(); }
+    SpectrumFrameQueue::Stats getSpectrumFrameStats() noexcept { return analyser.getFrameQueue().getStats(); }
+
+    void pushBlockToAnalyser(const juce::AudioBuffer<float>& mainInput, const juce::AudioBuffer<float>& sidechainInput) noexcept;
+    SpectrumAnalyser::Config getAnalysisConfig() const noexcept;
+    bool shouldUseWorkerThread() const noexcept;
+
+    /** Samples the analyser had to drop because its input ring was full. */
+    juce::uint64 getNumDroppedAnalysisSamples() const noexcept { return analyser.getNumDroppedSamples(); }
+
+    // Bin-to-band reduction requested by the frontend. Message thread only.
+    void setBandLayout(BandMap::Layout newLayout);
+    BandMap::Layout getBandLayout() const { return bandLayout; }
+
+    // Which spectra the frontend renders, as SpectrumAnalyser::streamBit() flags. Any thread.
+    void setSubscribedStreams(juce::uint32 streamMask) noexcept { analyser.setStreams(streamMask); }
+    juce::uint32 getSubscribedStreams() const noexcept { return analyser.getStreams(); }
+
+    // Waterfall history of one stream, kept while the editor is closed. Read from any thread.
+    const SpectrogramHistory& getSpectrogramHistory() const noexcept { return analyser.getSpectrogramHistory(); }
+    void setSpectrogramStream(SpectrumStream stream) noexcept { analyser.setSpectrogramStream(stream); }
+
+    // The stream whose frames carry onset, tempo, shape and pitch features, -1 for none. Any thread.
+    void setFeatureStream(int streamOrNone) noexcept { analyser.setFeatureStream(streamOrNone); }
+    int getFeatureStream() const noexcept { return analyser.getFeatureStream(); }
+
+    // Smoothing, averaging and peak hold applied to every published frame. Any thread.
+    void setBallistics(const SpectrumBallistics::Settings& settings) noexcept { analyser.setBallistics(settings); }
+    SpectrumBallistics::Settings getBallistics() const noexcept { return analyser.getBallistics(); }
+
+    // The frontend's sketch, saved with the session. Message thread only.
+    void setVisualiser(const juce::String& name) { visualiser = name; }
+    juce::String getVisualiser() const { return visualiser; }
+
+    // Whether the session also saves the spectrogram history, up to about 1 MB. Any thread.
+    void setSaveSpectrogram(bool shouldSave) noexcept { saveSpectrogram.store(shouldSave, std::memory_order_relaxed); }
+    bool getSaveSpectrogram() const noexcept { return saveSpectrogram.load(std::memory_order_relaxed); }
+
+    // Everything getStateInformation saves, and applying it back (see PluginState)
+    PluginState captureState() const;
+    void applyState(PluginState state);
+
+    // Records frames and MIDI to a file for replaying later (see AnalysisCapture). Start
+    // and stop on the message thread; the audio thread only ever queues records.
+    juce::Result startCapture(const juce::File& file) { return capture.start(file, currentSampleRate); }
+    void stopCapture() { capture.stop(); }
+    AnalysisCapture::Stats getCaptureStats() const { return capture.getStats(); }
+
+    // Hot-path timings, recorded by the audio, worker and message threads and
+    // drained by the editor for its perfstats event
+    PerfTelemetry& getTelemetry() noexcept { return telemetry; }
+
+    // Tells instances in the same host apart in the perfstats overlay
+    int getInstanceId() const noexcept { return instanceId; }
+
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ViberAudioProcessor)
-    int fifoIndex = 0;
+    PerfTelemetry telemetry; // declared before the analyser, which records into it
+    AnalysisCapture capture { SpectrumAnalyser::maxNumBins }; // ditto
+    SpectrumAnalyser analyser;
+    juce::AudioBuffer<float> analysisBuffer; // one scratch row per derived stream, sized in prepareToPlay
+    GainStage gainStage;
+    juce::SharedResourcePointer<AnalysisWorker> analysisWorker; // one thread shared by all instances
+    juce::SharedResourcePointer<AnalysisResources> analysisResources; // plans, windows and band maps, ditto
+    BandMap::Layout bandLayout;
+    double currentSampleRate = 44100.0;
+    int instanceId = 0;
+    juce::String visualiser;
+    std::atomic<bool> saveSpectrogram { false };
+
+    MidiNoteState noteState;
+    MidiEventBatch pendingMidi;             // the batch being filled by processBlock
+    std::atomic<juce::int64> processedSamples { 0 };
+    AudioClock clock;
+    void flushMidiEvents() noexcept;
     
     juce::AudioParameterFloat* gain;
     std::atomic<float>* gainParam = nullptr;
+    std::atomic<float>* floorDbParam = nullptr;
+    std::atomic<float>* ceilingDbParam = nullptr;
+    std::atomic<float>* analysisModeParam = nullptr;
+    std::atomic<float>* fftOrderParam = nullptr;
+    std::atomic<float>* overlapParam = nullptr;
+    std::atomic<float>* windowTypeParam = nullptr;
 
     juce::AudioProcessorValueTreeState parameters;
 };
@@ -0,0 +1,268 @@
+/*
+  ==============================================================================
+
+    PluginState.cpp
+
+  ==============================================================================
+*/
+
+#include "PluginState.h"
+
+namespace {
+// Bounds-checked little endian reads over one block. A read past the end fails
+// the reader and returns 0, so callers can check once at the end of a chunk.
+class Reader
+{
+public:
+    Reader (const juce::uint8* data, size_t size) noexcept  : pos (data), end (data + size) {}
+
+    size_t getRemaining() const noexcept  { return (size_t) (end - pos); }
+    bool hasFailed() const noexcept       { return failed; }
+
+    template <typename IntType>
+    IntType read() noexcept
+    {
+        static_assert (std::is_unsigned_v<IntType>, "read unsigned, then cast");
+
+        if (getRemaining() < sizeof (IntType))
+            return fail(), IntType (0);
+
+        IntType value = 0;
+
+        for (size_t i = 0; i < sizeof (IntType); ++i)
+            value = (IntType) (value | ((IntType) pos[i] << (8 * i)));
+
+        pos += sizeof (IntType);
+        return value;
+    }
+
+    float readFloat() noexcept
+    {
+        const auto bits = read<juce::uint32>();
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+
+    const juce::uint8* readBytes (size_t numBytes) noexcept
+    {
+        if (getRemaining() < numBytes)
+            return fail(), nullptr;
+
+        const auto* start = pos;
+        pos += numBytes;
+        return start;
+    }
+
+    juce::String readString (size_t numBytes)
+    {
+        const auto* bytes = readBytes (numBytes);
+        return bytes != nullptr ? juce::String::fromUTF8 (reinterpret_cast<const char*> (bytes), (int) numBytes)
+                                : juce::String();
+    }
+
+private:
+    void fail() noexcept
+    {
+        failed = true;
+        pos = end;
+    }
+
+    const juce::uint8* pos;
+    const juce::uint8* end;
+    bool failed = false;
+};
+
+// Writes a chunk's id and a placeholder size, then patches the size once `writeBody` is done
+template <typename Body>
+void writeChunk (juce::MemoryOutputStream& out, PluginState::ChunkId id, Body&& writeBody)
+{
+    out.writeShort ((short) id);
+    const auto sizePosition = out.getPosition();
+    out.writeInt (0);
+
+    writeBody();
+
+    const auto endPosition = out.getPosition();
+    out.setPosition (sizePosition);
+    out.writeInt ((int) (endPosition - sizePosition - 4));
+    out.setPosition (endPosition);
+}
+
+bool readParameters (Reader& in, PluginState& state)
+{
+    const auto count = in.read<juce::uint16>();
+    state.parameters.reserve (count);
+
+    for (int i = 0; i < count && ! in.hasFailed(); ++i)
+    {
+        PluginState::Parameter parameter;
+        parameter.id = in.readString (in.read<juce::uint8>());
+        parameter.value = in.readFloat();
+
+        if (std::isfinite (parameter.value) && parameter.id.isNotEmpty())
+            state.parameters.push_back (std::move (parameter));
+    }
+
+    return ! in.hasFailed();
+}
+
+bool readAnalysis (Reader& in, PluginState& state)
+{
+    const auto scale = in.read<juce::uint8>();
+    state.bandLayout.scale = scale <= (juce::uint8) BandMap::Scale::thirdOctave ? (BandMap::Scale) scale
+                                                                              : BandMap::Scale::linear;
+    state.bandLayout.numBands = juce::jmin ((int) in.read<juce::uint16>(), BandMap::maxBands);
+    state.streams = in.read<juce::uint32>();
+
+    const auto stream = in.read<juce::uint8>();
+    state.spectrogramStream = stream < numSpectrumStreams ? (SpectrumStream) stream : SpectrumStream::mix;
+
+    const auto flags = in.read<juce::uint8>();
+    state.saveSpectrogram = (flags & 1) != 0;
+
+    auto& ballistics = state.ballistics;
+    ballistics.attackMs = in.readFloat();
+    ballistics.releaseMs = in.readFloat();
+    ballistics.averageFrames = juce::jmax (1, (int) in.read<juce::uint8>());
+    ballistics.peaks = in.read<juce::uint8>() != 0;
+    ballistics.peakHoldMs = in.readFloat();
+    ballistics.peakDecayDbPerSecond = in.readFloat();
+
+    const auto featureStream = in.read<juce::uint8>();
+    state.featureStream = featureStream < numSpectrumStreams ? (int) featureStream : -1;
+
+    state.hasAnalysis = ! in.hasFailed();
+    return state.hasAnalysis;
+}
+} // namespace
+
+//==============================================================================
+void PluginState::write (juce::MemoryBlock& dest) const
+{
+    dest.reset();
+    juce::MemoryOutputStream out (dest, false);
+
+    out.writeByte ('V');
+    out.writeByte ('P');
+    out.writeByte ((char) currentVersion);
+    out.writeByte (0);
+    out.writeInt (0);       // patched below
+
+    writeChunk (out, ChunkId::parameters, [&]
+    {
+        // IDs are short; one too long for its length byte is left out rather than cut
+        const auto fits = [] (const Parameter& p) { return p.id.getNumBytesAsUTF8() <= 255; };
+        jassert (std::all_of (parameters.begin(), parameters.end(), fits));
+
+        out.writeShort ((short) std::count_if (parameters.begin(), parameters.end(), fits));
+
+        for (const auto& parameter : parameters)
+        {
+            if (! fits (parameter))
+                continue;
+
+            out.writeByte ((char) parameter.id.getNumBytesAsUTF8());
+            out.write (parameter.id.toRawUTF8(), parameter.id.getNumBytesAsUTF8());
+            out.writeFloat (parameter.value);
+        }
+    });
+
+    writeChunk (out, ChunkId::analysis, [&]
+    {
+        out.writeByte ((char) bandLayout.scale);
+        out.writeShort ((short) juce::jlimit (0, BandMap::maxBands, bandLayout.numBands));
+        out.writeInt ((int) streams);
+        out.writeByte ((char) spectrogramStream);
+        out.writeByte (saveSpectrogram ? 1 : 0);
+        out.writeFloat (ballistics.attackMs);
+        out.writeFloat (ballistics.releaseMs);
+        out.writeByte ((char) ballistics.averageFrames);
+        out.writeByte (ballistics.peaks ? 1 : 0);
+        out.writeFloat (ballistics.peakHoldMs);
+        out.writeFloat (ballistics.peakDecayDbPerSecond);
+        out.writeByte ((char) (featureStream >= 0 ? featureStream : 0xff));
+    });
+
+    if (visualiser.isNotEmpty())
+        writeChunk (out, ChunkId::visualiser, [&] { out.write (visualiser.toRawUTF8(), visualiser.getNumBytesAsUTF8()); });
+
+    writeChunk (out, ChunkId::midi, [&] { out.writeShort ((short) lastMidiNote); });
+
+    if (! spectrogram.isEmpty())
+        writeChunk (out, ChunkId::spectrogram, [&] { out.write (spectrogram.getData(), spectrogram.getSize()); });
+
+    const auto totalSize = out.getPosition();
+    out.setPosition (4);
+    out.writeInt ((int) (totalSize - headerSize));
+    out.flush();
+}
+
+juce::Result PluginState::read (const void* data, size_t size)
+{
+    if (data == nullptr || size == 0)
+        return juce::Result::fail ("Empty state");
+
+    Reader header (static_cast<const juce::uint8*> (data), size);
+    const auto magic0 = header.read<juce::uint8>();
+    const auto magic1 = header.read<juce::uint8>();
+
+    if (magic0 != 'V' || magic1 != 'P')
+    {
+        // The original format: int32 note number, then its name
+        Reader legacy (static_cast<const juce::uint8*> (data), size);
+        const auto note = (juce::int32) legacy.read<juce::uint32>();
+
+        if (legacy.hasFailed() || note < -1 || note > 127)
+            return juce::Result::fail ("Not a Viber state");
+
+        *this = {};
+        lastMidiNote = note;
+        return juce::Result::ok();
+    }
+
+    const auto version = header.read<juce::uint8>();
+    header.read<juce::uint8>();
+    const auto chunksSize = header.read<juce::uint32>();
+
+    if (header.hasFailed())
+        return juce::Result::fail ("Truncated state header");
+
+    if (version == 0 || version > currentVersion)
+        return juce::Result::fail ("Unsupported state version " + juce::String (version));
+
+    if (chunksSize > header.getRemaining())
+        return juce::Result::fail ("Truncated state");
+
+    Reader chunks (header.readBytes (chunksSize), chunksSize);
+    PluginState loaded;
+
+    while (chunks.getRemaining() > 0)
+    {
+        const auto id = (ChunkId) chunks.read<juce::uint16>();
+        const auto chunkSize = chunks.read<juce::uint32>();
+        const auto* body = chunks.readBytes (chunkSize);
+
+        if (chunks.hasFailed())
+            return juce::Result::fail ("Truncated state chunk");
+
+        Reader in (body, chunkSize);
+        auto ok = true;
+
+        switch (id)
+        {
+            case ChunkId::parameters:   ok = readParameters (in, loaded); break;
+            case ChunkId::analysis:     ok = readAnalysis (in, loaded); break;
+            case ChunkId::visualiser:   loaded.visualiser = in.readString (chunkSize); break;
+            case ChunkId::midi:         loaded.lastMidiNote = juce::jlimit (-1, 127, (int) (juce::int16) in.read<juce::uint16>()); break;
+            case ChunkId::spectrogram:  loaded.spectrogram.replaceAll (body, chunkSize); break;
+            default:                    break;      // from a newer version
+        }
+
+        if (! ok || in.hasFailed())
+            return juce::Result::fail ("Corrupt state chunk " + juce::String ((int) id));
+    }
+
+    *this = std::move (loaded);
+    return juce::Result::ok();
+}
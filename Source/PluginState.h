@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    PluginState.h
+    What getStateInformation saves: every parameter, the analysis settings the
+    frontend chose, the selected visualiser and, optionally, the spectrogram.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandMap.h"
+#include "SpectrumBallistics.h"
+#include "SpectrumFrame.h"
+
+//==============================================================================
+/**
+    A plain copy of the state, with a compact binary form that is written and
+    parsed in one pass: no XML or ValueTree in between, so a session with many
+    instances saves and loads quickly.
+
+    Layout (all multi-byte fields little endian):
+
+        0   'V' 'P'         magic
+        2   uint8           format version (currentVersion)
+        3   uint8           reserved, 0
+        4   uint32          number of bytes of chunks that follow
+        8   chunks...       each: uint16 id (ChunkId), uint32 size, then `size` bytes
+
+    Chunks:
+
+        parameters      uint16 count, then per parameter: uint8 ID length, the
+                        ID in UTF-8, float32 plain (not normalised) value
+        analysis        uint8 band scale (BandMap::Scale), uint16 band count,
+                        uint32 stream mask, uint8 spectrogram stream, uint8 flags
+                        (bit 0: save the spectrogram), float32 attack ms,
+                        float32 release ms, uint8 average frames, uint8 peaks,
+                        float32 peak hold ms, float32 peak decay dB/s, uint8
+                        feature stream (255 for none)
+        visualiser      the frontend's sketch name, UTF-8
+        midi            int16 last note number, -1 for none
+        spectrogram     rows in the SpectrogramHistory::read() format
+
+    Readers skip chunks they don't know and ignore bytes past the fields they
+    know at the end of a chunk, so newer versions can add either. Every length
+    is checked against what is left, so a truncated or corrupt state fails to
+    load rather than reading past the end.
+*/
+struct PluginState
+{
+    static constexpr juce::uint8 currentVersion = 1;
+    static constexpr int headerSize = 8;
+
+    enum class ChunkId : juce::uint16
+    {
+        parameters = 1,
+        analysis,
+        visualiser,
+        midi,
+        spectrogram
+    };
+
+    struct Parameter
+    {
+        juce::String id;
+        float value = 0.0f;
+    };
+
+    std::vector<Parameter> parameters;
+    bool hasAnalysis = false;       // false when loading a state that had no analysis chunk
+    BandMap::Layout bandLayout;
+    juce::uint32 streams = 0;
+    SpectrumStream spectrogramStream = SpectrumStream::mix;
+    int featureStream = -1;         // a SpectrumStream, or -1 for no feature extraction
+    bool saveSpectrogram = false;
+    SpectrumBallistics::Settings ballistics;
+    juce::String visualiser;
+    int lastMidiNote = -1;
+    juce::MemoryBlock spectrogram;  // empty when not saved
+
+    /** Replaces the contents of `dest` with the binary form. */
+    void write (juce::MemoryBlock& dest) const;
+
+    /** Parses the binary form. On failure returns why, and the state is left as
+        it was. States saved before this format existed (a note number and its
+        name) load as just the note.
+    */
+    juce::Result read (const void* data, size_t size);
+};
@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    RealtimeQueue.h
+    Lock-free single-producer / single-consumer queue of preallocated elements.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A fixed-capacity SPSC queue built on juce::AbstractFifo.
+
+    Elements are allocated once in prepare() and then reused, so push() and
+    pop() never allocate or lock. The producer fills a slot in place through a
+    callback and the consumer reads it back the same way, which means the
+    consumer always sees a complete element, never a half-written one.
+
+    If the queue is full when the producer pushes, the element is dropped and
+    counted rather than overwriting something the consumer may be reading.
+*/
+template <typename ElementType>
+class RealtimeQueue
+{
+public:
+    struct Stats
+    {
+        juce::uint64 published = 0;
+        juce::uint64 consumed  = 0;
+        juce::uint64 dropped   = 0;
+    };
+
+    RealtimeQueue() = default;
+
+    /** Allocates room for `capacity` elements and runs `initialise` on each one.
+        Not thread safe: call it while neither side is using the queue.
+    */
+    template <typename Initialiser>
+    void prepare (int capacity, Initialiser&& initialise)
+    {
+        jassert (capacity > 0);
+
+        // AbstractFifo always keeps one slot empty to tell full from empty
+        elements.resize ((size_t) capacity + 1);
+
+        for (auto& element : elements)
+            initialise (element);
+
+        fifo.setTotalSize (capacity + 1);
+        fifo.reset();
+    }
+
+    /** Producer side. Calls `write` on a free slot and publishes it.
+        Returns false (and counts a drop) if the queue is full.
+    */
+    template <typename Writer>
+    bool push (Writer&& write) noexcept
+    {
+        const auto scope = fifo.write (1);
+
+        if (scope.blockSize1 == 0)
+        {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        write (elements[(size_t) scope.startIndex1]);
+        published.fetch_add (1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Consumer side. Calls `read` on the oldest element, if there is one. */
+    template <typename Reader>
+    bool pop (Reader&& read)
+    {
+        const auto scope = fifo.read (1);
+
+        if (scope.blockSize1 == 0)
+            return false;
+
+        read (elements[(size_t) scope.startIndex1]);
+        consumed.fetch_add (1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Consumer side. Discards everything but the newest element, then reads it.
+        The skipped elements are counted as dropped.
+    */
+    template <typename Reader>
+    bool popLatest (Reader&& read)
+    {
+        const auto numReady = fifo.getNumReady();
+
+        if (numReady == 0)
+            return false;
+
+        if (numReady > 1)
+        {
+            fifo.finishedRead (numReady - 1);
+            dropped.fetch_add ((juce::uint64) (numReady - 1), std::memory_order_relaxed);
+        }
+
+        return pop (std::forward<Reader> (read));
+    }
+
+    int getNumReady() const noexcept    { return fifo.getNumReady(); }
+    int getCapacity() const noexcept    { return fifo.getTotalSize() - 1; }
+
+    Stats getStats() const noexcept
+    {
+        return { published.load (std::memory_order_relaxed),
+                 consumed.load (std::memory_order_relaxed),
+                 dropped.load (std::memory_order_relaxed) };
+    }
+
+    void resetStats() noexcept
+    {
+        published.store (0, std::memory_order_relaxed);
+        consumed.store (0, std::memory_order_relaxed);
+        dropped.store (0, std::memory_order_relaxed);
+    }
+
+private:
+    juce::AbstractFifo fifo { 1 };
+    std::vector<ElementType> elements;
+
+    std::atomic<juce::uint64> published { 0 }, consumed { 0 }, dropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeQueue)
+};
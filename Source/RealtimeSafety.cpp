@@ -0,0 +1,435 @@
+/*
+  ==============================================================================
+
+    RealtimeSafety.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeSafety.h"
+
+#if VIBER_RT_CHECKS
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX || JUCE_BSD
+ #include <malloc.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <malloc/malloc.h>
+#endif
+
+#if JUCE_WINDOWS
+ extern "C" __declspec (dllimport) unsigned short __stdcall RtlCaptureStackBackTrace (unsigned long, unsigned long, void**, unsigned long*);
+#else
+ #include <cxxabi.h>
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+#endif
+
+namespace {
+using RealtimeSafety::Violation;
+
+constexpr int maxStackFrames = 24;
+constexpr int maxCallSites = 64;
+
+// Everything here is constant-initialised, so the hooks can run before (and
+// after) static constructors without touching anything half built.
+struct ThreadState
+{
+    const char* section = nullptr;  // innermost open section, or nullptr
+    bool insideHook = false;        // stops the hooks reporting their own work
+    juce::uint64 allocations = 0;
+    juce::int64 heapBytes = 0;
+};
+
+thread_local ThreadState threadState;
+
+/** One distinct stack that violated a realtime section. Slots are claimed once
+    and only filled in before `ready` is set, so readers never see a partial one.
+*/
+struct CallSite
+{
+    std::atomic<bool> ready { false };
+    std::atomic<juce::uint64> hits { 0 };
+    Violation kind = Violation::allocation;
+    const char* section = nullptr;
+    int numFrames = 0;
+    void* frames[maxStackFrames] {};
+};
+
+CallSite callSites[maxCallSites];
+std::atomic<int> numCallSites { 0 };
+std::atomic<juce::uint64> unrecordedViolations { 0 };   // happened after the table filled up
+std::atomic<juce::uint64> violationCounts[RealtimeSafety::numViolationKinds] {};
+
+int captureStack (void** frames, int maxFrames) noexcept
+{
+   #if JUCE_WINDOWS
+    return (int) RtlCaptureStackBackTrace (0, (unsigned long) maxFrames, frames, nullptr);
+   #else
+    return backtrace (frames, maxFrames);
+   #endif
+}
+
+// The first backtrace() loads the unwinder, which allocates and locks. Do that
+// now, while the plugin is being loaded, rather than on the audio thread.
+[[maybe_unused]] const int warmUpStackCapture = []
+{
+    void* frame = nullptr;
+    return captureStack (&frame, 1);
+}();
+
+bool isSameCallSite (const CallSite& site, Violation kind, void* const* frames, int numFrames) noexcept
+{
+    return site.ready.load (std::memory_order_acquire)
+        && site.kind == kind
+        && site.numFrames == numFrames
+        && std::equal (frames, frames + numFrames, site.frames);
+}
+
+void record (Violation kind) noexcept
+{
+    auto& state = threadState;
+
+    if (state.section == nullptr || state.insideHook)
+        return;
+
+    state.insideHook = true;
+    violationCounts[(int) kind].fetch_add (1, std::memory_order_relaxed);
+
+    // Drop the frame of this function itself
+    void* frames[maxStackFrames + 1];
+    const auto numFrames = juce::jmax (0, captureStack (frames, maxStackFrames + 1) - 1);
+    auto* const stack = frames + 1;
+
+    const auto numKnown = juce::jmin (numCallSites.load (std::memory_order_acquire), maxCallSites);
+    bool found = false;
+
+    for (int i = 0; i < numKnown && ! found; ++i)
+    {
+        if (isSameCallSite (callSites[i], kind, stack, numFrames))
+        {
+            callSites[i].hits.fetch_add (1, std::memory_order_relaxed);
+            found = true;
+        }
+    }
+
+    if (! found)
+    {
+        const auto index = numCallSites.load (std::memory_order_relaxed) < maxCallSites
+                               ? numCallSites.fetch_add (1, std::memory_order_acq_rel)
+                               : maxCallSites;
+
+        if (index < maxCallSites)
+        {
+            auto& site = callSites[index];
+            site.kind = kind;
+            site.section = state.section;
+            site.numFrames = numFrames;
+            std::copy (stack, stack + numFrames, site.frames);
+            site.hits.store (1, std::memory_order_relaxed);
+            site.ready.store (true, std::memory_order_release);
+        }
+        else
+        {
+            unrecordedViolations.fetch_add (1, std::memory_order_relaxed);
+        }
+    }
+
+    state.insideHook = false;
+}
+
+const char* getViolationName (Violation kind) noexcept
+{
+    switch (kind)
+    {
+        case Violation::allocation:     return "allocation";
+        case Violation::deallocation:   return "free";
+        case Violation::lock:           return "lock";
+    }
+
+    return "";
+}
+
+juce::String demangle (const juce::String& symbol)
+{
+   #if JUCE_WINDOWS
+    return symbol;
+   #else
+    // Both "binary(_ZN...+0x1c) [0x...]" (glibc) and "3 binary 0x... _ZN... + 28" (macOS)
+    const auto start = symbol.indexOf ("_Z");
+
+    if (start < 0)
+        return symbol;
+
+    auto end = start;
+    while (end < symbol.length() && ! juce::String ("+ )").containsChar (symbol[end]))
+        ++end;
+
+    const auto mangled = symbol.substring (start, end);
+    int status = 0;
+    auto* demangled = abi::__cxa_demangle (mangled.toRawUTF8(), nullptr, nullptr, &status);
+
+    if (status != 0 || demangled == nullptr)
+        return symbol;
+
+    const auto result = symbol.replaceSection (start, end - start, demangled);
+    std::free (demangled);
+    return result;
+   #endif
+}
+
+juce::StringArray symbolise (void* const* frames, int numFrames)
+{
+    juce::StringArray lines;
+
+   #if JUCE_WINDOWS
+    for (int i = 0; i < numFrames; ++i)
+        lines.add ("0x" + juce::String::toHexString ((juce::pointer_sized_int) frames[i]));
+   #else
+    if (auto** symbols = backtrace_symbols (frames, numFrames))
+    {
+        for (int i = 0; i < numFrames; ++i)
+            lines.add (demangle (symbols[i]));
+
+        std::free (symbols);
+    }
+   #endif
+
+    return lines;
+}
+
+//==============================================================================
+// What the allocator actually reserved for a block, which free() will give back
+juce::int64 getBlockSize ([[maybe_unused]] void* p) noexcept
+{
+   #if JUCE_LINUX || JUCE_BSD
+    return (juce::int64) malloc_usable_size (p);
+   #elif JUCE_MAC || JUCE_IOS
+    return (juce::int64) malloc_size (p);
+   #else
+    return 0;
+   #endif
+}
+
+void* countedAllocate (std::size_t size) noexcept
+{
+    ++threadState.allocations;
+    record (Violation::allocation);
+
+    auto* p = std::malloc (size == 0 ? 1 : size);
+
+    if (p != nullptr)
+        threadState.heapBytes += getBlockSize (p);
+
+    return p;
+}
+
+void* countedAllocateAligned (std::size_t size, std::align_val_t alignment) noexcept
+{
+    ++threadState.allocations;
+    record (Violation::allocation);
+
+   #if JUCE_WINDOWS
+    return _aligned_malloc (size == 0 ? 1 : size, (std::size_t) alignment);
+   #else
+    void* result = nullptr;
+
+    if (posix_memalign (&result, juce::jmax (sizeof (void*), (std::size_t) alignment), size == 0 ? 1 : size) != 0)
+        return nullptr;
+
+    threadState.heapBytes += getBlockSize (result);
+    return result;
+   #endif
+}
+
+void countedFree (void* p) noexcept
+{
+    if (p == nullptr)
+        return;
+
+    record (Violation::deallocation);
+    threadState.heapBytes -= getBlockSize (p);
+    std::free (p);
+}
+
+void countedFreeAligned (void* p) noexcept
+{
+    if (p == nullptr)
+        return;
+
+    record (Violation::deallocation);
+
+   #if JUCE_WINDOWS
+    _aligned_free (p);
+   #else
+    threadState.heapBytes -= getBlockSize (p);
+    std::free (p);
+   #endif
+}
+} // namespace
+
+//==============================================================================
+RealtimeSafety::ScopedRealtimeSection::ScopedRealtimeSection (const char* name) noexcept
+    : previousName (threadState.section)
+{
+    threadState.section = name;
+}
+
+RealtimeSafety::ScopedRealtimeSection::~ScopedRealtimeSection() noexcept
+{
+    threadState.section = previousName;
+}
+
+juce::uint64 RealtimeSafety::getViolationCount (Violation kind) noexcept
+{
+    return violationCounts[(int) kind].load (std::memory_order_relaxed);
+}
+
+juce::uint64 RealtimeSafety::getTotalViolationCount() noexcept
+{
+    juce::uint64 total = 0;
+
+    for (auto& count : violationCounts)
+        total += count.load (std::memory_order_relaxed);
+
+    return total;
+}
+
+juce::uint64 RealtimeSafety::getThreadAllocationCount() noexcept
+{
+    return threadState.allocations;
+}
+
+juce::int64 RealtimeSafety::getThreadHeapBytes() noexcept
+{
+    return threadState.heapBytes;
+}
+
+juce::String RealtimeSafety::getReport()
+{
+    juce::String report;
+    report << "Realtime safety: "
+           << (juce::int64) getViolationCount (Violation::allocation) << " allocations, "
+           << (juce::int64) getViolationCount (Violation::deallocation) << " frees, "
+           << (juce::int64) getViolationCount (Violation::lock) << " locks inside realtime sections\n";
+
+    const auto numKnown = juce::jmin (numCallSites.load (std::memory_order_acquire), maxCallSites);
+
+    for (int i = 0; i < numKnown; ++i)
+    {
+        const auto& site = callSites[i];
+
+        if (! site.ready.load (std::memory_order_acquire))
+            continue;
+
+        report << "\n" << getViolationName (site.kind) << " in " << site.section
+               << ", " << (juce::int64) site.hits.load (std::memory_order_relaxed) << " times:\n";
+
+        for (const auto& line : symbolise (site.frames, site.numFrames))
+            report << "    " << line << "\n";
+    }
+
+    if (const auto unrecorded = unrecordedViolations.load (std::memory_order_relaxed))
+        report << "\n" << (juce::int64) unrecorded << " more violations from call sites past the first "
+               << maxCallSites << "\n";
+
+    return report;
+}
+
+void RealtimeSafety::reset() noexcept
+{
+    for (auto& count : violationCounts)
+        count.store (0, std::memory_order_relaxed);
+
+    for (auto& site : callSites)
+        site.ready.store (false, std::memory_order_relaxed);
+
+    unrecordedViolations.store (0, std::memory_order_relaxed);
+    numCallSites.store (0, std::memory_order_release);
+}
+
+//==============================================================================
+// The global allocator. Replacing it in the plugin only catches allocations made
+// from the plugin's own binary, which is the code we can do something about.
+void* operator new (std::size_t size)
+{
+    if (auto* p = countedAllocate (size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept    { return countedAllocate (size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept  { return countedAllocate (size); }
+
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    if (auto* p = countedAllocateAligned (size, alignment))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size, std::align_val_t alignment)
+{
+    return operator new (size, alignment);
+}
+
+void operator delete (void* p) noexcept                                 { countedFree (p); }
+void operator delete[] (void* p) noexcept                               { countedFree (p); }
+void operator delete (void* p, std::size_t) noexcept                    { countedFree (p); }
+void operator delete[] (void* p, std::size_t) noexcept                  { countedFree (p); }
+void operator delete (void* p, std::align_val_t) noexcept               { countedFreeAligned (p); }
+void operator delete[] (void* p, std::align_val_t) noexcept             { countedFreeAligned (p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept  { countedFreeAligned (p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept { countedFreeAligned (p); }
+
+//==============================================================================
+#if ! JUCE_WINDOWS
+// juce::CriticalSection, std::mutex (with libstdc++) and everything else in this
+// binary that blocks on a mutex ends up here. The definition is hidden, so it
+// only shadows the real one for calls made from our own code, never the host's.
+// Only the blocking lock is hooked: try-locks are fine on the audio thread.
+extern "C" __attribute__ ((visibility ("hidden"))) int pthread_mutex_lock (pthread_mutex_t* mutex)
+{
+    using LockFunction = int (*) (pthread_mutex_t*);
+
+    // Looked up on first use rather than in a static constructor, since other
+    // static constructors may lock before ours has run
+    static std::atomic<LockFunction> realLock { nullptr };
+    auto lock = realLock.load (std::memory_order_acquire);
+
+    if (lock == nullptr)
+    {
+        lock = reinterpret_cast<LockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+        realLock.store (lock, std::memory_order_release);
+    }
+
+    record (Violation::lock);
+    return lock (mutex);
+}
+#endif
+
+#else
+
+//==============================================================================
+juce::uint64 RealtimeSafety::getViolationCount (Violation) noexcept    { return 0; }
+juce::uint64 RealtimeSafety::getTotalViolationCount() noexcept         { return 0; }
+juce::uint64 RealtimeSafety::getThreadAllocationCount() noexcept       { return 0; }
+juce::int64 RealtimeSafety::getThreadHeapBytes() noexcept              { return 0; }
+void RealtimeSafety::reset() noexcept                                  {}
+
+juce::String RealtimeSafety::getReport()
+{
+    return "Realtime safety checks are not compiled in. Build with VIBER_RT_CHECKS=1 to enable them.\n";
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    RealtimeSafety.h
+    Catches heap allocations, frees and blocking locks on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Build with VIBER_RT_CHECKS=1 to replace the global allocator and hook
+    pthread_mutex_lock (see RealtimeSafety.cpp). Debug builds of the plugin and
+    the offline harness turn it on; release builds compile it all away.
+*/
+#ifndef VIBER_RT_CHECKS
+ #define VIBER_RT_CHECKS 0
+#endif
+
+//==============================================================================
+/**
+    Code that must never allocate or block (processBlock, the analysis pass)
+    opens a ScopedRealtimeSection. While one is open on a thread, every
+    operator new/delete and every pthread_mutex_lock made by that thread is
+    counted as a violation, and the call stack of the first occurrence of each
+    distinct call site is kept for the report.
+
+    Recording a violation never allocates or locks: counters are atomics and
+    call sites go into a fixed table, so the instrumentation can't cause the
+    xruns it's looking for. Stacks are only turned into text by getReport(),
+    on whatever thread asks for it.
+
+    The hooks see calls made from the plugin's own binary (our code and the
+    JUCE modules compiled into it), not ones made inside the host or system
+    libraries. Mutex hooks are POSIX only.
+*/
+namespace RealtimeSafety
+{
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        lock
+    };
+
+    constexpr int numViolationKinds = 3;
+
+    /** True when the hooks are compiled in. */
+    constexpr bool isEnabled() noexcept     { return VIBER_RT_CHECKS != 0; }
+
+    //==============================================================================
+    /** Marks the calling thread as realtime for the lifetime of the object. Nests. */
+    class ScopedRealtimeSection
+    {
+    public:
+        explicit ScopedRealtimeSection (const char* name) noexcept;
+        ~ScopedRealtimeSection() noexcept;
+
+    private:
+        [[maybe_unused]] const char* previousName = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedRealtimeSection)
+    };
+
+   #if ! VIBER_RT_CHECKS
+    inline ScopedRealtimeSection::ScopedRealtimeSection (const char*) noexcept {}
+    inline ScopedRealtimeSection::~ScopedRealtimeSection() noexcept {}
+   #endif
+
+    //==============================================================================
+    /** Violations of one kind, from all threads, since the last reset(). */
+    juce::uint64 getViolationCount (Violation kind) noexcept;
+
+    /** Violations of every kind, from all threads, since the last reset(). */
+    juce::uint64 getTotalViolationCount() noexcept;
+
+    /** Heap allocations made by the calling thread, inside a realtime section or
+        not. Always 0 when the hooks aren't compiled in.
+    */
+    juce::uint64 getThreadAllocationCount() noexcept;
+
+    /** Heap bytes allocated minus bytes freed by the calling thread, as the
+        allocator sized the blocks. Differences between two calls measure what a
+        piece of code kept. Always 0 when the hooks aren't compiled in or on
+        Windows.
+    */
+    juce::int64 getThreadHeapBytes() noexcept;
+
+    /** A readable summary: counts per kind, then each distinct call site with
+        its section, hit count and symbolised stack. Allocates, so never call
+        it from a realtime section.
+    */
+    juce::String getReport();
+
+    /** Clears the counters and the call-site table. Only call this while no
+        realtime section is open, e.g. before a harness run or after releaseResources.
+    */
+    void reset() noexcept;
+}
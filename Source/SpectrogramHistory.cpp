@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    SpectrogramHistory.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrogramHistory.h"
+
+namespace {
+inline juce::uint8 quantise (float value) noexcept
+{
+    return (juce::uint8) (juce::jlimit (0.0f, 1.0f, value) * 255.0f + 0.5f);
+}
+
+template <typename IntType>
+void writeLittleEndian (juce::uint8* dest, IntType value)
+{
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        dest[i] = (juce::uint8) ((value >> (8 * i)) & 0xff);
+}
+
+template <typename IntType>
+IntType readLittleEndian (const juce::uint8* source)
+{
+    IntType value = 0;
+
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        value = (IntType) (value | ((IntType) source[i] << (8 * i)));
+
+    return value;
+}
+} // namespace
+
+//==============================================================================
+void SpectrogramHistory::prepare()
+{
+    if (rows.empty())
+    {
+        headers.resize ((size_t) capacity);
+        rows.resize ((size_t) (capacity * maxRowWidth));
+    }
+
+    numWritten.store (0, std::memory_order_release);
+}
+
+void SpectrogramHistory::write (const float* values, int numValues, BandMap::Scale scale,
+                                SpectrumStream stream, juce::uint64 sequence) noexcept
+{
+    if (rows.empty())
+        return;
+
+    const auto index = numWritten.load (std::memory_order_relaxed);
+    const auto slot = (size_t) (index % (juce::uint64) capacity);
+    auto* row = rows.data() + slot * (size_t) maxRowWidth;
+
+    // Keeps the stores to the slot after the previous publish, which a lapped reader checks
+    std::atomic_thread_fence (std::memory_order_release);
+
+    // Wider frames keep the loudest bin of each group, so narrow peaks don't vanish
+    const int group = (numValues + maxRowWidth - 1) / maxRowWidth;
+    int width = numValues;
+
+    if (group <= 1)
+    {
+        for (int i = 0; i < numValues; ++i)
+            row[i] = quantise (values[i]);
+    }
+    else
+    {
+        width = (numValues + group - 1) / group;
+
+        for (int i = 0; i < width; ++i)
+        {
+            const int start = i * group;
+            const int num = juce::jmin (group, numValues - start);
+            row[i] = quantise (juce::FloatVectorOperations::findMaximum (values + start, num));
+        }
+    }
+
+    auto& header = headers[slot];
+    header.width = (juce::uint16) width;
+    header.scale = scale;
+    header.stream = stream;
+    header.sequence = (juce::uint32) sequence;
+
+    numWritten.store (index + 1, std::memory_order_release);
+}
+
+int SpectrogramHistory::restore (const void* data, size_t size) noexcept
+{
+    const auto* bytes = static_cast<const juce::uint8*> (data);
+
+    if (rows.empty() || size < (size_t) headerSize || bytes[0] != 'V' || bytes[1] != 'S'
+        || bytes[2] != currentVersion)
+        return 0;
+
+    const int numRows = readLittleEndian<juce::uint16> (bytes + 4);
+    size_t offset = headerSize;
+    int restored = 0;
+
+    for (; restored < numRows && offset + rowHeaderSize <= size; ++restored)
+    {
+        const auto* rowHeader = bytes + offset;
+        const int width = readLittleEndian<juce::uint16> (rowHeader);
+
+        if (width > maxRowWidth || offset + rowHeaderSize + (size_t) width > size)
+            break;
+
+        const auto index = numWritten.load (std::memory_order_relaxed);
+        const auto slot = (size_t) (index % (juce::uint64) capacity);
+        std::atomic_thread_fence (std::memory_order_release);
+        std::copy_n (rowHeader + rowHeaderSize, width, rows.data() + slot * (size_t) maxRowWidth);
+
+        auto& header = headers[slot];
+        header.width = (juce::uint16) width;
+        header.scale = rowHeader[2] <= (juce::uint8) BandMap::Scale::thirdOctave ? (BandMap::Scale) rowHeader[2]
+                                                                               : BandMap::Scale::linear;
+        header.stream = rowHeader[3] < numSpectrumStreams ? (SpectrumStream) rowHeader[3] : SpectrumStream::mix;
+        header.sequence = readLittleEndian<juce::uint32> (rowHeader + 4);
+
+        numWritten.store (index + 1, std::memory_order_release);
+        offset += rowHeaderSize + (size_t) width;
+    }
+
+    return restored;
+}
+
+juce::uint64 SpectrogramHistory::read (juce::uint64 since, juce::MemoryBlock& dest, int& numRows) const
+{
+    numRows = 0;
+
+    const auto end = getNumWritten();
+    const auto oldest = end > (juce::uint64) capacity ? end - (juce::uint64) capacity : 0;
+    const auto first = (since < oldest || since > end) ? oldest : since;
+
+    const auto headerOffset = dest.getSize();
+    dest.setSize (headerOffset + headerSize, true);
+
+    juce::uint8 rowHeader[rowHeaderSize];
+    std::vector<juce::uint8> rowData ((size_t) maxRowWidth);
+
+    for (auto index = first; index < end; ++index)
+    {
+        const auto slot = (size_t) (index % (juce::uint64) capacity);
+        const auto header = headers[slot];
+        const auto width = juce::jmin ((int) header.width, maxRowWidth);
+        std::copy_n (rows.data() + slot * (size_t) maxRowWidth, width, rowData.data());
+
+        // The writer only starts overwriting row `index` after publishing index + capacity
+        // rows, so a copy made while fewer are published is intact
+        std::atomic_thread_fence (std::memory_order_acquire);
+
+        if (numWritten.load (std::memory_order_relaxed) >= index + (juce::uint64) capacity)
+        {
+            // Lapped while copying. Rather than send a gap, start again from what is now
+            // the oldest row; this only happens when a reader is a whole ring behind.
+            dest.setSize (headerOffset, false);
+            return read (index + 1, dest, numRows);
+        }
+
+        writeLittleEndian (rowHeader, header.width);
+        rowHeader[2] = (juce::uint8) header.scale;
+        rowHeader[3] = (juce::uint8) header.stream;
+        writeLittleEndian (rowHeader + 4, header.sequence);
+
+        dest.append (rowHeader, rowHeaderSize);
+        dest.append (rowData.data(), (size_t) width);
+        ++numRows;
+    }
+
+    auto* header = static_cast<juce::uint8*> (dest.getData()) + headerOffset;
+    header[0] = 'V';
+    header[1] = 'S';
+    header[2] = currentVersion;
+    header[3] = 0;
+    writeLittleEndian (header + 4, (juce::uint16) numRows);
+    writeLittleEndian (header + 6, (juce::uint16) 0);
+
+    return first;
+}
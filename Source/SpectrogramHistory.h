@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    SpectrogramHistory.h
+    The last few seconds of one stream's frames, quantised, for waterfall views.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+
+//==============================================================================
+/**
+    A fixed ring of rows, one per analysis frame of the chosen stream, kept by
+    the processor whether or not an editor is open. A newly opened editor reads
+    the whole ring at once and from then on asks only for rows it hasn't seen,
+    so steady-state traffic is one row per frame.
+
+    Rows are stored as one byte per value (value * 255, rounded), and frames
+    wider than maxRowWidth are reduced by taking the maximum of each group of
+    bins, so narrow peaks survive. Storage is allocated once and then reused.
+
+    One thread writes (whichever runs the analysis) and any number of readers
+    read, with no locks: rows are written in place and then published by
+    bumping a counter, and a reader checks the counter again after copying a
+    row to make sure the writer hadn't lapped it in the meantime.
+
+    Wire format written by read(), all multi-byte fields little endian:
+
+        0   'V' 'S'         magic
+        2   uint8           format version (currentVersion)
+        3   uint8           reserved, 0
+        4   uint16          number of rows
+        6   uint16          reserved, 0
+        8   rows...         each: uint16 width, uint8 scale (BandMap::Scale),
+                            uint8 stream (SpectrumStream), uint32 frame
+                            sequence (low 32 bits), then `width` bytes
+
+    If this layout changes, bump currentVersion and teach
+    decodeSpectrogramRows() in viber.js about it.
+*/
+class SpectrogramHistory
+{
+public:
+    static constexpr int capacity = 1024;               // rows, about 20 s at 48 kHz with a 1024 hop
+    static constexpr int maxRowWidth = 1024;
+    static constexpr juce::uint8 currentVersion = 1;
+    static constexpr int headerSize = 8;
+    static constexpr int rowHeaderSize = 8;
+
+    /** Allocates the ring the first time, and empties it. Call while nothing is
+        writing, e.g. from prepareToPlay.
+    */
+    void prepare();
+
+    /** Writer: appends one row. Never allocates or blocks. */
+    void write (const float* values, int numValues, BandMap::Scale scale,
+                SpectrumStream stream, juce::uint64 sequence) noexcept;
+
+    /** Writer: appends rows in the wire format above, such as ones saved with the
+        session. Stops at the first row that runs past `size`. Never allocates;
+        does nothing before the first prepare(). Returns the number of rows added.
+    */
+    int restore (const void* data, size_t size) noexcept;
+
+    bool isPrepared() const noexcept  { return ! rows.empty(); }
+
+    /** Rows written since prepare(). Row i is still held if i >= getNumWritten() - capacity. */
+    juce::uint64 getNumWritten() const noexcept  { return numWritten.load (std::memory_order_acquire); }
+
+    /** Reader: appends every row from index `since` on to `dest`, in the wire
+        format above. If `since` is older than the oldest row held, or newer
+        than anything written (the ring was emptied since), it starts from the
+        oldest row instead. Returns the index of the first row written; the
+        next call should pass that plus the number of rows.
+    */
+    juce::uint64 read (juce::uint64 since, juce::MemoryBlock& dest, int& numRows) const;
+
+private:
+    struct RowHeader
+    {
+        juce::uint16 width = 0;
+        BandMap::Scale scale = BandMap::Scale::linear;
+        SpectrumStream stream = SpectrumStream::mix;
+        juce::uint32 sequence = 0;
+    };
+
+    std::vector<RowHeader> headers;
+    std::vector<juce::uint8> rows;                      // capacity rows of maxRowWidth
+    std::atomic<juce::uint64> numWritten { 0 };
+};
@@ -0,0 +1,530 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyser.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumAnalyser.h"
+
+namespace {
+juce::dsp::WindowingFunction<float>::WindowingMethod toWindowingMethod(SpectrumAnalyser::WindowType type)
+{
+    using Method = juce::dsp::WindowingFunction<float>;
+
+    switch (type) {
+        case SpectrumAnalyser::WindowType::hamming:         return Method::hamming;
+        case SpectrumAnalyser::WindowType::blackman:        return Method::blackman;
+        case SpectrumAnalyser::WindowType::blackmanHarris:  return Method::blackmanHarris;
+        case SpectrumAnalyser::WindowType::flatTop:         return Method::flatTop;
+        case SpectrumAnalyser::WindowType::rectangular:     return Method::rectangular;
+        case SpectrumAnalyser::WindowType::hann:
+        default:                                            return Method::hann;
+    }
+}
+} // namespace
+
+//==============================================================================
+SpectrumAnalyser::SpectrumAnalyser()
+{
+    history.resize((size_t) (numStreams * historyStride), 0.0f);
+    fftData.resize(maxFftSize * 2, 0.0f);
+    bands.resize(maxNumBins, 0.0f);
+    display.resize(maxNumBins, 0.0f);
+    peaks.resize(maxNumBins, 0.0f);
+
+    for (auto& stream : ballistics)
+        stream.prepare(maxNumBins);
+
+    // The editor may start polling before prepareToPlay, so the queue is ready from the start.
+    // Slots start at the default FFT size without peaks; the editor resizes them to the frames
+    // actually produced as it reads them, so they never all hold the largest possible frame.
+    frames.prepare(frameQueueCapacity, [](SpectrumFrame& frame) {
+        frame.allocate(Config().getNumBins(), false);
+    });
+
+    levelQueue.prepare(levelQueueCapacity, [](BlockLevels&) {});
+
+    // Reasonable default until the host tells us its block size
+    prepare(512, sampleRate);
+}
+
+SpectrumAnalyser::~SpectrumAnalyser()
+{
+    delete pendingBandMap.exchange(nullptr);
+    delete retiredBandMap.exchange(nullptr);
+    delete activeBandMap;
+    delete pendingSpectrogram.exchange(nullptr);
+    delete retiredSpectrogram.exchange(nullptr);
+}
+
+void SpectrumAnalyser::prepare(int maxBlockSize, double newSampleRate)
+{
+    // The worker may be mid-pass over this analyser, wait for it to let go
+    acquireProcessing();
+
+    sampleRate = newSampleRate;
+    spectrogram.prepare();
+    features.reset(sampleRate);
+
+    for (auto& stream : ballistics)
+        stream.reset();
+
+    // Room for a few blocks of backlog before we drop samples
+    const int capacity = juce::jmax(4 * maxBlockSize, 4 * (1 << defaultFftOrder));
+    ringSize = capacity + 1;
+    inputRing.assign((size_t) (numStreams * ringSize), 0.0f);
+    inputFifo.setTotalSize(ringSize);
+    inputFifo.reset();
+    consumedSamples = 0;
+    droppedSamplesSeen = droppedSamples.load(std::memory_order_relaxed);
+
+    // Levels from before the restart would be stamped on the wrong clock
+    writtenSamples = 0;
+    while (levelQueue.pop([](const BlockLevels&) {})) {}
+    hasHeldLevels = false;
+    hopLevels = {};
+    frameLevels = {};
+
+    // Built here as well as by the worker, so inline and offline runs start with their plan
+    if (const auto order = getInlinePlanOrder(); order != inlinePlanOrder.load(std::memory_order_relaxed)) {
+        auto plan = order != 0 ? std::make_unique<juce::dsp::FFT>(order) : nullptr;
+        installInlinePlan(plan, order);
+    }
+
+    // Forces applyPendingConfig() to rebuild everything for the requested config,
+    // which also clears every stream's history. Off the audio thread, so in worker
+    // mode the shared plan is fine here.
+    config.fftOrder = 0;
+    applyPendingConfig(usesWorkerThread());
+    activeStreams = getStreams();
+
+    releaseProcessing();
+}
+
+void SpectrumAnalyser::acquireProcessing() noexcept
+{
+    // Only used off the audio thread, where briefly yielding is fine
+    while (processing.exchange(true, std::memory_order_acquire))
+        juce::Thread::yield();
+}
+
+void SpectrumAnalyser::releaseProcessing() noexcept
+{
+    processing.store(false, std::memory_order_release);
+}
+
+void SpectrumAnalyser::updateInlinePlan()
+{
+    const auto order = getInlinePlanOrder();
+
+    // Already in, perhaps by prepare(), so any plan built for it isn't needed
+    if (order == inlinePlanOrder.load(std::memory_order_relaxed)) {
+        builtPlan.reset();
+        builtPlanOrder = 0;
+        return;
+    }
+
+    // Built once per order and kept until it goes in, so a busy analyser doesn't cost a
+    // new plan on every pass
+    if (order != builtPlanOrder) {
+        builtPlan = order != 0 ? std::make_unique<juce::dsp::FFT>(order) : nullptr;
+        builtPlanOrder = order;
+    }
+
+    // Try-only, so an inline audio thread is never held up
+    if (processing.exchange(true, std::memory_order_acquire))
+        return;
+
+    installInlinePlan(builtPlan, order);
+    releaseProcessing();
+
+    // The old plan, freed here off the audio thread
+    builtPlan.reset();
+    builtPlanOrder = 0;
+}
+
+void SpectrumAnalyser::installInlinePlan(std::unique_ptr<juce::dsp::FFT>& plan, int order) noexcept
+{
+    // The caller holds the processing flag and frees whatever ends up in `plan`
+    inlinePlan.swap(plan);
+    inlinePlanOrder.store(order, std::memory_order_relaxed);
+
+    // Anyone using the old plan before the next applyPendingConfig() gets the shared one
+    if (fft != nullptr && fft == plan.get())
+        fft = &resources->getFft(config.fftOrder);
+}
+
+void SpectrumAnalyser::setConfig(Config newConfig) noexcept
+{
+    pendingFftOrder.store(juce::jlimit(minFftOrder, maxFftOrder, newConfig.fftOrder), std::memory_order_relaxed);
+    pendingOverlapIndex.store(juce::jlimit(0, maxOverlapIndex, newConfig.overlapIndex), std::memory_order_relaxed);
+    pendingWindow.store(juce::jlimit((int) WindowType::hann, (int) WindowType::rectangular, (int) newConfig.window),
+                        std::memory_order_relaxed);
+}
+
+void SpectrumAnalyser::setBallistics(const SpectrumBallistics::Settings& settings) noexcept
+{
+    pendingAttackMs.store(juce::jmax(0.0f, settings.attackMs), std::memory_order_relaxed);
+    pendingReleaseMs.store(juce::jmax(0.0f, settings.releaseMs), std::memory_order_relaxed);
+    pendingAverageFrames.store(juce::jlimit(1, SpectrumBallistics::maxAverageFrames, settings.averageFrames),
+                               std::memory_order_relaxed);
+    pendingPeakHoldMs.store(juce::jmax(0.0f, settings.peakHoldMs), std::memory_order_relaxed);
+    pendingPeakDecay.store(juce::jmax(0.0f, settings.peakDecayDbPerSecond), std::memory_order_relaxed);
+    pendingPeaks.store(settings.peaks, std::memory_order_relaxed);
+}
+
+SpectrumBallistics::Settings SpectrumAnalyser::getBallistics() const noexcept
+{
+    SpectrumBallistics::Settings settings;
+    settings.attackMs = pendingAttackMs.load(std::memory_order_relaxed);
+    settings.releaseMs = pendingReleaseMs.load(std::memory_order_relaxed);
+    settings.averageFrames = pendingAverageFrames.load(std::memory_order_relaxed);
+    settings.peakHoldMs = pendingPeakHoldMs.load(std::memory_order_relaxed);
+    settings.peakDecayDbPerSecond = pendingPeakDecay.load(std::memory_order_relaxed);
+    settings.peaks = pendingPeaks.load(std::memory_order_relaxed);
+    return settings;
+}
+
+void SpectrumAnalyser::updateBallisticsCoefficients() noexcept
+{
+    // Two exp() calls per hop, so just recompute rather than track what changed
+    const auto frameSeconds = config.getHopSize() / sampleRate;
+    const auto dbRange = displayCeilingDb.load(std::memory_order_relaxed) - displayFloorDb.load(std::memory_order_relaxed);
+    ballisticsCoefficients = SpectrumBallistics::makeCoefficients(getBallistics(), frameSeconds, dbRange);
+}
+
+void SpectrumAnalyser::setBandMap(std::shared_ptr<const BandMap> newMap)
+{
+    // Release whatever the analysis thread has finished with since the last call
+    delete retiredBandMap.exchange(nullptr);
+
+    // If the previous map was never picked up, it's ours to release
+    delete pendingBandMap.exchange(new BandMapHandle(std::move(newMap)));
+}
+
+void SpectrumAnalyser::applyPendingBandMap() noexcept
+{
+    // Only swap when the retired slot is free, so nothing is ever overwritten and leaked
+    if (pendingBandMap.load(std::memory_order_acquire) == nullptr
+        || retiredBandMap.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    auto* previous = activeBandMap;
+    activeBandMap = pendingBandMap.exchange(nullptr, std::memory_order_acq_rel);
+    retiredBandMap.store(previous, std::memory_order_release);
+}
+
+void SpectrumAnalyser::restoreSpectrogram(juce::MemoryBlock savedRows)
+{
+    delete retiredSpectrogram.exchange(nullptr);
+    delete pendingSpectrogram.exchange(new juce::MemoryBlock(std::move(savedRows)));
+}
+
+void SpectrumAnalyser::applyPendingSpectrogram() noexcept
+{
+    // Waits for prepare(), which would empty the history again, and for the retired slot
+    if (! spectrogram.isPrepared() || retiredSpectrogram.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    if (auto* rows = pendingSpectrogram.exchange(nullptr, std::memory_order_acq_rel)) {
+        spectrogram.restore(rows->getData(), rows->getSize());
+        retiredSpectrogram.store(rows, std::memory_order_release);
+    }
+}
+
+void SpectrumAnalyser::applyRequestedStreams() noexcept
+{
+    const auto requested = getStreams();
+
+    // A stream that was off has stale history; start it from silence instead
+    for (int stream = 0; stream < numStreams; ++stream)
+        if ((requested & ~activeStreams & (1u << stream)) != 0)
+            juce::FloatVectorOperations::clear(history.data() + stream * historyStride, historyStride);
+
+    activeStreams = requested;
+}
+
+bool SpectrumAnalyser::applyPendingConfig(bool onWorkerThread) noexcept
+{
+    Config requested;
+    requested.fftOrder = pendingFftOrder.load(std::memory_order_relaxed);
+    requested.overlapIndex = pendingOverlapIndex.load(std::memory_order_relaxed);
+    requested.window = (WindowType) pendingWindow.load(std::memory_order_relaxed);
+
+    // An audio thread must never wait for another instance's transform on a shared plan,
+    // so inline processing holds off until the worker has built a private one
+    if (onWorkerThread)
+        fft = &resources->getFft(requested.fftOrder);
+    else if (inlinePlan != nullptr && inlinePlanOrder.load(std::memory_order_relaxed) == requested.fftOrder)
+        fft = inlinePlan.get();
+    else
+        return false;
+
+    if (requested == config)
+        return true;
+
+    const bool sizeChanged = requested.fftOrder != config.fftOrder;
+    const bool windowChanged = sizeChanged || requested.window != config.window;
+    config = requested;
+
+    if (windowChanged)
+        selectWindow();
+
+    // A new size invalidates the history; a new hop just takes effect from the next frame
+    if (sizeChanged) {
+        std::fill(history.begin(), history.end(), 0.0f);
+        historyIndex = 0;
+        samplesUntilNextFrame = config.getFftSize();
+    } else {
+        samplesUntilNextFrame = juce::jmin(samplesUntilNextFrame, config.getHopSize());
+    }
+
+    return true;
+}
+
+void SpectrumAnalyser::setDisplayRange(float floorDb, float ceilingDb) noexcept
+{
+    jassert(ceilingDb > floorDb);
+    displayFloorDb.store(floorDb, std::memory_order_relaxed);
+    displayCeilingDb.store(ceilingDb, std::memory_order_relaxed);
+}
+
+void SpectrumAnalyser::selectWindow() noexcept
+{
+    // The shared table already carries the per-order calibration, so it is used as is
+    window = resources->getWindow(config.fftOrder, toWindowingMethod(config.window));
+
+    // Nothing is being transformed while the window changes, so fftData is free as scratch
+    features.setWindow(window, config.getFftSize(), *fft, fftData.data());
+}
+
+void SpectrumAnalyser::writeSamples(const StreamPointers& streams, int numSamples) noexcept
+{
+    // One fifo transaction for all streams, so their rows always stay in step
+    const auto scope = inputFifo.write(numSamples);
+    const int written = scope.blockSize1 + scope.blockSize2;
+
+    for (int stream = 0; stream < numStreams; ++stream) {
+        const float* samples = streams[(size_t) stream];
+
+        if (samples == nullptr)
+            continue;
+
+        auto* row = inputRing.data() + stream * ringSize;
+
+        if (scope.blockSize1 > 0)
+            juce::FloatVectorOperations::copy(row + scope.startIndex1, samples, scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            juce::FloatVectorOperations::copy(row + scope.startIndex2, samples + scope.blockSize1, scope.blockSize2);
+    }
+
+    if (written < numSamples)
+        droppedSamples.fetch_add((juce::uint64) (numSamples - written), std::memory_order_relaxed);
+
+    // Dropped samples still move the clock, as they do for consumedSamples
+    writtenSamples += numSamples;
+}
+
+void SpectrumAnalyser::writeLevels(const BlockLevels& levels) noexcept
+{
+    levelQueue.push([this, &levels](BlockLevels& slot) {
+        slot = levels;
+        slot.endPosition = writtenSamples;
+    });
+}
+
+void SpectrumAnalyser::collectLevels() noexcept
+{
+    for (;;) {
+        if (! hasHeldLevels && ! levelQueue.pop([this](const BlockLevels& levels) { heldLevels = levels; }))
+            break;
+
+        hasHeldLevels = true;
+
+        // Still being analysed, so it belongs to a later hop
+        if (heldLevels.endPosition > consumedSamples)
+            break;
+
+        hopLevels.merge(heldLevels);
+        hasHeldLevels = false;
+    }
+
+    if (hopLevels.numSamples > 0) {
+        frameLevels = hopLevels.toMeterLevels();
+        hopLevels = {};
+    }
+}
+
+bool SpectrumAnalyser::processPendingSamples(bool onWorkerThread) noexcept
+{
+    if (processing.exchange(true, std::memory_order_acquire))
+        return false;
+
+    if (! applyPendingConfig(onWorkerThread)) {
+        releaseProcessing();
+        return false;
+    }
+
+    applyPendingBandMap();
+    applyRequestedStreams();
+    applyPendingSpectrogram();
+
+    const int numReady = inputFifo.getNumReady();
+
+    if (numReady > 0) {
+        const auto scope = inputFifo.read(numReady);
+        consumeSamples(scope.startIndex1, scope.blockSize1);
+        consumeSamples(scope.startIndex2, scope.blockSize2);
+    }
+
+    // Samples are only dropped while the ring is full, so they came after everything just
+    // consumed; skip the clock over them to keep later frames on the audio's timeline
+    const auto dropped = droppedSamples.load(std::memory_order_relaxed);
+    consumedSamples += (juce::int64) (dropped - droppedSamplesSeen);
+    droppedSamplesSeen = dropped;
+
+    releaseProcessing();
+    return true;
+}
+
+void SpectrumAnalyser::consumeSamples(int ringStart, int numSamples) noexcept
+{
+    const int fftSize = config.getFftSize();
+
+    // Copy in contiguous chunks, stopping at the end of the history and at each hop.
+    // Every active stream advances by the same chunk, so they all hit the hop together.
+    while (numSamples > 0) {
+        const int toCopy = juce::jmin(numSamples, samplesUntilNextFrame, fftSize - historyIndex);
+
+        for (int stream = 0; stream < numStreams; ++stream) {
+            if ((activeStreams & (1u << stream)) == 0)
+                continue;
+
+            const float* samples = inputRing.data() + stream * ringSize + ringStart;
+            float* row = history.data() + stream * historyStride + historyIndex;
+            juce::FloatVectorOperations::copy(row, samples, toCopy);
+            juce::FloatVectorOperations::copy(row + fftSize, samples, toCopy);
+        }
+
+        historyIndex += toCopy;
+        if (historyIndex == fftSize)
+            historyIndex = 0;
+
+        ringStart += toCopy;
+        numSamples -= toCopy;
+        samplesUntilNextFrame -= toCopy;
+        consumedSamples += toCopy;
+
+        if (samplesUntilNextFrame == 0) {
+            samplesUntilNextFrame = config.getHopSize();
+            processFrame();
+        }
+    }
+}
+
+void SpectrumAnalyser::processFrame() noexcept
+{
+    updateBallisticsCoefficients();
+    collectLevels();
+
+    // Onset and tempo history from another stream would only mislead the tracking
+    if (const auto requested = getFeatureStream(); requested != activeFeatureStream) {
+        activeFeatureStream = requested;
+        features.reset(sampleRate);
+    }
+
+    // The whole batch for this hop shares one plan, window table and band map,
+    // which stay hot in cache from one stream to the next
+    for (int stream = 0; stream < numStreams; ++stream)
+        if ((activeStreams & (1u << stream)) != 0)
+            processStream((Stream) stream);
+
+    ++nextFrameSequence;
+}
+
+void SpectrumAnalyser::processStream(Stream stream) noexcept
+{
+    const int fftSize = config.getFftSize();
+    const int numBins = config.getNumBins();
+    const float* samples = history.data() + (int) stream * historyStride + historyIndex;
+
+    const auto fftStart = PerfTelemetry::now();
+
+    // Window and scale the latest fftSize samples in one vector multiply, straight into
+    // the FFT work buffer, then clear the upper half so the transform sees a clean
+    // real-valued input
+    juce::FloatVectorOperations::multiply(fftData.data(), samples, window, fftSize);
+    juce::FloatVectorOperations::clear(fftData.data() + fftSize, fftSize);
+
+    // Perform FFT (in-place, frequency-only optimized output)
+    fft->performFrequencyOnlyForwardTransform(fftData.data());
+
+    const auto decibelsStart = PerfTelemetry::now();
+
+    // Reduce to display bands before the dB conversion, so it runs on fewer values
+    const float* magnitudes = fftData.data();
+    int numValues = numBins;
+    auto scale = BandMap::Scale::linear;
+
+    const BandMap* bandMap = activeBandMap != nullptr ? activeBandMap->get() : nullptr;
+
+    if (bandMap != nullptr && ! bandMap->isPassthrough()) {
+        numValues = bandMap->getNumBands(config.fftOrder);
+        bandMap->apply(config.fftOrder, fftData.data(), bands.data());
+        magnitudes = bands.data();
+        scale = bandMap->getLayout().scale;
+    }
+
+    // Convert to dB and normalise to [0,1] over the display range (-100 dB -> 0, 0 dB -> 1 by default)
+    SpectrumKernels::magnitudesToNormalisedDb(magnitudes, display.data(), numValues,
+                                              displayFloorDb.load(std::memory_order_relaxed),
+                                              displayCeilingDb.load(std::memory_order_relaxed));
+
+    const auto samplePosition = consumedSamples - fftSize / 2;
+
+    // Features come from the same transform, before ballistics smear the onsets. This is
+    // the last use of the magnitudes, so the pitch estimate may reuse fftData.
+    const bool withFeatures = (int) stream == activeFeatureStream;
+
+    if (withFeatures)
+        features.process(fftData.data(), fftSize, *fft, display.data(), numValues, samplePosition);
+
+    // Averaging, attack/release and peak hold, on the normalised values
+    const bool withPeaks = ballisticsCoefficients.peaks;
+    ballistics[(size_t) stream].process(display.data(), withPeaks ? peaks.data() : nullptr, numValues,
+                                        ballisticsCoefficients);
+
+    const auto publishTicks = PerfTelemetry::now();
+
+    if (telemetry != nullptr) {
+        telemetry->recordBetween(PerfTelemetry::Stage::fft, fftStart, decibelsStart);
+        telemetry->recordBetween(PerfTelemetry::Stage::decibels, decibelsStart, publishTicks);
+    }
+
+    if (stream == getSpectrogramStream())
+        spectrogram.write(display.data(), numValues, scale, stream, nextFrameSequence);
+
+    // Hand the frame to the editor. If it has fallen behind the frame is dropped and counted.
+    const auto fill = [this, numValues, scale, stream, withPeaks, withFeatures, samplePosition](SpectrumFrame& frame) {
+        frame.setBins(display.data(), numValues);
+        frame.setPeaks(withPeaks ? peaks.data() : nullptr);
+        frame.scale = scale;
+        frame.stream = stream;
+        frame.sequence = nextFrameSequence;
+        frame.analysedTicks = publishTicks;
+        frame.samplePosition = samplePosition;
+        frame.hostPosition = -1;
+        frame.levels = frameLevels;
+        frame.hasFeatures = withFeatures;
+        frame.features = withFeatures ? features.getFeatures() : AudioFeatures();
+    };
+
+    frames.push(fill);
+
+    // The capture takes its own copy, so it records whether or not the editor keeps up
+    if (capture != nullptr)
+        capture->writeFrame(fill);
+}
@@ -0,0 +1,327 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyser.h
+    Block-based FFT analysis front end feeding the editor's frame queue.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+#include "SpectrumKernels.h"
+#include "BandMap.h"
+#include "AnalysisResources.h"
+#include "PerfTelemetry.h"
+#include "AnalysisCapture.h"
+#include "SpectrumBallistics.h"
+#include "SpectrogramHistory.h"
+#include "GainStage.h"
+#include "SpectrumFeatures.h"
+
+//==============================================================================
+/**
+    A short-time Fourier transform over up to numStreams parallel streams (mix,
+    left, right, mid, side and sidechain). Every hopSize samples it windows the
+    most recent fftSize samples of each enabled stream, runs the FFTs back to
+    back with the same plan and window table, and publishes one normalised
+    display frame per stream, all with the same sequence number.
+
+    The input ring and the history are laid out as one contiguous row per stream
+    sharing a single set of indices, so a block for all streams is written with
+    one fifo transaction and a hop covers every stream at once. Streams that
+    nobody subscribed to are neither written nor transformed. One stream can also
+    be reduced to audio features (SpectrumFeatures) from the same transform.
+
+    FFT order, overlap and window type can be changed at any time through
+    setConfig(). FFT plans, window tables and band maps come from the
+    process-wide AnalysisResources, and the largest buffers are allocated up
+    front, so a config change is a lookup and never allocates. What each
+    analyser owns is only its mutable state: rings, work buffers and history.
+    Frame queue slots are sized for the frames actually produced, and resized
+    by the consumer (see SpectrumFrame). The one exception is inline mode, which transforms with a private plan for
+    the current FFT order, so that no audio thread ever waits for another
+    instance's transform on a shared one. The worker builds it.
+
+    The audio thread only ever calls writeSamples(), which copies the block into
+    a lock-free input ring. The FFT work happens in processPendingSamples(),
+    which either the audio thread calls straight afterwards (inline mode) or the
+    shared AnalysisWorker calls from its own thread (worker mode). A try-only
+    ownership flag makes sure just one thread runs the analysis at a time, so
+    switching modes while playing is safe and nobody ever blocks.
+*/
+class SpectrumAnalyser
+{
+public:
+    static constexpr int minFftOrder = AnalysisResources::minFftOrder;
+    static constexpr int maxFftOrder = AnalysisResources::maxFftOrder;
+    static constexpr int defaultFftOrder = 10;      // 1024 samples
+    static constexpr int maxFftSize = 1 << maxFftOrder;
+    static constexpr int maxNumBins = maxFftSize / 2;
+    static constexpr int maxOverlapIndex = 3;       // hop = fftSize >> overlapIndex, so 0..87.5% overlap
+    static constexpr int numStreams = numSpectrumStreams;
+    static constexpr int frameQueueCapacity = 8 * numStreams;
+    static constexpr int levelQueueCapacity = 256;  // blocks, enough for the input ring full of tiny ones
+
+    using Stream = SpectrumStream;
+
+    /** One pointer per stream for writeSamples(); nullptr for streams not provided. */
+    using StreamPointers = std::array<const float*, numStreams>;
+
+    static constexpr juce::uint32 streamBit (Stream s) noexcept  { return 1u << (int) s; }
+    static constexpr juce::uint32 allStreams = (1u << numStreams) - 1;
+    static constexpr juce::uint32 defaultStreams = 1u << (int) Stream::mix;
+
+    enum class WindowType
+    {
+        hann,
+        hamming,
+        blackman,
+        blackmanHarris,
+        flatTop,
+        rectangular
+    };
+
+    struct Config
+    {
+        int fftOrder = defaultFftOrder;
+        int overlapIndex = 0;
+        WindowType window = WindowType::hann;
+
+        int getFftSize() const noexcept   { return 1 << fftOrder; }
+        int getHopSize() const noexcept   { return getFftSize() >> overlapIndex; }
+        int getNumBins() const noexcept   { return getFftSize() / 2; }
+
+        bool operator== (const Config& other) const noexcept
+        {
+            return fftOrder == other.fftOrder && overlapIndex == other.overlapIndex && window == other.window;
+        }
+
+        bool operator!= (const Config& other) const noexcept  { return ! operator== (other); }
+    };
+
+    SpectrumAnalyser();
+    ~SpectrumAnalyser();
+
+    /** Sizes the input ring for the host's block size and forgets any partially
+        collected frame and ballistics history. Call from prepareToPlay, while the
+        audio thread is stopped. The sample rate turns ballistics times into frames.
+    */
+    void prepare (int maxBlockSize, double sampleRate);
+
+    /** Audio thread: appends numSamples of every stream to the input ring. Streams
+        with a nullptr entry are skipped; pass everything in getStreams(). If the
+        analysis has fallen too far behind the samples are dropped and counted.
+    */
+    void writeSamples (const StreamPointers& streams, int numSamples) noexcept;
+
+    /** Audio thread: the gain stage's levels for the block just written with
+        writeSamples(). Frames carry the levels of every block that ended since the
+        previous hop, or the previous hop's when none did. If the queue is full the
+        block's levels are dropped.
+    */
+    void writeLevels (const BlockLevels& levels) noexcept;
+
+    /** Which streams to analyse, as a mask of streamBit() values. Safe to call from
+        any thread. A newly enabled stream starts from silence at the next batch; its
+        first frame may also pick up a little older audio from the same stream.
+    */
+    void setStreams (juce::uint32 streamMask) noexcept  { requestedStreams.store (streamMask & allStreams, std::memory_order_relaxed); }
+    juce::uint32 getStreams() const noexcept            { return requestedStreams.load (std::memory_order_relaxed); }
+
+    /** Runs the FFT on everything waiting in the input ring. Returns false without
+        doing anything if another thread is already processing this analyser, or if
+        an inline call finds no private plan for the FFT order yet; the samples then
+        wait in the ring for the next call. The AnalysisWorker passes true, which
+        uses the shared plans instead.
+    */
+    bool processPendingSamples (bool onWorkerThread) noexcept;
+
+    /** AnalysisWorker thread, outside any realtime section: builds the private plan
+        inline processing needs for the requested FFT order, or frees it in worker
+        mode. Try-only, like processPendingSamples(); for a busy analyser the built
+        plan is kept and goes in on a later pass. prepare() builds it too, so inline
+        and offline runs start with it.
+    */
+    void updateInlinePlan();
+
+    /** When true, processBlock leaves processPendingSamples() to the AnalysisWorker. */
+    void setUseWorkerThread (bool shouldUseWorker) noexcept   { useWorkerThread.store (shouldUseWorker); }
+    bool usesWorkerThread() const noexcept                    { return useWorkerThread.load(); }
+
+    /** The dB range mapped onto 0..1 in display frames. Safe to call from any thread;
+        the new range is picked up at the start of the next frame.
+    */
+    void setDisplayRange (float floorDb, float ceilingDb) noexcept;
+
+    /** Requests a new STFT configuration. Safe to call from any thread, including
+        every processBlock; the analysis picks it up before its next batch of samples.
+        Values are clamped to the supported ranges.
+    */
+    void setConfig (Config newConfig) noexcept;
+
+    /** Requests new smoothing, averaging and peak-hold settings for every stream.
+        Safe to call from any thread; applied from the next frame.
+    */
+    void setBallistics (const SpectrumBallistics::Settings& settings) noexcept;
+    SpectrumBallistics::Settings getBallistics() const noexcept;
+
+    /** Message thread: replaces the bin-to-band reduction applied before frames are
+        published, usually one from AnalysisResources::getBandMap(). The analysis thread
+        swaps it in before its next batch of samples; the old one is released on a later
+        call here, never on the analysis thread.
+    */
+    void setBandMap (std::shared_ptr<const BandMap> newMap);
+
+    SpectrumFrameQueue& getFrameQueue() noexcept  { return frames; }
+
+    /** The last SpectrogramHistory::capacity frames of one stream, for waterfall views.
+        Readable from any thread. prepare() empties it.
+    */
+    const SpectrogramHistory& getSpectrogramHistory() const noexcept  { return spectrogram; }
+
+    /** Message thread: rows saved from a SpectrogramHistory, in its read() format,
+        for the analysis thread to append before its next batch once prepare() has
+        run, so a restored session starts with the waterfall it was saved with.
+        The copy is released on the next call here.
+    */
+    void restoreSpectrogram (juce::MemoryBlock savedRows);
+
+    /** Which stream the spectrogram history records, mix by default. Any thread.
+        The stream also has to be one of the subscribed ones.
+    */
+    void setSpectrogramStream (Stream stream) noexcept  { spectrogramStream.store (stream, std::memory_order_relaxed); }
+    Stream getSpectrogramStream() const noexcept        { return spectrogramStream.load (std::memory_order_relaxed); }
+
+    /** Which stream's frames carry audio features, as a Stream value, or -1 for none,
+        the default. Any thread. The stream also has to be one of the subscribed ones.
+        Switching starts the onset and tempo tracking over.
+    */
+    void setFeatureStream (int streamOrNone) noexcept  { featureStream.store (juce::jlimit (-1, numStreams - 1, streamOrNone), std::memory_order_relaxed); }
+    int getFeatureStream() const noexcept              { return featureStream.load (std::memory_order_relaxed); }
+
+    /** Where the FFT and dB stages record their timings, or nullptr for nowhere.
+        Set it before the analysis first runs; it must outlive the analyser.
+    */
+    void setTelemetry (PerfTelemetry* newTelemetry) noexcept  { telemetry = newTelemetry; }
+
+    /** Where published frames are also recorded while it is recording, or nullptr.
+        Set it before the analysis first runs; it must outlive the analyser.
+    */
+    void setCapture (AnalysisCapture* newCapture) noexcept  { capture = newCapture; }
+
+    /** Samples lost because the input ring was full. */
+    juce::uint64 getNumDroppedSamples() const noexcept  { return droppedSamples.load (std::memory_order_relaxed); }
+
+private:
+    void consumeSamples (int ringStart, int numSamples) noexcept;
+    void processFrame() noexcept;
+    void processStream (Stream stream) noexcept;
+    bool applyPendingConfig (bool onWorkerThread) noexcept;
+    void applyPendingBandMap() noexcept;
+    void applyRequestedStreams() noexcept;
+    void applyPendingSpectrogram() noexcept;
+    void collectLevels() noexcept;
+    void selectWindow() noexcept;
+    void updateBallisticsCoefficients() noexcept;
+
+    void acquireProcessing() noexcept;
+    void releaseProcessing() noexcept;
+    int getInlinePlanOrder() const noexcept  { return usesWorkerThread() ? 0 : pendingFftOrder.load (std::memory_order_relaxed); }
+    void installInlinePlan (std::unique_ptr<juce::dsp::FFT>& plan, int order) noexcept;
+
+    // Plans and window tables shared with every other analyser in the process
+    juce::SharedResourcePointer<AnalysisResources> resources;
+    const juce::dsp::FFT* fft = nullptr;    // the shared plan, or inlinePlan on an audio thread
+    const float* window = nullptr;          // the shared table for the current order
+
+    // Swapped only by whoever holds the processing flag, so the audio thread never frees it
+    std::unique_ptr<juce::dsp::FFT> inlinePlan;
+    std::atomic<int> inlinePlanOrder { 0 }; // 0 when there is none
+
+    // AnalysisWorker thread only: the plan for builtPlanOrder, held until the flag is free
+    std::unique_ptr<juce::dsp::FFT> builtPlan;
+    int builtPlanOrder = 0;
+
+    Config config;                          // owned by whichever thread is processing
+    std::atomic<int> pendingFftOrder { defaultFftOrder };
+    std::atomic<int> pendingOverlapIndex { 0 };
+    std::atomic<int> pendingWindow { (int) WindowType::hann };
+
+    std::atomic<juce::uint32> requestedStreams { defaultStreams };
+    juce::uint32 activeStreams = 0;         // owned by whichever thread is processing
+
+    // Input ring between writeSamples() and processPendingSamples(): numStreams rows of
+    // ringSize samples, all driven by the one fifo
+    juce::AbstractFifo inputFifo { 1 };
+    std::vector<float> inputRing;
+    int ringSize = 0;
+    std::atomic<juce::uint64> droppedSamples { 0 };
+
+    std::atomic<bool> processing { false };
+    std::atomic<bool> useWorkerThread { false };
+
+    // The last fftSize samples of each stream, written twice (at i and i + fftSize) so
+    // the current frame is always one contiguous span starting at historyIndex.
+    // One row of historyStride samples per stream.
+    static constexpr int historyStride = 2 * maxFftSize;
+    std::vector<float> history;
+    std::vector<float> fftData;         // 2 * fftSize work buffer for the in-place transform
+    std::vector<float> bands;           // band magnitudes when a BandMap is active
+    std::vector<float> display;         // normalised 0..1 values for the frame being built
+    std::vector<float> peaks;           // peak values for the frame being built
+    int historyIndex = 0;
+    int samplesUntilNextFrame = 0;
+
+    // Input position in samples since prepare(), counting dropped samples, which frames are
+    // stamped with so the editor can line them up with the audio
+    juce::int64 consumedSamples = 0;
+    juce::uint64 droppedSamplesSeen = 0;
+    juce::int64 writtenSamples = 0;         // the audio thread's side of the same clock
+
+    // Per-block levels from the gain stage. The analysis thread holds back the first block
+    // that ends after the current hop, and merges the rest into the levels for the frame.
+    RealtimeQueue<BlockLevels> levelQueue;
+    BlockLevels heldLevels, hopLevels;
+    bool hasHeldLevels = false;
+    MeterLevels frameLevels;
+    std::atomic<float> displayFloorDb { SpectrumKernels::defaultFloorDb };
+    std::atomic<float> displayCeilingDb { SpectrumKernels::defaultCeilingDb };
+    double sampleRate = 44100.0;
+
+    // Ballistics settings as requested from any thread; turned into coefficients once per hop
+    std::atomic<float> pendingAttackMs { 0.0f }, pendingReleaseMs { 0.0f };
+    std::atomic<float> pendingPeakHoldMs { 0.0f }, pendingPeakDecay { 0.0f };
+    std::atomic<int> pendingAverageFrames { 1 };
+    std::atomic<bool> pendingPeaks { false };
+    std::array<SpectrumBallistics, numStreams> ballistics;
+    SpectrumBallistics::Coefficients ballisticsCoefficients;
+
+    // Band map hand-off: the message thread fills pendingBandMap and frees retiredBandMap,
+    // which drops this analyser's reference to a map other instances may still share;
+    // the analysis thread moves pending -> active -> retired. Nobody waits on anybody.
+    using BandMapHandle = std::shared_ptr<const BandMap>;
+    std::atomic<BandMapHandle*> pendingBandMap { nullptr };
+    std::atomic<BandMapHandle*> retiredBandMap { nullptr };
+    BandMapHandle* activeBandMap = nullptr;
+
+    SpectrumFrameQueue frames;
+    juce::uint64 nextFrameSequence = 0;
+    SpectrogramHistory spectrogram;
+    std::atomic<Stream> spectrogramStream { Stream::mix };
+
+    SpectrumFeatures features { maxFftSize };
+    std::atomic<int> featureStream { -1 };
+    int activeFeatureStream = -1;           // owned by whichever thread is processing
+
+    // Saved rows to restore, handed over like band maps: the message thread allocates and
+    // frees, the analysis thread only moves pending -> retired
+    std::atomic<juce::MemoryBlock*> pendingSpectrogram { nullptr };
+    std::atomic<juce::MemoryBlock*> retiredSpectrogram { nullptr };
+    PerfTelemetry* telemetry = nullptr;
+    AnalysisCapture* capture = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyser)
+};
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    SpectrumBallistics.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumBallistics.h"
+
+namespace {
+// Fraction of the gap a one-pole follower closes in one frame, for a time
+// constant in milliseconds. 0 ms closes all of it.
+float getFollowerCoefficient (float timeMs, double frameSeconds) noexcept
+{
+    if (timeMs <= 0.0f || frameSeconds <= 0.0)
+        return 1.0f;
+
+    return (float) (1.0 - std::exp (-frameSeconds * 1000.0 / (double) timeMs));
+}
+} // namespace
+
+//==============================================================================
+SpectrumBallistics::Settings SpectrumBallistics::getProfileSettings (Profile profile) noexcept
+{
+    Settings settings;
+
+    switch (profile)
+    {
+        case Profile::smooth:
+            settings.attackMs = 10.0f;
+            settings.releaseMs = 300.0f;
+            break;
+
+        case Profile::average:
+            settings.averageFrames = 4;
+            settings.releaseMs = 100.0f;
+            settings.attackMs = 100.0f;
+            break;
+
+        case Profile::peakHold:
+            settings.peaks = true;
+            settings.peakHoldMs = 500.0f;
+            settings.peakDecayDbPerSecond = 20.0f;
+            break;
+
+        case Profile::off:
+            break;
+    }
+
+    return settings;
+}
+
+const juce::StringArray& SpectrumBallistics::getProfileNames()
+{
+    static const juce::StringArray names { "off", "smooth", "average", "peakhold" };
+    return names;
+}
+
+SpectrumBallistics::Profile SpectrumBallistics::profileFromName (const juce::String& name)
+{
+    return (Profile) juce::jmax (0, getProfileNames().indexOf (name.toLowerCase()));
+}
+
+SpectrumBallistics::Coefficients SpectrumBallistics::makeCoefficients (const Settings& settings,
+                                                                       double frameSeconds, float dbRange) noexcept
+{
+    Coefficients coefficients;
+    coefficients.attack = getFollowerCoefficient (settings.attackMs, frameSeconds);
+    coefficients.release = getFollowerCoefficient (settings.releaseMs, frameSeconds);
+    coefficients.averageFrames = juce::jlimit (1, maxAverageFrames, settings.averageFrames);
+    coefficients.peaks = settings.peaks;
+
+    if (frameSeconds > 0.0)
+        coefficients.holdFrames = (float) std::ceil (settings.peakHoldMs * 0.001 / frameSeconds);
+
+    // No decay rate means the peak drops straight back after the hold
+    if (settings.peakDecayDbPerSecond > 0.0f && dbRange > 0.0f)
+        coefficients.peakDecay = (float) (settings.peakDecayDbPerSecond * frameSeconds / dbRange);
+
+    return coefficients;
+}
+
+//==============================================================================
+void SpectrumBallistics::prepare (int newMaxValues)
+{
+    maxValues = newMaxValues;
+    averageRing.assign ((size_t) (maxAverageFrames * maxValues), 0.0f);
+    averageSum.assign ((size_t) maxValues, 0.0f);
+    smoothed.assign ((size_t) maxValues, 0.0f);
+    peakValues.assign ((size_t) maxValues, 0.0f);
+    peakHold.assign ((size_t) maxValues, 0.0f);
+    reset();
+}
+
+void SpectrumBallistics::restart (const float* values, int numValues, int averageFrames) noexcept
+{
+    numActiveValues = numValues;
+    activeAverageFrames = averageFrames;
+    nextAverageRow = 0;
+
+    for (int row = 0; row < averageFrames; ++row)
+        juce::FloatVectorOperations::copy (averageRing.data() + row * maxValues, values, numValues);
+
+    juce::FloatVectorOperations::copyWithMultiply (averageSum.data(), values, (float) averageFrames, numValues);
+    juce::FloatVectorOperations::copy (smoothed.data(), values, numValues);
+    juce::FloatVectorOperations::copy (peakValues.data(), values, numValues);
+    juce::FloatVectorOperations::clear (peakHold.data(), numValues);
+    peaksActive = smoothingActive = true;
+}
+
+void SpectrumBallistics::process (float* values, float* peaks, int numValues,
+                                  const Coefficients& coefficients) noexcept
+{
+    jassert (numValues <= maxValues);
+    numValues = juce::jmin (numValues, maxValues);
+
+    if (numValues != numActiveValues || coefficients.averageFrames != activeAverageFrames)
+        restart (values, numValues, coefficients.averageFrames);
+
+    // Running mean: swap the oldest row out of the sum for this frame
+    if (activeAverageFrames > 1)
+    {
+        auto* oldest = averageRing.data() + nextAverageRow * maxValues;
+        auto* sum = averageSum.data();
+        const auto scale = 1.0f / (float) activeAverageFrames;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            sum[i] += values[i] - oldest[i];
+            oldest[i] = values[i];
+            values[i] = std::max (sum[i] * scale, 0.0f);
+        }
+
+        nextAverageRow = (nextAverageRow + 1) % activeAverageFrames;
+    }
+
+    // A stage that was switched off picks up from the current frame, not from stale state
+    if (coefficients.peaks && ! peaksActive)
+    {
+        juce::FloatVectorOperations::copy (peakValues.data(), values, numValues);
+        juce::FloatVectorOperations::clear (peakHold.data(), numValues);
+    }
+
+    const bool smoothing = coefficients.attack < 1.0f || coefficients.release < 1.0f;
+
+    if (smoothing && ! smoothingActive)
+        juce::FloatVectorOperations::copy (smoothed.data(), values, numValues);
+
+    peaksActive = coefficients.peaks;
+    smoothingActive = smoothing;
+
+    // Peaks follow the average, not the smoothed values, so short transients still register
+    if (coefficients.peaks && peaks != nullptr)
+    {
+        auto* peak = peakValues.data();
+        auto* hold = peakHold.data();
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            const bool rising = values[i] >= peak[i];
+            hold[i] = rising ? coefficients.holdFrames : hold[i] - 1.0f;
+            const auto decayed = hold[i] > 0.0f ? peak[i] : peak[i] - coefficients.peakDecay;
+            peak[i] = std::max (decayed, values[i]);
+        }
+
+        juce::FloatVectorOperations::copy (peaks, peak, numValues);
+    }
+
+    // One-pole follower with the coefficient picked per value by direction
+    if (smoothing)
+    {
+        auto* state = smoothed.data();
+        const auto attack = coefficients.attack;
+        const auto release = coefficients.release;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            const auto difference = values[i] - state[i];
+            const auto coefficient = difference > 0.0f ? attack : release;
+            state[i] += difference * coefficient;
+            values[i] = state[i];
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    SpectrumBallistics.h
+    Frame-to-frame averaging, attack/release smoothing and peak hold for one
+    stream of display frames.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Runs after the dB conversion, on normalised 0..1 display values, so sketches
+    get ready-to-draw data instead of each keeping its own history and filters.
+    Three stages, each one branchless pass over contiguous arrays:
+
+      - average: the mean of the last averageFrames frames
+      - smooth: a one-pole follower towards the average, with separate attack
+        (rising) and release (falling) times
+      - peaks: each value's highest recent average, held for peakHoldMs and then
+        falling at peakDecayDbPerSecond
+
+    All state is allocated in prepare(), so process() never allocates. When the
+    number of values changes (a new FFT size or band layout) the state restarts
+    from the incoming frame rather than blending unrelated bins.
+*/
+class SpectrumBallistics
+{
+public:
+    static constexpr int maxAverageFrames = 8;
+
+    enum class Profile
+    {
+        off,            // values pass straight through
+        smooth,         // fast attack, slow release, like a VU-style analyser
+        average,        // mean of the last few frames, for steady noise-like material
+        peakHold        // raw values plus held, decaying peaks
+    };
+
+    struct Settings
+    {
+        float attackMs = 0.0f;              // 0 follows rises instantly
+        float releaseMs = 0.0f;             // 0 follows falls instantly
+        int averageFrames = 1;              // 1..maxAverageFrames
+        bool peaks = false;                 // compute and publish peak values
+        float peakHoldMs = 0.0f;
+        float peakDecayDbPerSecond = 0.0f;
+
+        bool operator== (const Settings& other) const noexcept
+        {
+            return attackMs == other.attackMs && releaseMs == other.releaseMs
+                && averageFrames == other.averageFrames && peaks == other.peaks
+                && peakHoldMs == other.peakHoldMs && peakDecayDbPerSecond == other.peakDecayDbPerSecond;
+        }
+
+        bool operator!= (const Settings& other) const noexcept  { return ! operator== (other); }
+    };
+
+    static Settings getProfileSettings (Profile profile) noexcept;
+
+    /** The frontend's names for the profiles, in Profile order. */
+    static const juce::StringArray& getProfileNames();
+
+    /** Parses a name from getProfileNames(). Anything else is Profile::off. */
+    static Profile profileFromName (const juce::String& name);
+
+    /** Per-frame multipliers derived from Settings for one frame rate and dB range. */
+    struct Coefficients
+    {
+        float attack = 1.0f;                // fraction of the gap closed per frame when rising
+        float release = 1.0f;               // ... and when falling
+        float holdFrames = 0.0f;
+        float peakDecay = 1.0f;             // normalised units lost per frame after the hold
+        int averageFrames = 1;
+        bool peaks = false;
+    };
+
+    static Coefficients makeCoefficients (const Settings& settings, double frameSeconds, float dbRange) noexcept;
+
+    //==============================================================================
+    SpectrumBallistics() = default;
+
+    /** Allocates state for frames of up to maxValues. Not realtime safe. */
+    void prepare (int maxValues);
+
+    /** Forgets all history; the next frame starts everything afresh. */
+    void reset() noexcept   { numActiveValues = 0; }
+
+    /** Applies the ballistics to `values` in place and, if coefficients.peaks is
+        set, writes the peaks to `peaks`. numValues must be at most maxValues.
+    */
+    void process (float* values, float* peaks, int numValues, const Coefficients& coefficients) noexcept;
+
+private:
+    void restart (const float* values, int numValues, int averageFrames) noexcept;
+
+    std::vector<float> averageRing;     // maxAverageFrames rows of maxValues
+    std::vector<float> averageSum;
+    std::vector<float> smoothed;
+    std::vector<float> peakValues;
+    std::vector<float> peakHold;        // frames of hold left, as floats so the peak pass vectorises
+    int maxValues = 0;
+    int numActiveValues = 0;            // 0 until the first frame after a reset
+    int activeAverageFrames = 1;
+    int nextAverageRow = 0;
+    bool peaksActive = false, smoothingActive = false;
+};
@@ -0,0 +1,426 @@
+/*
+  ==============================================================================
+
+    SpectrumFeatures.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumFeatures.h"
+
+namespace {
+// Total power of a sine whose peak bin reads -100 dB, the default display floor; anything
+// quieter has no shape. The window tables keep magnitudes on the display's dB scale at
+// every FFT size, so one threshold holds for every order.
+constexpr float silentPower = 1.0e-5f * 1.0e-5f;
+
+// Keeps fastLog2 on normal floats for bins that are exactly zero
+constexpr float powerFloor = 1.0e-20f;
+
+// Turns the fftSize magnitudes at the start of `data` (2 * fftSize floats) into the
+// circular autocorrelation of the frame they came from: squared, they are its power
+// spectrum, and the inverse transform of that is the autocorrelation (Wiener-Khinchin)
+void magnitudesToAutocorrelation (float* data, int fftSize, const juce::dsp::FFT& fft) noexcept
+{
+    // Interleaved complex, filled from the top so no magnitude is overwritten before it's read
+    for (int k = fftSize; --k >= 0;)
+    {
+        const auto magnitude = data[k];
+        data[2 * k] = magnitude * magnitude;
+        data[2 * k + 1] = 0.0f;
+    }
+
+    fft.performRealOnlyInverseTransform (data);
+}
+
+// Where the parabola through (-1, a), (0, b) and (1, c) peaks or dips, relative to the middle
+float parabolicOffset (float a, float b, float c) noexcept
+{
+    const auto curvature = a - 2.0f * b + c;
+    return curvature != 0.0f ? juce::jlimit (-0.5f, 0.5f, 0.5f * (a - c) / curvature) : 0.0f;
+}
+} // namespace
+
+//==============================================================================
+SpectrumFeatures::SpectrumFeatures (int maxFftSize)
+    : windowCorrelation ((size_t) maxFftSize / 2, 0.0f),
+      difference ((size_t) maxFftSize / 2, 0.0f),
+      previous ((size_t) maxFftSize / 2, 0.0f)
+{
+    // A log-Gaussian an octave wide around preferredBeatLag, so double or half the tempo
+    // only wins when its beats are clearly stronger
+    for (int lag = 1; lag < (int) tempoWeights.size(); ++lag)
+    {
+        const auto octaves = std::log2 ((double) lag / preferredBeatLag);
+        tempoWeights[(size_t) lag] = (float) std::exp (-0.5 * octaves * octaves);
+    }
+}
+
+void SpectrumFeatures::reset (double newSampleRate) noexcept
+{
+    sampleRate = newSampleRate;
+    features = {};
+
+    numPrevious = 0;
+    fluxAverage = 0.0f;
+    onsetArmed = true;
+    lastOnset = std::numeric_limits<juce::int64>::min() / 2;
+    lastPosition = -1;
+
+    envelope.fill (0.0f);
+    lastTick = -1;
+    numTicks = 0;
+    ticksUntilTempo = tempoUpdateTicks;
+    beatPeriodTicks = 0.0;
+    tempoConfidence = 0.0;
+    nextBeat = 0.0;
+    lastBeat = std::numeric_limits<double>::lowest() / 2;
+}
+
+void SpectrumFeatures::setWindow (const float* window, int fftSize, const juce::dsp::FFT& fft, float* work) noexcept
+{
+    jassert (fftSize / 2 <= (int) windowCorrelation.size());
+    windowSize = fftSize;
+
+    juce::FloatVectorOperations::copy (work, window, fftSize);
+    juce::FloatVectorOperations::clear (work + fftSize, fftSize);
+    fft.performFrequencyOnlyForwardTransform (work);
+    magnitudesToAutocorrelation (work, fftSize, fft);
+
+    // Normalised to 1 at lag 0, so any gain folded into the window drops out
+    if (work[0] > 0.0f)
+        juce::FloatVectorOperations::multiply (windowCorrelation.data(), work, 1.0f / work[0], fftSize / 2);
+    else
+        juce::FloatVectorOperations::clear (windowCorrelation.data(), fftSize / 2);
+}
+
+const AudioFeatures& SpectrumFeatures::process (float* fftData, int fftSize, const juce::dsp::FFT& fft,
+                                                const float* normalised, int numValues,
+                                                juce::int64 samplePosition) noexcept
+{
+    // The clock went backwards, so the analyser was re-prepared
+    if (samplePosition < lastPosition)
+        reset (sampleRate);
+
+    measureShape (fftData, fftSize / 2);
+    measureFlux (normalised, numValues);
+    measurePitch (fftData, fftSize, fft);
+    detectOnset (samplePosition);
+    updateEnvelope (samplePosition);
+    trackBeats (samplePosition);
+
+    lastPosition = samplePosition;
+    return features;
+}
+
+//==============================================================================
+void SpectrumFeatures::measureShape (const float* magnitudes, int numBins) noexcept
+{
+    // DC says nothing about the shape, so every sum starts at bin 1
+    float sum = 0.0f, weighted = 0.0f, power = 0.0f, logPower = 0.0f;
+
+    for (int k = 1; k < numBins; ++k)
+    {
+        const auto magnitude = magnitudes[k];
+        const auto binPower = magnitude * magnitude;
+        sum += magnitude;
+        weighted += (float) k * magnitude;
+        power += binPower;
+        logPower += SpectrumKernels::fastLog2 (binPower + powerFloor);
+    }
+
+    if (power < silentPower)
+    {
+        features.centroidHz = features.rolloffHz = features.flatness = 0.0f;
+        return;
+    }
+
+    const auto binHz = (float) (sampleRate / (2 * numBins));
+    const auto numSummed = (float) (numBins - 1);
+    features.centroidHz = binHz * weighted / sum;
+
+    // Geometric over arithmetic mean of the power
+    features.flatness = juce::jlimit (0.0f, 1.0f, std::exp2 (logPower / numSummed) / (power / numSummed));
+
+    const auto target = rolloffFraction * power;
+    auto cumulative = 0.0f;
+    int k = 1;
+
+    for (; k < numBins - 1; ++k)
+    {
+        cumulative += magnitudes[k] * magnitudes[k];
+
+        if (cumulative >= target)
+            break;
+    }
+
+    features.rolloffHz = binHz * (float) k;
+}
+
+void SpectrumFeatures::measureFlux (const float* normalised, int numValues) noexcept
+{
+    // A new band layout or FFT size isn't a change in the audio
+    if (numValues != numPrevious || numValues == 0)
+    {
+        features.flux = 0.0f;
+    }
+    else
+    {
+        auto rise = 0.0f;
+
+        for (int i = 0; i < numValues; ++i)
+            rise += juce::jmax (0.0f, normalised[i] - previous[(size_t) i]);
+
+        features.flux = rise / (float) numValues;
+    }
+
+    juce::FloatVectorOperations::copy (previous.data(), normalised, numValues);
+    numPrevious = numValues;
+}
+
+void SpectrumFeatures::measurePitch (float* fftData, int fftSize, const juce::dsp::FFT& fft) noexcept
+{
+    features.pitchHz = 0.0f;
+    features.pitchConfidence = 0.0f;
+
+    const int minLag = juce::jmax (2, (int) (sampleRate / maxPitchHz));
+    const int maxLag = juce::jmin (fftSize / 3, (int) std::ceil (sampleRate / minPitchHz));
+
+    if (fftSize != windowSize || maxLag <= minLag || features.centroidHz == 0.0f)
+        return;
+
+    magnitudesToAutocorrelation (fftData, fftSize, fft);
+    const auto* correlation = fftData;
+    const auto energy = correlation[0];
+
+    if (energy <= 0.0f)
+        return;
+
+    // One minus the normalised autocorrelation is YIN's difference function for a steady
+    // signal, over twice its energy. Dividing each lag by the running mean of those below
+    // it gives the cumulative mean normalised difference, which is 1 where the frame
+    // doesn't repeat and dips towards 0 at each multiple of its period.
+    auto sum = 0.0f;
+    difference[0] = 1.0f;
+
+    for (int lag = 1; lag <= maxLag + 1; ++lag)
+    {
+        const auto periodicity = correlation[lag] / (energy * juce::jmax (windowCorrelation[(size_t) lag], 1.0e-3f));
+        const auto value = juce::jmax (0.0f, 1.0f - periodicity);
+        sum += value;
+        difference[(size_t) lag] = sum > 0.0f ? value * (float) lag / sum : 1.0f;
+    }
+
+    // The first dip under the threshold, followed to its bottom, rather than the deepest
+    // one, which is as likely to be a multiple of the period
+    int best = -1;
+
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        if (difference[(size_t) lag] < pitchThreshold)
+        {
+            while (lag < maxLag && difference[(size_t) lag + 1] < difference[(size_t) lag])
+                ++lag;
+
+            best = lag;
+            break;
+        }
+    }
+
+    if (best < 0)
+    {
+        // Not pitched, but say how close it came
+        const auto* first = difference.data() + minLag;
+        features.pitchConfidence = juce::jlimit (0.0f, 1.0f, 1.0f - *std::min_element (first, first + (maxLag - minLag + 1)));
+        return;
+    }
+
+    const auto offset = parabolicOffset (difference[(size_t) best - 1], difference[(size_t) best], difference[(size_t) best + 1]);
+    features.pitchHz = (float) (sampleRate / (best + offset));
+    features.pitchConfidence = juce::jlimit (0.0f, 1.0f, 1.0f - difference[(size_t) best]);
+}
+
+//==============================================================================
+void SpectrumFeatures::detectOnset (juce::int64 samplePosition) noexcept
+{
+    const auto threshold = fluxAverage * onsetRatio + onsetFloor;
+    const auto isAbove = features.flux > threshold;
+
+    // Only on the way up, and not again until the flux has fallen back under the threshold
+    features.onset = isAbove && onsetArmed
+                  && (double) (samplePosition - lastOnset) >= onsetRefractorySeconds * sampleRate;
+
+    if (features.onset)
+        lastOnset = samplePosition;
+
+    onsetArmed = ! isAbove;
+
+    // The same time constant whatever the hop size
+    const auto elapsed = lastPosition >= 0 ? (double) (samplePosition - lastPosition) / sampleRate : 0.0;
+    fluxAverage += (features.flux - fluxAverage) * (float) (1.0 - std::exp (-elapsed / fluxAverageSeconds));
+}
+
+void SpectrumFeatures::updateEnvelope (juce::int64 samplePosition) noexcept
+{
+    const auto tickSamples = sampleRate * envelopeTickSeconds;
+    const auto tick = (juce::int64) ((double) juce::jmax ((juce::int64) 0, samplePosition) / tickSamples);
+
+    if (tick == lastTick)
+    {
+        auto& slot = envelope[(size_t) (tick % envelopeSize)];
+        slot = juce::jmax (slot, features.flux);
+        return;
+    }
+
+    // Every tick since the previous frame gets this frame's flux, so hops longer than a
+    // tick don't leave a regular pattern of gaps for the autocorrelation to find
+    const auto numNew = (int) juce::jmin (tick - lastTick, (juce::int64) envelopeSize);
+
+    for (int i = 0; i < numNew; ++i)
+        envelope[(size_t) ((tick - i) % envelopeSize)] = features.flux;
+
+    lastTick = tick;
+    numTicks = juce::jmin (envelopeSize, numTicks + numNew);
+    ticksUntilTempo -= numNew;
+
+    if (ticksUntilTempo <= 0 && numTicks >= envelopeSize / 2)
+    {
+        ticksUntilTempo = tempoUpdateTicks;
+        estimateTempo (samplePosition);
+    }
+}
+
+void SpectrumFeatures::estimateTempo (juce::int64 samplePosition) noexcept
+{
+    // Oldest first and without its mean, so the autocorrelation follows the rhythm
+    // rather than the overall level of change
+    const int n = numTicks;
+    auto mean = 0.0f;
+
+    for (int i = 0; i < n; ++i)
+    {
+        unrolled[(size_t) i] = envelope[(size_t) ((lastTick - (n - 1) + i) % envelopeSize)];
+        mean += unrolled[(size_t) i];
+    }
+
+    // A triangle five ticks wide, so a lag a tick or two off the hop grid still lines
+    // the pulses up
+    for (int i = n; --i >= 0;)
+    {
+        auto sum = 0.0f;
+
+        for (int j = -2; j <= 2; ++j)
+            sum += (float) (3 - std::abs (j)) * unrolled[(size_t) juce::jlimit (0, n - 1, i - j)];
+
+        smoothed[(size_t) i] = sum / 9.0f;
+    }
+
+    mean /= (float) n;
+    auto energy = 0.0f;
+
+    for (int i = 0; i < n; ++i)
+    {
+        unrolled[(size_t) i] = smoothed[(size_t) i] - mean;
+        energy += unrolled[(size_t) i] * unrolled[(size_t) i];
+    }
+
+    energy /= (float) n;
+
+    if (energy <= 1.0e-12f)
+    {
+        beatPeriodTicks = 0.0;
+        tempoConfidence = 0.0;
+        return;
+    }
+
+    for (int lag = minBeatLag - 1; lag <= maxBeatLag + 1; ++lag)
+    {
+        auto sum = 0.0f;
+
+        for (int i = lag; i < n; ++i)
+            sum += unrolled[(size_t) i] * unrolled[(size_t) (i - lag)];
+
+        beatCorrelation[(size_t) lag] = sum / (float) (n - lag);
+    }
+
+    const auto score = [this] (int lag) { return beatCorrelation[(size_t) lag] * tempoWeights[(size_t) lag]; };
+    int best = minBeatLag;
+
+    for (int lag = minBeatLag + 1; lag <= maxBeatLag; ++lag)
+        if (score (lag) > score (best))
+            best = lag;
+
+    if (beatCorrelation[(size_t) best] <= 0.0f)
+    {
+        beatPeriodTicks = 0.0;
+        tempoConfidence = 0.0;
+        return;
+    }
+
+    const auto period = best + (double) parabolicOffset (score (best - 1), score (best), score (best + 1));
+    tempoConfidence = juce::jlimit (0.0, 1.0, (double) (beatCorrelation[(size_t) best] / energy));
+
+    // Small changes are drift and get smoothed; anything bigger is a new tempo
+    if (beatPeriodTicks > 0.0 && std::abs (period - beatPeriodTicks) < 0.05 * beatPeriodTicks)
+        beatPeriodTicks += 0.25 * (period - beatPeriodTicks);
+    else
+        beatPeriodTicks = period;
+
+    // The phase is the offset back from the newest tick whose comb of beats, one period
+    // apart, collects the most flux
+    int bestOffset = 0;
+    auto bestSum = std::numeric_limits<float>::lowest();
+
+    for (int offset = 0; offset < (int) std::round (beatPeriodTicks); ++offset)
+    {
+        auto sum = 0.0f;
+
+        for (auto t = (double) (n - 1 - offset); t >= 0.0; t -= beatPeriodTicks)
+            sum += unrolled[(size_t) std::lround (t)];
+
+        if (sum > bestSum)
+        {
+            bestSum = sum;
+            bestOffset = offset;
+        }
+    }
+
+    // Predict forward from the latest beat found. One that has only just gone is still
+    // signalled, late, but none within half a beat of the last one, so a phase
+    // correction can neither drop a beat nor double one.
+    const auto tickSamples = sampleRate * envelopeTickSeconds;
+    const auto periodSamples = beatPeriodTicks * tickSamples;
+    auto next = (double) (lastTick - bestOffset) * tickSamples;
+
+    while (next < (double) samplePosition - 0.25 * periodSamples || next < lastBeat + 0.5 * periodSamples)
+        next += periodSamples;
+
+    nextBeat = next;
+}
+
+void SpectrumFeatures::trackBeats (juce::int64 samplePosition) noexcept
+{
+    features.beat = false;
+    features.tempoConfidence = (float) tempoConfidence;
+
+    if (beatPeriodTicks <= 0.0 || tempoConfidence < minTempoConfidence)
+    {
+        features.tempoBpm = 0.0f;
+        features.beatPhase = 0.0f;
+        return;
+    }
+
+    const auto periodSamples = beatPeriodTicks * sampleRate * envelopeTickSeconds;
+
+    if ((double) samplePosition >= nextBeat)
+    {
+        features.beat = true;
+        lastBeat = nextBeat;
+
+        while (nextBeat <= (double) samplePosition)
+            nextBeat += periodSamples;
+    }
+
+    features.tempoBpm = (float) (60.0 / (beatPeriodTicks * envelopeTickSeconds));
+    features.beatPhase = juce::jlimit (0.0f, 1.0f, (float) (1.0 - (nextBeat - (double) samplePosition) / periodSamples));
+}
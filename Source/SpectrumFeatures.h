@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    SpectrumFeatures.h
+    Onsets, tempo, spectral shape and pitch, taken from the analyser's FFT
+    output for one stream.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+#include "SpectrumKernels.h"
+
+//==============================================================================
+/**
+    Reduces each frame of one stream to an AudioFeatures vector. The work reuses
+    what the analyser has already computed for the frame:
+
+    - Centroid, rolloff and flatness are sums over the linear magnitudes.
+    - Flux is how far the normalised display values rose since the previous
+      frame. An onset is flux crossing an adaptive threshold on the way up.
+    - The tempo comes from the autocorrelation of the flux over the last five
+      seconds, resampled onto a fixed 10 ms grid so it doesn't depend on the hop
+      size. A comb over the same history finds where the beats fall, and beats
+      are then predicted from the tempo.
+    - The pitch uses YIN's cumulative mean normalised difference. The
+      autocorrelation behind it comes from the magnitudes through one inverse
+      transform with the same FFT plan, rather than an O(N^2) sum over lags. It
+      is divided by the window's own autocorrelation, so the taper doesn't
+      favour short lags.
+
+    The transform is circular and the frame isn't zero padded, so the pitch
+    search stops at a third of the FFT size, where the wrapped-around part is
+    small. Larger FFT orders reach lower notes.
+
+    Owned by whichever thread is processing the analyser, like the rest of its
+    state. All storage is sized in the constructor.
+*/
+class SpectrumFeatures
+{
+public:
+    static constexpr double minPitchHz = 40.0;
+    static constexpr double maxPitchHz = 2000.0;
+    static constexpr float pitchThreshold = 0.2f;           // YIN's absolute threshold on the difference
+    static constexpr float rolloffFraction = 0.85f;
+    static constexpr float onsetRatio = 1.5f;               // onsets need this much more flux than usual...
+    static constexpr float onsetFloor = 0.01f;              // ...plus this much, about 1 dB across the spectrum
+    static constexpr double fluxAverageSeconds = 0.5;
+    static constexpr double onsetRefractorySeconds = 0.05;
+    static constexpr double envelopeTickSeconds = 0.01;
+    static constexpr int envelopeSize = 512;                // ticks of flux history
+    static constexpr int tempoUpdateTicks = 25;             // re-estimates four times a second
+    static constexpr int minBeatLag = 30;                   // 200 BPM at one tick per 10 ms
+    static constexpr int maxBeatLag = 100;                  // 60 BPM
+    static constexpr int preferredBeatLag = 50;             // 120 BPM, where the tempo search leans
+    static constexpr float minTempoConfidence = 0.1f;
+
+    explicit SpectrumFeatures (int maxFftSize);
+
+    /** Forgets every previous frame. Call when the clock restarts or the analysed
+        stream changes.
+    */
+    void reset (double newSampleRate) noexcept;
+
+    /** Caches the autocorrelation of `window` for the pitch estimate. `work` must
+        hold 2 * fftSize floats. Call whenever the window or the FFT size changes.
+    */
+    void setWindow (const float* window, int fftSize, const juce::dsp::FFT& fft, float* work) noexcept;
+
+    /** Analyses one frame. `fftData` holds the fftSize magnitudes from
+        performFrequencyOnlyForwardTransform() and is overwritten, so call this once
+        nothing else needs them. `normalised` is the frame's display values before
+        ballistics; `samplePosition` is the centre of its window.
+    */
+    const AudioFeatures& process (float* fftData, int fftSize, const juce::dsp::FFT& fft,
+                                  const float* normalised, int numValues,
+                                  juce::int64 samplePosition) noexcept;
+
+    const AudioFeatures& getFeatures() const noexcept  { return features; }
+
+private:
+    void measureShape (const float* magnitudes, int numBins) noexcept;
+    void measureFlux (const float* normalised, int numValues) noexcept;
+    void measurePitch (float* fftData, int fftSize, const juce::dsp::FFT& fft) noexcept;
+    void detectOnset (juce::int64 samplePosition) noexcept;
+    void updateEnvelope (juce::int64 samplePosition) noexcept;
+    void estimateTempo (juce::int64 samplePosition) noexcept;
+    void trackBeats (juce::int64 samplePosition) noexcept;
+
+    double sampleRate = 44100.0;
+    AudioFeatures features;
+
+    // Pitch: the window's normalised autocorrelation, and the difference function
+    std::vector<float> windowCorrelation;
+    std::vector<float> difference;
+    int windowSize = 0;
+
+    // Flux and onsets
+    std::vector<float> previous;
+    int numPrevious = 0;
+    float fluxAverage = 0.0f;
+    bool onsetArmed = true;
+    juce::int64 lastOnset = 0;
+    juce::int64 lastPosition = -1;
+
+    // Tempo: a ring of flux per tick, unrolled oldest first for each estimate
+    std::array<float, envelopeSize> envelope {};
+    std::array<float, envelopeSize> unrolled {}, smoothed {};
+    std::array<float, maxBeatLag + 2> beatCorrelation {};
+    std::array<float, maxBeatLag + 2> tempoWeights {};
+    juce::int64 lastTick = -1;
+    int numTicks = 0;
+    int ticksUntilTempo = tempoUpdateTicks;
+    double beatPeriodTicks = 0.0;
+    double tempoConfidence = 0.0;
+    double nextBeat = 0.0;                  // in samples
+    double lastBeat = 0.0;                  // the last beat signalled
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumFeatures)
+};
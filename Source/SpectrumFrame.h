@@ -0,0 +1,216 @@
+/*
+  ==============================================================================
+
+    SpectrumFrame.h
+    One completed analysis frame, as handed from the audio side to the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeQueue.h"
+#include "BandMap.h"
+
+//==============================================================================
+/** The signal a frame was analysed from. The values are sent to the frontend
+    as-is, so only ever append to this list.
+*/
+enum class SpectrumStream : juce::uint8
+{
+    mix,            // all main input channels averaged, the classic mono view
+    left,
+    right,
+    mid,            // (L + R) / 2
+    side,           // (L - R) / 2
+    sidechain       // the sidechain bus, averaged to mono
+};
+
+constexpr int numSpectrumStreams = 6;
+
+/** The frontend's names for the streams, in SpectrumStream order. */
+inline const juce::StringArray& getSpectrumStreamNames()
+{
+    static const juce::StringArray names { "mix", "left", "right", "mid", "side", "sidechain" };
+    return names;
+}
+
+/** Parses a stream name from getSpectrumStreamNames(). Returns -1 for anything else. */
+inline int spectrumStreamFromName (const juce::String& name)
+{
+    return getSpectrumStreamNames().indexOf (name.toLowerCase());
+}
+
+//==============================================================================
+/** Levels of the main input's channels over the audio a frame covers, after the
+    gain parameter. All linear, so 1 is full scale; the true peak is estimated at
+    four times the sample rate and catches overs between samples.
+*/
+struct MeterLevels
+{
+    static constexpr int maxChannels = 2;
+
+    struct Channel
+    {
+        float rms = 0.0f;
+        float peak = 0.0f;
+        float truePeak = 0.0f;
+
+        bool operator== (const Channel& other) const noexcept
+        {
+            return rms == other.rms && peak == other.peak && truePeak == other.truePeak;
+        }
+    };
+
+    std::array<Channel, maxChannels> channels {};
+    int numChannels = 0;            // 0 until the first block has been measured
+
+    bool operator== (const MeterLevels& other) const noexcept
+    {
+        return numChannels == other.numChannels
+            && std::equal (channels.begin(), channels.begin() + numChannels, other.channels.begin());
+    }
+};
+
+//==============================================================================
+/** What SpectrumFeatures found in one frame of the stream chosen with
+    SpectrumAnalyser::setFeatureStream(). Frequencies are in Hz, and 0 where
+    there was nothing to measure: silence, no steady tempo or no pitch.
+*/
+struct AudioFeatures
+{
+    float flux = 0.0f;              // mean rise of the normalised spectrum since the previous frame, 0..1
+    bool onset = false;             // the flux jumped at this frame
+    bool beat = false;              // a beat of the tracked tempo fell since the previous frame
+    float tempoBpm = 0.0f;
+    float tempoConfidence = 0.0f;   // 0..1, how regular the onsets are
+    float beatPhase = 0.0f;         // 0 on a beat, rising towards 1 just before the next
+    float centroidHz = 0.0f;        // the spectrum's centre of mass
+    float rolloffHz = 0.0f;         // below which 85% of the power lies
+    float flatness = 0.0f;          // 0 for a pure tone, towards 1 for white noise
+    float pitchHz = 0.0f;
+    float pitchConfidence = 0.0f;   // 0..1, how periodic the frame is
+
+    bool operator== (const AudioFeatures& other) const noexcept
+    {
+        return flux == other.flux && onset == other.onset && beat == other.beat
+            && tempoBpm == other.tempoBpm && tempoConfidence == other.tempoConfidence
+            && beatPhase == other.beatPhase && centroidHz == other.centroidHz
+            && rolloffHz == other.rolloffHz && flatness == other.flatness
+            && pitchHz == other.pitchHz && pitchConfidence == other.pitchConfidence;
+    }
+};
+
+//==============================================================================
+/**
+    A spectrum frame lives in a preallocated slot of a SpectrumFrameQueue.
+    `numBins` says how much of `bins` is valid for this particular frame.
+
+    Queue slots are sized for the frames actually being produced rather than the
+    largest possible one, and the producer never allocates. A frame wider than
+    its slot is reduced to fit by keeping the loudest value of each group, as a
+    SpectrogramHistory row is, and the consumer resizes the slot once it has
+    read it (see popSpectrumFrame()), so a new FFT size or band count arrives
+    whole after one trip round the queue.
+*/
+struct SpectrumFrame
+{
+    /** Allocates, so only from whichever side owns the slot, off the audio thread. */
+    void allocate (int maxBins, bool withPeaks = true)
+    {
+        bins.assign ((size_t) maxBins, 0.0f);
+        peaks.assign (withPeaks ? (size_t) maxBins : 0, 0.0f);
+        numBins = 0;
+        hasPeaks = false;
+    }
+
+    /** Copies `num` values into the preallocated storage, reduced if they don't fit.
+        Never allocates.
+    */
+    void setBins (const float* source, int num) noexcept
+    {
+        const int capacity = (int) bins.size();
+        requestedBins = num;
+        group = num <= capacity ? 1 : (capacity > 0 ? (num + capacity - 1) / capacity : num + 1);
+        numBins = reduce (source, bins.data());
+    }
+
+    /** Copies the peak values of the requestedBins given to setBins(), reduced the
+        same way, or marks the frame as having none. Frames whose slot has no room
+        for peaks go without until the slot is resized. Never allocates.
+    */
+    void setPeaks (const float* source) noexcept
+    {
+        requestedPeaks = source != nullptr;
+        hasPeaks = requestedPeaks && (int) peaks.size() >= numBins;
+
+        if (hasPeaks)
+            reduce (source, peaks.data());
+    }
+
+    /** Consumer side, once it has read the frame: resizes the slot to what the
+        producer asked setBins() and setPeaks() for, if that differs.
+    */
+    void fitToRequestedSize()
+    {
+        const auto numPeaks = requestedPeaks ? requestedBins : 0;
+
+        if ((int) bins.size() != requestedBins || (int) peaks.size() != numPeaks)
+            allocate (requestedBins, requestedPeaks);
+    }
+
+    std::vector<float> bins;        // normalised 0..1 display values, after any ballistics
+    std::vector<float> peaks;       // held peaks for each bin, valid when hasPeaks
+    bool hasPeaks = false;
+    int numBins = 0;
+    BandMap::Scale scale = BandMap::Scale::linear;  // how bins are spaced in frequency
+    SpectrumStream stream = SpectrumStream::mix;
+    juce::uint64 sequence = 0;      // hop counter, shared by all streams analysed at the same hop
+    juce::int64 analysedTicks = 0;  // juce::Time::getHighResolutionTicks() when the frame was published
+    juce::int64 samplePosition = 0; // centre of the analysis window, in samples since prepareToPlay
+    juce::int64 hostPosition = -1;  // the same on the host timeline, -1 if unknown; set by FramePacer
+    MeterLevels levels;             // the same for every stream analysed at this hop
+    bool hasFeatures = false;       // only the feature stream's frames carry features
+    AudioFeatures features;
+
+private:
+    // Writes the requestedBins values into `dest`, keeping the loudest of each group
+    int reduce (const float* source, float* dest) const noexcept
+    {
+        if (group == 1)
+        {
+            std::copy (source, source + requestedBins, dest);
+            return requestedBins;
+        }
+
+        const int width = group > requestedBins ? 0 : (requestedBins + group - 1) / group;
+
+        for (int i = 0; i < width; ++i)
+        {
+            const int start = i * group;
+            dest[i] = juce::FloatVectorOperations::findMaximum (source + start, juce::jmin (group, requestedBins - start));
+        }
+
+        return width;
+    }
+
+    int requestedBins = 0;          // what the producer had, before any reduction
+    int group = 1;                  // values merged into each bin to fit the slot
+    bool requestedPeaks = false;
+};
+
+using SpectrumFrameQueue = RealtimeQueue<SpectrumFrame>;
+
+/** Consumer side: pops the oldest frame like SpectrumFrameQueue::pop(), then
+    resizes its slot for the frames the producer is making now.
+*/
+template <typename Reader>
+bool popSpectrumFrame (SpectrumFrameQueue& queue, Reader&& read)
+{
+    return queue.pop ([&read] (SpectrumFrame& frame)
+    {
+        read (static_cast<const SpectrumFrame&> (frame));
+        frame.fitToRequestedSize();
+    });
+}
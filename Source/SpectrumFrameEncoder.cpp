@@ -0,0 +1,221 @@
+/*
+  ==============================================================================
+
+    SpectrumFrameEncoder.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumFrameEncoder.h"
+
+namespace {
+template <typename IntType>
+void writeLittleEndian (juce::uint8* dest, IntType value)
+{
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        dest[i] = (juce::uint8) ((value >> (8 * i)) & 0xff);
+}
+
+void writeLittleEndian (juce::uint8* dest, double value)
+{
+    juce::uint64 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeLittleEndian (dest, bits);
+}
+
+void writeLittleEndian (juce::uint8* dest, float value)
+{
+    juce::uint32 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeLittleEndian (dest, bits);
+}
+
+template <typename IntType>
+IntType readLittleEndian (const juce::uint8* source)
+{
+    IntType value = 0;
+
+    for (size_t i = 0; i < sizeof (IntType); ++i)
+        value = (IntType) (value | ((IntType) source[i] << (8 * i)));
+
+    return value;
+}
+
+double readDouble (const juce::uint8* source)
+{
+    const auto bits = readLittleEndian<juce::uint64> (source);
+    double value;
+    std::memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+template <typename IntType>
+void quantise (const float* source, int numBins, juce::uint8* dest)
+{
+    constexpr auto maxValue = (float) std::numeric_limits<IntType>::max();
+
+    for (int i = 0; i < numBins; ++i)
+    {
+        const auto clamped = juce::jlimit (0.0f, 1.0f, source[i]);
+        writeLittleEndian (dest + i * (int) sizeof (IntType), (IntType) (clamped * maxValue + 0.5f));
+    }
+}
+} // namespace
+
+//==============================================================================
+SpectrumFrameEncoder::SpectrumFrameEncoder (Quantisation q)
+    : quantisation (q)
+{
+}
+
+juce::String SpectrumFrameEncoder::encode (const SpectrumFrame& frame)
+{
+    const auto size = encodeBinary (frame);
+    return juce::Base64::toBase64 (scratch.getData(), size);
+}
+
+void SpectrumFrameEncoder::reserve (int maxBins)
+{
+    const auto maxSize = (size_t) (headerSize + 2 * maxBins * (int) quantisation
+                                   + levelsHeaderSize + MeterLevels::maxChannels * levelsChannelSize + featuresSize);
+
+    if (scratch.getSize() < maxSize)
+        scratch.setSize (maxSize, false);
+}
+
+size_t SpectrumFrameEncoder::encodeBinary (const SpectrumFrame& frame)
+{
+    const auto bytesPerBin = (int) quantisation;
+    const auto numBins = juce::jmin (frame.numBins, (int) std::numeric_limits<juce::uint16>::max());
+    const auto numArrays = frame.hasPeaks ? 2 : 1;
+    const auto numLevelChannels = juce::jlimit (0, MeterLevels::maxChannels, frame.levels.numChannels);
+    const auto levelsSize = numLevelChannels > 0 ? levelsHeaderSize + numLevelChannels * levelsChannelSize : 0;
+    const auto featuresOffset = headerSize + numArrays * numBins * bytesPerBin + levelsSize;
+    const auto totalSize = (size_t) (featuresOffset + (frame.hasFeatures ? featuresSize : 0));
+
+    // Only grows when a larger frame than any before comes through
+    if (scratch.getSize() < totalSize)
+        scratch.setSize (totalSize, false);
+
+    auto* bytes = static_cast<juce::uint8*> (scratch.getData());
+
+    bytes[0] = 'V';
+    bytes[1] = 'F';
+    bytes[2] = currentVersion;
+    bytes[3] = (juce::uint8) bytesPerBin;
+    writeLittleEndian (bytes + 4, (juce::uint16) numBins);
+    bytes[6] = (juce::uint8) frame.scale;
+    bytes[7] = (juce::uint8) frame.stream;
+    writeLittleEndian (bytes + 8, (juce::uint32) frame.sequence);
+    bytes[12] = (juce::uint8) ((frame.hasPeaks ? hasPeaksFlag : 0)
+                               | (levelsSize > 0 ? hasLevelsFlag : 0)
+                               | (frame.hasFeatures ? hasFeaturesFlag : 0));
+    bytes[13] = bytes[14] = bytes[15] = 0;
+    writeLittleEndian (bytes + 16, (double) frame.samplePosition);
+    writeLittleEndian (bytes + 24, (double) frame.hostPosition);
+
+    auto* bins = bytes + headerSize;
+    auto* peaks = bins + numBins * bytesPerBin;
+
+    if (quantisation == Quantisation::sixteenBit)
+    {
+        quantise<juce::uint16> (frame.bins.data(), numBins, bins);
+
+        if (frame.hasPeaks)
+            quantise<juce::uint16> (frame.peaks.data(), numBins, peaks);
+    }
+    else
+    {
+        quantise<juce::uint8> (frame.bins.data(), numBins, bins);
+
+        if (frame.hasPeaks)
+            quantise<juce::uint8> (frame.peaks.data(), numBins, peaks);
+    }
+
+    if (levelsSize > 0)
+    {
+        auto* levels = bins + numArrays * numBins * bytesPerBin;
+        levels[0] = (juce::uint8) numLevelChannels;
+        levels[1] = levels[2] = levels[3] = 0;
+
+        for (int ch = 0; ch < numLevelChannels; ++ch)
+        {
+            const auto& channel = frame.levels.channels[(size_t) ch];
+            auto* dest = levels + levelsHeaderSize + ch * levelsChannelSize;
+            writeLittleEndian (dest, channel.rms);
+            writeLittleEndian (dest + 4, channel.peak);
+            writeLittleEndian (dest + 8, channel.truePeak);
+        }
+    }
+
+    if (frame.hasFeatures)
+    {
+        const auto& features = frame.features;
+        auto* dest = bytes + featuresOffset;
+        dest[0] = (juce::uint8) ((features.onset ? 1 : 0) | (features.beat ? 2 : 0));
+        dest[1] = dest[2] = dest[3] = 0;
+
+        const float values[] { features.flux, features.tempoBpm, features.tempoConfidence, features.beatPhase,
+                               features.centroidHz, features.rolloffHz, features.flatness,
+                               features.pitchHz, features.pitchConfidence };
+        static_assert (4 + (int) sizeof (values) == featuresSize, "features layout and size disagree");
+
+        for (size_t i = 0; i < std::size (values); ++i)
+            writeLittleEndian (dest + 4 + 4 * i, values[i]);
+    }
+
+    return totalSize;
+}
+
+//==============================================================================
+bool EncodedFrame::read (const void* data, size_t size) noexcept
+{
+    using Encoder = SpectrumFrameEncoder;
+    bytes = static_cast<const juce::uint8*> (data);
+
+    if (size < (size_t) Encoder::headerSize || bytes[0] != 'V' || bytes[1] != 'F' || bytes[2] != Encoder::currentVersion)
+        return false;
+
+    bytesPerBin = bytes[3];
+    numBins = readLittleEndian<juce::uint16> (bytes + 4);
+    scale = bytes[6];
+    stream = (SpectrumStream) bytes[7];
+    sequence = readLittleEndian<juce::uint32> (bytes + 8);
+    hasPeaks = (bytes[12] & Encoder::hasPeaksFlag) != 0;
+    hasLevels = (bytes[12] & Encoder::hasLevelsFlag) != 0;
+    hasFeatures = (bytes[12] & Encoder::hasFeaturesFlag) != 0;
+    samplePosition = readDouble (bytes + 16);
+    hostPosition = readDouble (bytes + 24);
+
+    // Walk the optional blocks to find the features, checking each fits
+    auto offset = (size_t) (Encoder::headerSize + (hasPeaks ? 2 : 1) * numBins * bytesPerBin);
+
+    if (hasLevels)
+        offset += offset < size ? (size_t) (Encoder::levelsHeaderSize + bytes[offset] * Encoder::levelsChannelSize) : size;
+
+    if (hasFeatures)
+    {
+        if (offset + Encoder::featuresSize > size)
+            return false;
+
+        onset = (bytes[offset] & 1) != 0;
+        beat = (bytes[offset] & 2) != 0;
+        offset += Encoder::featuresSize;
+    }
+    else
+    {
+        onset = beat = false;
+    }
+
+    return (bytesPerBin == 1 || bytesPerBin == 2) && offset <= size;
+}
+
+float EncodedFrame::getValue (int index, bool peaks) const noexcept
+{
+    jassert (juce::isPositiveAndBelow (index, numBins) && (hasPeaks || ! peaks));
+
+    const auto* value = bytes + SpectrumFrameEncoder::headerSize + ((peaks ? numBins : 0) + index) * bytesPerBin;
+
+    return bytesPerBin == 2 ? (float) readLittleEndian<juce::uint16> (value) / 65535.0f
+                            : (float) value[0] / 255.0f;
+}
@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    SpectrumFrameEncoder.h
+    Packs spectrum frames into the compact binary format read by
+    Frontend/public/js/juce/viber.js.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumFrame.h"
+
+//==============================================================================
+/**
+    Serialises a SpectrumFrame as a small versioned header followed by the bins
+    quantised to 8 or 16 bits, then base64-encodes the result so it can travel
+    as a single string through emitEventIfBrowserIsVisible.
+
+    Layout (all multi-byte fields little endian):
+
+        0   'V' 'F'         magic
+        2   uint8           format version (currentVersion)
+        3   uint8           bytes per bin (1 or 2)
+        4   uint16          number of bins (or display bands)
+        6   uint8           frequency scale of the bins (BandMap::Scale)
+        7   uint8           stream the frame was analysed from (SpectrumStream)
+        8   uint32          frame sequence number (low 32 bits)
+        12  uint8           flags: bit 0 set when peaks follow the bins,
+                            bit 1 when levels follow them, bit 2 when features do
+        13  uint8[3]        reserved, 0
+        16  float64         centre of the analysis window, in samples since prepareToPlay
+        24  float64         the same on the host's timeline, or -1 if the host didn't say
+        32  bins...         value * 255 or value * 65535, rounded
+        ... peaks...        as many again, quantised the same way, if flagged
+        ... levels          if flagged: uint8 number of channels, uint8[3] reserved,
+                            then per channel float32 RMS, peak and true peak, linear
+        ... features        if flagged: uint8 events (bit 0 onset, bit 1 beat),
+                            uint8[3] reserved, then float32 flux, tempo BPM, tempo
+                            confidence, beat phase, centroid Hz, rolloff Hz,
+                            flatness, pitch Hz and pitch confidence (AudioFeatures)
+
+    If this layout changes, bump currentVersion and teach decodeSpectrumFrame()
+    in viber.js, and EncodedFrame below, about it.
+*/
+class SpectrumFrameEncoder
+{
+public:
+    enum class Quantisation
+    {
+        eightBit = 1,
+        sixteenBit = 2
+    };
+
+    static constexpr juce::uint8 currentVersion = 7;
+    static constexpr int headerSize = 32;
+    static constexpr juce::uint8 hasPeaksFlag = 1;
+    static constexpr juce::uint8 hasLevelsFlag = 2;
+    static constexpr juce::uint8 hasFeaturesFlag = 4;
+    static constexpr int levelsHeaderSize = 4;
+    static constexpr int levelsChannelSize = 12;
+    static constexpr int featuresSize = 40;
+
+    explicit SpectrumFrameEncoder (Quantisation q = Quantisation::eightBit);
+
+    void setQuantisation (Quantisation q) noexcept  { quantisation = q; }
+    Quantisation getQuantisation() const noexcept   { return quantisation; }
+
+    /** Packs the frame into the internal scratch block and returns it as base64. */
+    juce::String encode (const SpectrumFrame& frame);
+
+    /** Packs the frame into the internal scratch block without the base64 step and
+        returns its size in bytes. They stay at getData() until the next call.
+        Never allocates for frames of up to the size passed to reserve().
+    */
+    size_t encodeBinary (const SpectrumFrame& frame);
+    const void* getData() const noexcept  { return scratch.getData(); }
+
+    /** Sizes the scratch block for frames of up to maxBins bins, with peaks,
+        levels and features, so encoding never allocates afterwards.
+    */
+    void reserve (int maxBins);
+
+private:
+    Quantisation quantisation;
+    juce::MemoryBlock scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumFrameEncoder)
+};
+
+//==============================================================================
+/**
+    Reads the fields of one encoded frame where it lies, without copying or
+    dequantising the bins, e.g. straight out of a CaptureFile mapping.
+*/
+struct EncodedFrame
+{
+    /** Returns false unless `data` holds a whole frame in the current version. */
+    bool read (const void* data, size_t size) noexcept;
+
+    /** A bin, or peak with `peaks`, back in 0..1. */
+    float getValue (int index, bool peaks = false) const noexcept;
+
+    const juce::uint8* bytes = nullptr;
+    int numBins = 0;
+    int bytesPerBin = 1;
+    int scale = 0;
+    SpectrumStream stream = SpectrumStream::mix;
+    juce::uint32 sequence = 0;
+    bool hasPeaks = false, hasLevels = false, hasFeatures = false;
+    bool onset = false, beat = false;
+    double samplePosition = 0.0;
+    double hostPosition = -1.0;
+};
@@ -0,0 +1,282 @@
+/*
+  ==============================================================================
+
+    SpectrumKernels.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumKernels.h"
+
+namespace {
+// Anything quieter than this is far below any sensible display floor. Clamping
+// to it keeps the log away from zero, denormals and negative inputs.
+constexpr float minimumMagnitude = 1.0e-20f;
+
+// 20 * log10 (2): converts log2 to decibels
+constexpr float decibelsPerLog2 = 6.0205999132796239f;
+
+inline juce::int32 floatBits (float x) noexcept
+{
+    juce::int32 bits;
+    std::memcpy (&bits, &x, sizeof (bits));
+    return bits;
+}
+
+inline float bitsToFloat (juce::int32 bits) noexcept
+{
+    float x;
+    std::memcpy (&x, &bits, sizeof (x));
+    return x;
+}
+
+inline float log2FromBits (juce::int32 bits) noexcept
+{
+    // Split x into 2^e * m with m in [sqrt(1/2), sqrt(2)) using integer ops only:
+    // offsetting by the bit pattern of sqrt(1/2) before taking the exponent field
+    // moves the mantissa range so it is centred on 1.
+    constexpr juce::int32 sqrtHalfBits = 0x3f3504f3;
+
+    const auto exponent = (bits - sqrtHalfBits) >> 23;
+    const auto m = bitsToFloat (bits - exponent * (1 << 23));   // not <<, exponent can be negative
+
+    // log2(m) = 2/ln(2) * atanh(z) with z = (m - 1) / (m + 1), |z| <= 0.1716.
+    // Three terms of the atanh series leave a truncation error below 4e-6.
+    const auto z = (m - 1.0f) / (m + 1.0f);
+    const auto z2 = z * z;
+    const auto series = z * (1.0f + z2 * (1.0f / 3.0f + z2 * (1.0f / 5.0f)));
+
+    constexpr float twoOverLn2 = 2.8853900817779268f;
+    return (float) exponent + twoOverLn2 * series;
+}
+
+// Eight independent accumulators: one would be a loop-carried dependency the compiler
+// may not reorder without -ffast-math, eight map onto one or two vector registers
+constexpr int numLanes = 8;
+
+float maxOfLanes (const float (&lanes)[numLanes]) noexcept
+{
+    return *std::max_element (std::begin (lanes), std::end (lanes));
+}
+
+// Hann-windowed sinc for each of the three points between two samples, normalised to
+// unity gain at DC. Built once at load, never on the audio thread.
+using TruePeakTaps = std::array<std::array<float, SpectrumKernels::truePeakTapsPerPhase>,
+                                SpectrumKernels::truePeakOversampling - 1>;
+
+TruePeakTaps makeTruePeakTaps()
+{
+    using namespace SpectrumKernels;
+    constexpr auto pi = juce::MathConstants<double>::pi;
+    constexpr int halfLength = truePeakTapsPerPhase / 2;
+
+    TruePeakTaps taps {};
+
+    for (int phase = 1; phase < truePeakOversampling; ++phase)
+    {
+        auto& phaseTaps = taps[(size_t) phase - 1];
+        const auto fraction = phase / (double) truePeakOversampling;
+        double sum = 0.0;
+
+        for (int k = 0; k < truePeakTapsPerPhase; ++k)
+        {
+            // Distance from tap k's sample to the point, which sits `fraction` past the sixth sample
+            const auto distance = (double) (k - (halfLength - 1)) - fraction;
+            const auto sinc = std::sin (pi * distance) / (pi * distance);
+            const auto window = 0.5 * (1.0 + std::cos (pi * distance / halfLength));
+            phaseTaps[(size_t) k] = (float) (sinc * window);
+            sum += sinc * window;
+        }
+
+        for (auto& tap : phaseTaps)
+            tap = (float) (tap / sum);
+    }
+
+    return taps;
+}
+
+const TruePeakTaps truePeakTaps = makeTruePeakTaps();
+} // namespace
+
+//==============================================================================
+float SpectrumKernels::fastLog2 (float x) noexcept
+{
+    return log2FromBits (floatBits (x));
+}
+
+void SpectrumKernels::magnitudesToNormalisedDb (const float* magnitudes, float* dest, int numBins,
+                                                float floorDb, float ceilingDb) noexcept
+{
+    jassert (ceilingDb > floorDb);
+
+    // norm = (dB - floor) / (ceiling - floor), folded into a single multiply-add on log2
+    const auto range = juce::jmax (ceilingDb - floorDb, 1.0e-3f);
+    const auto scale = decibelsPerLog2 / range;
+    const auto offset = -floorDb / range;
+
+    // Positive floats order the same way as their bit patterns, so the lower clamp is
+    // done on integers. Negative inputs have the sign bit set and clamp up to the floor.
+    // Doing it this way (rather than with a float compare) lets GCC and Clang vectorise
+    // the whole loop.
+    const auto minimumBits = floatBits (minimumMagnitude);
+
+    for (int i = 0; i < numBins; ++i)
+    {
+        const auto bits = std::max (floatBits (magnitudes[i]), minimumBits);
+        const auto norm = log2FromBits (bits) * scale + offset;
+        dest[i] = std::min (std::max (norm, 0.0f), 1.0f);
+    }
+}
+
+void SpectrumKernels::magnitudesToNormalisedDbReference (const float* magnitudes, float* dest, int numBins,
+                                                         float floorDb, float ceilingDb) noexcept
+{
+    for (int i = 0; i < numBins; ++i)
+    {
+        const float safe = std::max (magnitudes[i], 1e-8f);
+        const float db = 20.0f * std::log10 (safe);
+        float norm = (db - floorDb) / (ceilingDb - floorDb);
+        if (norm < 0.0f) norm = 0.0f;
+        if (norm > 1.0f) norm = 1.0f;
+        dest[i] = norm;
+    }
+}
+
+const float* SpectrumKernels::downmix (const float* const* channels, int numChannels, int startSample,
+                                       int numSamples, float* scratch) noexcept
+{
+    if (numChannels == 1)
+        return channels[0] + startSample;
+
+    if (numChannels == 0)
+    {
+        juce::FloatVectorOperations::clear (scratch, numSamples);
+        return scratch;
+    }
+
+    juce::FloatVectorOperations::add (scratch, channels[0] + startSample, channels[1] + startSample, numSamples);
+
+    for (int ch = 2; ch < numChannels; ++ch)
+        juce::FloatVectorOperations::add (scratch, channels[ch] + startSample, numSamples);
+
+    juce::FloatVectorOperations::multiply (scratch, 1.0f / static_cast<float> (numChannels), numSamples);
+    return scratch;
+}
+
+void SpectrumKernels::downmixReference (const float* const* channels, int numChannels, int startSample,
+                                        int numSamples, float* dest) noexcept
+{
+    const int numInputCh = juce::jmax (1, numChannels);
+
+    for (int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+    {
+        float mixed = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            mixed += channels[ch][startSample + sampleIndex];
+        dest[sampleIndex] = mixed / static_cast<float> (numInputCh);
+    }
+}
+
+SpectrumKernels::LevelSums SpectrumKernels::applyGainAndMeasure (float* samples, int numSamples,
+                                                                float startGain, float endGain) noexcept
+{
+    if (numSamples <= 0)
+        return {};
+
+    const auto step = (endGain - startGain) / (float) numSamples;
+    float sums[numLanes] = {}, offsets[numLanes];
+
+    for (int lane = 0; lane < numLanes; ++lane)
+        offsets[lane] = step * (float) lane;
+
+    int i = 0;
+
+    for (; i + numLanes <= numSamples; i += numLanes)
+    {
+        const auto base = startGain + step * (float) i;
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const auto y = samples[i + lane] * (base + offsets[lane]);
+            samples[i + lane] = y;
+            sums[lane] += y * y;
+        }
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        const auto y = samples[i] * (startGain + step * (float) i);
+        samples[i] = y;
+        sums[0] += y * y;
+    }
+
+    LevelSums result;
+
+    for (const auto sum : sums)
+        result.sumSquares += sum;
+
+    // A running max in the loop above stops GCC vectorising it, so the peak comes from JUCE's
+    // SIMD min/max over the span just written, which is still in cache
+    const auto range = juce::FloatVectorOperations::findMinAndMax (samples, numSamples);
+    result.peak = std::max (-range.getStart(), range.getEnd());
+    return result;
+}
+
+SpectrumKernels::LevelSums SpectrumKernels::applyGainAndMeasureReference (float* samples, int numSamples,
+                                                                         float startGain, float endGain) noexcept
+{
+    const auto step = numSamples > 0 ? (endGain - startGain) / (float) numSamples : 0.0f;
+    auto gain = startGain;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        samples[i] *= gain;
+        gain += step;
+    }
+
+    LevelSums result;
+
+    for (int i = 0; i < numSamples; ++i)
+        result.sumSquares += samples[i] * samples[i];
+
+    for (int i = 0; i < numSamples; ++i)
+        result.peak = std::max (result.peak, std::abs (samples[i]));
+
+    return result;
+}
+
+float SpectrumKernels::truePeak (const float* samples, int numSamples) noexcept
+{
+    const auto* window = samples - (truePeakTapsPerPhase - 1);
+    float peaks[numLanes] = {};
+
+    for (const auto& taps : truePeakTaps)
+    {
+        int n = 0;
+
+        for (; n + numLanes <= numSamples; n += numLanes)
+        {
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                float y = 0.0f;
+
+                for (int k = 0; k < truePeakTapsPerPhase; ++k)
+                    y += taps[(size_t) k] * window[n + lane + k];
+
+                peaks[lane] = std::max (peaks[lane], std::abs (y));
+            }
+        }
+
+        for (; n < numSamples; ++n)
+        {
+            float y = 0.0f;
+
+            for (int k = 0; k < truePeakTapsPerPhase; ++k)
+                y += taps[(size_t) k] * window[n + k];
+
+            peaks[0] = std::max (peaks[0], std::abs (y));
+        }
+    }
+
+    return maxOfLanes (peaks);
+}
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    SpectrumKernels.h
+    Vectorisable kernels for the spectrum analyser's input and output.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+namespace SpectrumKernels
+{
+    /** Display range used when nothing else has been configured:
+        -100 dB maps to 0 and 0 dB maps to 1, as the analyser always did.
+    */
+    constexpr float defaultFloorDb = -100.0f;
+    constexpr float defaultCeilingDb = 0.0f;
+
+    /** Upper bound on |fastLog2 (x) - log2 (x)| for any positive normal x.
+        In decibels that is 20 * log10 (2) * maxLog2Error, about 3e-5 dB, far
+        below what an 8-bit display frame can show.
+    */
+    constexpr float maxLog2Error = 5.0e-6f;
+
+    /** Branchless approximate log2 for positive, normal inputs. */
+    float fastLog2 (float x) noexcept;
+
+    /** Converts linear FFT magnitudes to dB and maps [floorDb, ceilingDb] onto [0, 1],
+        clamping outside that range. Uses the fastLog2 approximation and no branches
+        in the loop, so the compiler can vectorise it. `dest` may alias `magnitudes`.
+    */
+    void magnitudesToNormalisedDb (const float* magnitudes, float* dest, int numBins,
+                                   float floorDb, float ceilingDb) noexcept;
+
+    /** The original scalar std::log10 version, kept as the accuracy reference. */
+    void magnitudesToNormalisedDbReference (const float* magnitudes, float* dest, int numBins,
+                                            float floorDb, float ceilingDb) noexcept;
+
+    /** Averages numSamples of every channel, starting at startSample, into one span.
+        A single channel is returned in place with no copy, and no channels come out
+        as silence in `scratch`. Otherwise the average is built in `scratch` with
+        whole-span vector ops, and `scratch` is returned.
+    */
+    const float* downmix (const float* const* channels, int numChannels, int startSample,
+                          int numSamples, float* scratch) noexcept;
+
+    /** The original per-sample loop, kept as the reference and benchmark baseline.
+        Always writes to `dest`.
+    */
+    void downmixReference (const float* const* channels, int numChannels, int startSample,
+                           int numSamples, float* dest) noexcept;
+
+    /** Sum of squares and largest absolute value of a span of samples. */
+    struct LevelSums
+    {
+        float sumSquares = 0.0f;
+        float peak = 0.0f;
+    };
+
+    /** Multiplies numSamples in place by a gain that moves linearly from startGain
+        towards endGain, as AudioBuffer::applyGainRamp does, and measures the result:
+        the sum of squares in the same loop, with independent per-lane sums so it
+        vectorises, and the peak straight afterwards while the span is in cache.
+    */
+    LevelSums applyGainAndMeasure (float* samples, int numSamples, float startGain, float endGain) noexcept;
+
+    /** The same as separate gain, RMS and peak passes, kept as the reference and
+        benchmark baseline.
+    */
+    LevelSums applyGainAndMeasureReference (float* samples, int numSamples, float startGain, float endGain) noexcept;
+
+    /** Interpolation used by truePeak(): four times oversampling, twelve taps per phase. */
+    constexpr int truePeakOversampling = 4;
+    constexpr int truePeakTapsPerPhase = 12;
+
+    /** Largest absolute value of the signal between samples, from the three points
+        interpolated between each pair at four times the rate (ITU-R BS.1770 style).
+        The truePeakTapsPerPhase - 1 samples before `samples` must hold the end of
+        the previous span; the interpolated points lag the input by half the filter,
+        so the last few of one span are measured with the next. Taking the max with
+        the sample peak gives the true peak.
+    */
+    float truePeak (const float* samples, int numSamples) noexcept;
+}